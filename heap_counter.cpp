@@ -0,0 +1,46 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "heap_counter.hpp"
+#include <new>
+#include <stdlib.h>
+
+thread_local uint64_t heap_allocation_count;
+thread_local uint64_t heap_allocation_bytes;
+
+// If GCC inlines these, it sees the pointers of new expressions go to free() and warns.
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#elif defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void *operator new(size_t size)
+{
+	heap_allocation_count++;
+	heap_allocation_bytes += size;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+NOINLINE void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
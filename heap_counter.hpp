@@ -0,0 +1,28 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HEAP_COUNTER_HPP
+#define HEAP_COUNTER_HPP
+
+#include <stdint.h>
+
+// Heap allocations made through operator new by the calling thread.
+// Tools which report allocations link heap_counter.cpp, which replaces the global operator new and delete.
+// Every thread counts its own, so work can be measured on any thread.
+extern thread_local uint64_t heap_allocation_count;
+extern thread_local uint64_t heap_allocation_bytes;
+
+#endif
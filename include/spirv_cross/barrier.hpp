@@ -17,6 +17,7 @@
 #ifndef SPIRV_CROSS_BARRIER_HPP
 #define SPIRV_CROSS_BARRIER_HPP
 
+#include "cache_line.hpp"
 #include <atomic>
 #include <thread>
 
@@ -36,9 +37,12 @@ public:
 		this->divisor = divisor;
 	}
 
-	static inline void memoryBarrier()
+	// Called while waiting for the other invocations, instead of yielding the thread.
+	// Used when invocations are fibers which share a thread.
+	void set_yield_callback(void (*callback)(void *), void *userdata)
 	{
-		std::atomic_thread_fence(std::memory_order_seq_cst);
+		yield_callback = callback;
+		yield_userdata = userdata;
 	}
 
 	void reset_counter()
@@ -53,26 +57,35 @@ public:
 		// Overflows cleanly.
 		unsigned target_count = divisor * target_iteration;
 
-		// Barriers don't enforce memory ordering.
-		// Be as relaxed about the barrier as we possibly can!
-		unsigned c = count.fetch_add(1u, std::memory_order_relaxed);
+		// Memory barriers in front of barrier() only order the accesses of one invocation,
+		// so the barrier itself has to pass them on to the other invocations of the work group.
+		// Every invocation releases its writes into count, and the last one hands all of them on through iteration.
+		unsigned c = count.fetch_add(1u, std::memory_order_acq_rel);
 
 		if (c + 1 == target_count)
 		{
-			iteration.store(target_iteration, std::memory_order_relaxed);
+			iteration.store(target_iteration, std::memory_order_release);
 		}
 		else
 		{
 			// If we have more threads than the CPU, don't hog the CPU for very long periods of time.
-			while (iteration.load(std::memory_order_relaxed) != target_iteration)
-				std::this_thread::yield();
+			while (iteration.load(std::memory_order_acquire) != target_iteration)
+			{
+				if (yield_callback)
+					yield_callback(yield_userdata);
+				else
+					std::this_thread::yield();
+			}
 		}
 	}
 
 private:
 	unsigned divisor = 1;
-	std::atomic<unsigned> count;
-	std::atomic<unsigned> iteration;
+	void (*yield_callback)(void *) = nullptr;
+	void *yield_userdata = nullptr;
+	// Every waiting invocation polls iteration while the others increment count, keep them on different lines.
+	alignas(SPIRV_CROSS_CACHE_LINE_SIZE) std::atomic<unsigned> count;
+	alignas(SPIRV_CROSS_CACHE_LINE_SIZE) std::atomic<unsigned> iteration;
 };
 }
 
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_CACHE_LINE_HPP
+#define SPIRV_CROSS_CACHE_LINE_HPP
+
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef SPIRV_CROSS_CACHE_LINE_SIZE
+#define SPIRV_CROSS_CACHE_LINE_SIZE 64
+#endif
+
+namespace spirv_cross
+{
+// Data written by different threads must not share a cache line, or every write stalls the other threads.
+// alignas() takes care of the layout, but before C++17 operator new ignores alignment beyond
+// alignof(max_align_t), so classes which are allocated on the heap derive from this to get aligned allocations.
+struct CacheLineAligned
+{
+	static void *operator new(size_t size)
+	{
+		// Keep the pointer malloc() returned just in front of the aligned block.
+		void *base = malloc(size + SPIRV_CROSS_CACHE_LINE_SIZE + sizeof(void *));
+		if (!base)
+			throw std::bad_alloc();
+
+		auto addr = reinterpret_cast<uintptr_t>(base) + sizeof(void *) + SPIRV_CROSS_CACHE_LINE_SIZE - 1;
+		auto *aligned = reinterpret_cast<void **>(addr & ~uintptr_t(SPIRV_CROSS_CACHE_LINE_SIZE - 1));
+		aligned[-1] = base;
+		return aligned;
+	}
+
+	static void operator delete(void *ptr)
+	{
+		if (ptr)
+			free(static_cast<void **>(ptr)[-1]);
+	}
+};
+
+// Pads T to whole cache lines. Arrays of these never share a line between two elements.
+template <typename T>
+struct alignas(SPIRV_CROSS_CACHE_LINE_SIZE) CacheLinePadded : T
+{
+};
+}
+
+#endif
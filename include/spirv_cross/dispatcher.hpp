@@ -0,0 +1,208 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_DISPATCHER_HPP
+#define SPIRV_CROSS_DISPATCHER_HPP
+
+#include "cache_line.hpp"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace spirv_cross
+{
+// A fixed pool of worker threads, one per hardware thread, which runs the work groups of a dispatch.
+// Every worker starts out with an even share of the work groups, and steals half of
+// the remaining work groups of another worker once it runs out.
+// The thread calling run() takes part as worker 0.
+class Dispatcher
+{
+public:
+	struct Task
+	{
+		virtual ~Task() = default;
+		virtual void run(unsigned worker, unsigned work_group) = 0;
+	};
+
+	static Dispatcher &get()
+	{
+		static Dispatcher dispatcher;
+		return dispatcher;
+	}
+
+	unsigned get_worker_count() const
+	{
+		return worker_count;
+	}
+
+	// Runs task for every work group in [0, count) and returns once all of them are done.
+	void run(Task &task, unsigned count)
+	{
+		// Dispatches from different threads take turns.
+		std::lock_guard<std::mutex> holder{ dispatch_lock };
+
+		for (unsigned i = 0; i < worker_count; i++)
+		{
+			auto &queue = *queues[i];
+			std::lock_guard<std::mutex> l{ queue.lock };
+			queue.begin = unsigned(uint64_t(count) * i / worker_count);
+			queue.end = unsigned(uint64_t(count) * (i + 1) / worker_count);
+		}
+
+		{
+			std::lock_guard<std::mutex> l{ lock };
+			current_task = &task;
+			finished = 0;
+			generation++;
+		}
+		cond.notify_all();
+
+		execute(task, 0);
+
+		// Wait for every worker, not only for the work, so no worker can still be holding on to task
+		// when the next dispatch starts.
+		std::unique_lock<std::mutex> l{ lock };
+		done_cond.wait(l, [this] { return finished == worker_count - 1; });
+		current_task = nullptr;
+	}
+
+	~Dispatcher()
+	{
+		{
+			std::lock_guard<std::mutex> l{ lock };
+			dying = true;
+		}
+		cond.notify_all();
+
+		for (auto &thread : threads)
+			thread.join();
+	}
+
+private:
+	Dispatcher()
+	{
+		worker_count = std::thread::hardware_concurrency();
+		if (worker_count == 0)
+			worker_count = 1;
+
+		for (unsigned i = 0; i < worker_count; i++)
+			queues.emplace_back(new Queue);
+		for (unsigned i = 1; i < worker_count; i++)
+			threads.emplace_back([this, i] { worker_main(i); });
+	}
+
+	Dispatcher(const Dispatcher &) = delete;
+	void operator=(const Dispatcher &) = delete;
+
+	// Every worker locks its own queue for every work group, so keep them on separate cache lines.
+	struct alignas(SPIRV_CROSS_CACHE_LINE_SIZE) Queue : CacheLineAligned
+	{
+		std::mutex lock;
+		unsigned begin = 0;
+		unsigned end = 0;
+	};
+
+	void worker_main(unsigned index)
+	{
+		uint64_t seen_generation = 0;
+		for (;;)
+		{
+			Task *task;
+			{
+				std::unique_lock<std::mutex> l{ lock };
+				cond.wait(l, [&] { return dying || generation != seen_generation; });
+				if (dying)
+					break;
+				seen_generation = generation;
+				task = current_task;
+			}
+
+			execute(*task, index);
+
+			std::lock_guard<std::mutex> l{ lock };
+			if (++finished == worker_count - 1)
+				done_cond.notify_one();
+		}
+	}
+
+	void execute(Task &task, unsigned index)
+	{
+		unsigned work_group;
+		while (pop(index, work_group) || steal(index, work_group))
+			task.run(index, work_group);
+	}
+
+	bool pop(unsigned index, unsigned &work_group)
+	{
+		auto &queue = *queues[index];
+		std::lock_guard<std::mutex> l{ queue.lock };
+		if (queue.begin == queue.end)
+			return false;
+
+		work_group = queue.begin++;
+		return true;
+	}
+
+	// Takes the back half of the first worker with work left. The first stolen work group is returned,
+	// the rest goes to our own queue, where it can be stolen again.
+	bool steal(unsigned index, unsigned &work_group)
+	{
+		for (unsigned i = 1; i < worker_count; i++)
+		{
+			auto &victim = *queues[(index + i) % worker_count];
+			unsigned begin, end;
+			{
+				std::lock_guard<std::mutex> l{ victim.lock };
+				if (victim.begin == victim.end)
+					continue;
+
+				end = victim.end;
+				begin = end - (end - victim.begin + 1) / 2;
+				victim.end = begin;
+			}
+
+			auto &queue = *queues[index];
+			std::lock_guard<std::mutex> l{ queue.lock };
+			work_group = begin;
+			queue.begin = begin + 1;
+			queue.end = end;
+			return true;
+		}
+
+		return false;
+	}
+
+	unsigned worker_count;
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex dispatch_lock;
+
+	// Protects everything below.
+	std::mutex lock;
+	std::condition_variable cond;
+	std::condition_variable done_cond;
+	Task *current_task = nullptr;
+	uint64_t generation = 0;
+	unsigned finished = 0;
+	bool dying = false;
+};
+}
+
+#endif
@@ -30,6 +30,8 @@ struct spirv_cross_interface
 	spirv_cross_shader_t *(*construct)(void);
 	void (*destruct)(spirv_cross_shader_t *thiz);
 	void (*invoke)(spirv_cross_shader_t *thiz);
+	// Only set for shaders compiled with typed resources. Returns the Impl::Bindings of the shader.
+	void *(*get_bindings)(spirv_cross_shader_t *thiz);
 };
 
 void spirv_cross_set_stage_input(spirv_cross_shader_t *thiz, unsigned location, void *data, size_t size);
@@ -54,6 +56,25 @@ typedef enum spirv_cross_builtin {
 
 void spirv_cross_set_builtin(spirv_cross_shader_t *thiz, spirv_cross_builtin builtin, void *data, size_t size);
 
+// Runs x * y * z work groups of a compute shader, spread over one worker thread per hardware thread.
+// gl_WorkGroupID and gl_NumWorkGroups are provided by the dispatch, so they don't need to be set,
+// and all other bindings must not change until it returns.
+// A shader must not be dispatched again before the previous dispatch of it returned.
+void spirv_cross_dispatch(spirv_cross_shader_t *thiz, unsigned x, unsigned y, unsigned z);
+
+// Streams bind one element per invocation of a batch. Invocation i of spirv_cross_invoke_batch()
+// sees data + i * stride. Binding a slot with the regular functions turns the stream off again.
+void spirv_cross_set_stage_input_stream(spirv_cross_shader_t *thiz, unsigned location, void *data, size_t size,
+                                        size_t stride);
+void spirv_cross_set_stage_output_stream(spirv_cross_shader_t *thiz, unsigned location, void *data, size_t size,
+                                         size_t stride);
+void spirv_cross_set_builtin_stream(spirv_cross_shader_t *thiz, spirv_cross_builtin builtin, void *data, size_t size,
+                                    size_t stride);
+
+// Runs count invocations of a vertex or fragment shader in one call, e.g. one per vertex or fragment.
+// Bindings which are not streams are shared by all invocations.
+void spirv_cross_invoke_batch(spirv_cross_shader_t *thiz, unsigned count);
+
 #define SPIRV_CROSS_NUM_DESCRIPTOR_SETS 4
 #define SPIRV_CROSS_NUM_DESCRIPTOR_BINDINGS 16
 #define SPIRV_CROSS_NUM_STAGE_INPUTS 16
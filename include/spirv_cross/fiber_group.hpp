@@ -0,0 +1,217 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_FIBER_GROUP_HPP
+#define SPIRV_CROSS_FIBER_GROUP_HPP
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+// The ucontext functions are deprecated on OSX, and hidden unless this is defined.
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600
+#endif
+#include <ucontext.h>
+#endif
+
+#include <memory>
+#include <new>
+#include <stdint.h>
+
+#ifndef SPIRV_CROSS_FIBER_STACK_SIZE
+#define SPIRV_CROSS_FIBER_STACK_SIZE (128 * 1024)
+#endif
+
+namespace spirv_cross
+{
+// Runs every invocation of a work group as a fiber on the thread calling run().
+// An invocation which has to wait, i.e. in barrier(), calls yield() to switch to the next invocation
+// instead of blocking the thread.
+// Fibers are Win32 fibers on Windows and ucontext elsewhere. swapcontext() also saves and restores the signal mask,
+// which is a system call on glibc, so every switch costs a trip into the kernel there.
+template <typename T, unsigned Size>
+class FiberGroup
+{
+public:
+	FiberGroup(T *impl_)
+	    : impl(impl_)
+#ifndef _WIN32
+	    , stacks(new char[Size * size_t(SPIRV_CROSS_FIBER_STACK_SIZE)])
+#endif
+	{
+	}
+
+#ifdef _WIN32
+	~FiberGroup()
+	{
+		for (auto &fiber : fibers)
+			if (fiber.handle)
+				DeleteFiber(fiber.handle);
+	}
+#endif
+
+	// Runs all invocations to completion.
+	void run()
+	{
+#ifdef _WIN32
+		// Only a fiber can switch to another fiber, so the calling thread is one until the work group is done.
+		bool converted = !IsThreadAFiber();
+		scheduler = converted ? ConvertThreadToFiber(nullptr) : GetCurrentFiber();
+		if (!scheduler)
+			throw std::bad_alloc();
+#endif
+
+		for (unsigned i = 0; i < Size; i++)
+			prepare(i);
+
+		// We only get back here when an invocation returns.
+		unsigned remaining = Size;
+		current = 0;
+		while (remaining)
+		{
+#ifdef _WIN32
+			SwitchToFiber(fibers[current].handle);
+#else
+			swapcontext(&scheduler, &fibers[current].context);
+#endif
+			if (--remaining)
+				current = next_pending();
+		}
+
+#ifdef _WIN32
+		if (converted)
+			ConvertFiberToThread();
+#endif
+	}
+
+	// Everything is done once run() returns, this only matches ThreadGroup.
+	void wait()
+	{
+	}
+
+	// Must be called from inside an invocation. Switches straight to the next invocation which has not returned.
+	void yield()
+	{
+		unsigned previous = current;
+		current = next_pending();
+		if (current != previous)
+		{
+#ifdef _WIN32
+			SwitchToFiber(fibers[current].handle);
+#else
+			swapcontext(&fibers[previous].context, &fibers[current].context);
+#endif
+		}
+	}
+
+	static void yield(void *group)
+	{
+		static_cast<FiberGroup *>(group)->yield();
+	}
+
+private:
+	FiberGroup(const FiberGroup &) = delete;
+	void operator=(const FiberGroup &) = delete;
+
+#ifdef _WIN32
+	// Win32 fibers are created once and run one invocation for every run().
+	void prepare(unsigned index)
+	{
+		auto &fiber = fibers[index];
+		if (!fiber.handle)
+			fiber.handle = CreateFiber(SPIRV_CROSS_FIBER_STACK_SIZE, &FiberGroup::entry, this);
+		if (!fiber.handle)
+			throw std::bad_alloc();
+		fiber.done = false;
+	}
+
+	static void WINAPI entry(void *data)
+	{
+		auto *group = static_cast<FiberGroup *>(data);
+		// Returning from a fiber ends the thread, so it waits in the scheduler for the next run() instead.
+		for (;;)
+		{
+			group->impl[group->current].main();
+			group->fibers[group->current].done = true;
+			SwitchToFiber(group->scheduler);
+		}
+	}
+#else
+	void prepare(unsigned index)
+	{
+		auto &fiber = fibers[index];
+		getcontext(&fiber.context);
+		fiber.context.uc_stack.ss_sp = &stacks[index * size_t(SPIRV_CROSS_FIBER_STACK_SIZE)];
+		fiber.context.uc_stack.ss_size = SPIRV_CROSS_FIBER_STACK_SIZE;
+		fiber.context.uc_link = &scheduler;
+		fiber.done = false;
+
+		// makecontext() only passes ints, so split the pointer.
+		auto self = reinterpret_cast<uintptr_t>(this);
+		makecontext(&fiber.context, reinterpret_cast<void (*)()>(&FiberGroup::entry), 2,
+		            unsigned(self & 0xffffffffu), unsigned(uint64_t(self) >> 32));
+	}
+
+	static void entry(unsigned low, unsigned high)
+	{
+		auto *group = reinterpret_cast<FiberGroup *>(uintptr_t(low) | uintptr_t(uint64_t(high) << 32));
+		group->impl[group->current].main();
+		// Returning resumes the scheduler through uc_link.
+		group->fibers[group->current].done = true;
+	}
+#endif
+
+	// The first invocation after the current one which has not returned, or the current one if there is none.
+	unsigned next_pending() const
+	{
+		for (unsigned i = 1; i <= Size; i++)
+		{
+			unsigned index = (current + i) % Size;
+			if (!fibers[index].done)
+				return index;
+		}
+		return current;
+	}
+
+	struct Fiber
+	{
+#ifdef _WIN32
+		void *handle = nullptr;
+#else
+		ucontext_t context;
+#endif
+		bool done = true;
+	};
+
+	T *impl;
+#ifdef _WIN32
+	void *scheduler = nullptr;
+#else
+	std::unique_ptr<char[]> stacks;
+	ucontext_t scheduler;
+#endif
+	Fiber fibers[Size];
+	unsigned current = 0;
+};
+}
+
+#endif
@@ -30,12 +30,35 @@
 #include <glm/glm.hpp>
 
 #include "barrier.hpp"
+#include "cache_line.hpp"
+#include "dispatcher.hpp"
 #include "external_interface.h"
 #include "image.hpp"
 #include "sampler.hpp"
 #include "thread_group.hpp"
+
+// Barrier invocations are fibers by default. Define SPIRV_CROSS_COMPUTE_THREADS to run them as threads instead.
+#ifndef SPIRV_CROSS_COMPUTE_THREADS
+#include "fiber_group.hpp"
+#endif
+
+// When invocations run on their own threads, every invocation is padded to whole cache lines, so private
+// variables and builtins written by one thread never share a line with another thread.
+// Smaller work groups are left packed, define this to opt out for work groups up to some size.
+#ifndef SPIRV_CROSS_MIN_PADDED_WORK_GROUP_SIZE
+#define SPIRV_CROSS_MIN_PADDED_WORK_GROUP_SIZE 2
+#endif
 #include <assert.h>
+#include <atomic>
 #include <stdint.h>
+#include <type_traits>
+
+// Used for typed buffers which are declared restrict in the shader.
+#if defined(__GNUC__) || defined(__clang__)
+#define SPIRV_CROSS_RESTRICT __restrict
+#else
+#define SPIRV_CROSS_RESTRICT
+#endif
 
 namespace internal
 {
@@ -192,10 +215,13 @@ struct spirv_cross_shader
 		PPSize()
 		    : ptr(0)
 		    , size(0)
+		    , stride(0)
 		{
 		}
 		void **ptr;
 		size_t size;
+		// Non-zero for streams, which advance by stride after every invocation of a batch.
+		size_t stride;
 	};
 
 	struct PPSizeResource
@@ -218,6 +244,11 @@ struct spirv_cross_shader
 	PPSize push_constant;
 	PPSize builtins[SPIRV_CROSS_NUM_BUILTINS];
 
+	// Set by shader types which support spirv_cross_dispatch().
+	void (*dispatch_func)(spirv_cross_shader *shader, unsigned x, unsigned y, unsigned z) = nullptr;
+	// Set by shader types which support spirv_cross_invoke_batch().
+	void (*batch_func)(spirv_cross_shader *shader, unsigned count) = nullptr;
+
 	template <typename U>
 	void register_builtin(spirv_cross_builtin builtin, const U &value)
 	{
@@ -233,6 +264,13 @@ struct spirv_cross_shader
 		assert(size >= builtins[builtin].size);
 
 		*builtins[builtin].ptr = data;
+		builtins[builtin].stride = 0;
+	}
+
+	void set_builtin_stream(spirv_cross_builtin builtin, void *data, size_t size, size_t stride)
+	{
+		set_builtin(builtin, data, size);
+		builtins[builtin].stride = stride;
 	}
 
 	template <typename U>
@@ -247,6 +285,19 @@ struct spirv_cross_shader
 		resources[set][binding].pre_dereference = internal::Resource<U>::PreDereference;
 	}
 
+	// Typed resources are plain pointers, which are always bound to a single buffer.
+	template <typename U>
+	void register_resource(U *const &value, unsigned set, unsigned binding)
+	{
+		assert(set < SPIRV_CROSS_NUM_DESCRIPTOR_SETS);
+		assert(binding < SPIRV_CROSS_NUM_DESCRIPTOR_BINDINGS);
+		assert(!resources[set][binding].ptr);
+
+		resources[set][binding].ptr = (void **)&value;
+		resources[set][binding].size = sizeof(U *);
+		resources[set][binding].pre_dereference = true;
+	}
+
 	template <typename U>
 	void register_stage_input(const internal::StageInput<U> &value, unsigned location)
 	{
@@ -286,6 +337,15 @@ struct spirv_cross_shader
 		push_constant.size = internal::PushConstant<U>::Size;
 	}
 
+	template <typename U>
+	void register_push_constant(U *const &value)
+	{
+		assert(!push_constant.ptr);
+
+		push_constant.ptr = (void **)&value;
+		push_constant.size = sizeof(U);
+	}
+
 	void set_stage_input(unsigned location, void *data, size_t size)
 	{
 		assert(location < SPIRV_CROSS_NUM_STAGE_INPUTS);
@@ -293,6 +353,13 @@ struct spirv_cross_shader
 		assert(size >= stage_inputs[location].size);
 
 		*stage_inputs[location].ptr = data;
+		stage_inputs[location].stride = 0;
+	}
+
+	void set_stage_input_stream(unsigned location, void *data, size_t size, size_t stride)
+	{
+		set_stage_input(location, data, size);
+		stage_inputs[location].stride = stride;
 	}
 
 	void set_stage_output(unsigned location, void *data, size_t size)
@@ -302,6 +369,13 @@ struct spirv_cross_shader
 		assert(size >= stage_outputs[location].size);
 
 		*stage_outputs[location].ptr = data;
+		stage_outputs[location].stride = 0;
+	}
+
+	void set_stage_output_stream(unsigned location, void *data, size_t size, size_t stride)
+	{
+		set_stage_output(location, data, size);
+		stage_outputs[location].stride = stride;
 	}
 
 	void set_uniform_constant(unsigned location, void *data, size_t size)
@@ -334,6 +408,63 @@ struct spirv_cross_shader
 		else
 			*resources[set][binding].ptr = data;
 	}
+
+	// Binds everything other is bound to. Both must be the same shader type.
+	void copy_bindings(const spirv_cross_shader &other)
+	{
+		for (unsigned set = 0; set < SPIRV_CROSS_NUM_DESCRIPTOR_SETS; set++)
+			for (unsigned binding = 0; binding < SPIRV_CROSS_NUM_DESCRIPTOR_BINDINGS; binding++)
+				copy_binding(resources[set][binding], other.resources[set][binding]);
+		for (unsigned i = 0; i < SPIRV_CROSS_NUM_STAGE_INPUTS; i++)
+			copy_binding(stage_inputs[i], other.stage_inputs[i]);
+		for (unsigned i = 0; i < SPIRV_CROSS_NUM_STAGE_OUTPUTS; i++)
+			copy_binding(stage_outputs[i], other.stage_outputs[i]);
+		for (unsigned i = 0; i < SPIRV_CROSS_NUM_UNIFORM_CONSTANTS; i++)
+			copy_binding(uniform_constants[i], other.uniform_constants[i]);
+		copy_binding(push_constant, other.push_constant);
+		for (unsigned i = 0; i < SPIRV_CROSS_NUM_BUILTINS; i++)
+			copy_binding(builtins[i], other.builtins[i]);
+	}
+
+protected:
+	struct Stream
+	{
+		void **ptr;
+		void *base;
+		size_t stride;
+	};
+
+	enum
+	{
+		MaxStreams = SPIRV_CROSS_NUM_STAGE_INPUTS + SPIRV_CROSS_NUM_STAGE_OUTPUTS + SPIRV_CROSS_NUM_BUILTINS
+	};
+
+	// Collects every bound stream, so a batch only has to look at slots which move.
+	unsigned get_streams(Stream *streams) const
+	{
+		unsigned count = 0;
+		for (unsigned i = 0; i < SPIRV_CROSS_NUM_STAGE_INPUTS; i++)
+			add_stream(streams, count, stage_inputs[i]);
+		for (unsigned i = 0; i < SPIRV_CROSS_NUM_STAGE_OUTPUTS; i++)
+			add_stream(streams, count, stage_outputs[i]);
+		for (unsigned i = 0; i < SPIRV_CROSS_NUM_BUILTINS; i++)
+			add_stream(streams, count, builtins[i]);
+		return count;
+	}
+
+private:
+	static void add_stream(Stream *streams, unsigned &count, const PPSize &slot)
+	{
+		if (slot.ptr && slot.stride)
+			streams[count++] = { slot.ptr, *slot.ptr, slot.stride };
+	}
+
+	template <typename Slot>
+	static void copy_binding(Slot &slot, const Slot &other)
+	{
+		if (slot.ptr)
+			*slot.ptr = *other.ptr;
+	}
 };
 
 namespace spirv_cross
@@ -345,6 +476,30 @@ struct BaseShader : spirv_cross_shader
 	{
 		static_cast<T *>(this)->main();
 	}
+
+	// Runs count invocations. Streams advance after every invocation,
+	// and point at the start of their data again once the batch is done.
+	void invoke_batch(unsigned count)
+	{
+		Stream streams[MaxStreams];
+		unsigned num_streams = get_streams(streams);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			static_cast<T *>(this)->main();
+			for (unsigned j = 0; j < num_streams; j++)
+				*streams[j].ptr = static_cast<char *>(*streams[j].ptr) + streams[j].stride;
+		}
+
+		for (unsigned j = 0; j < num_streams; j++)
+			*streams[j].ptr = streams[j].base;
+	}
+
+protected:
+	static void batch_entry(spirv_cross_shader *shader, unsigned count)
+	{
+		static_cast<T *>(shader)->invoke_batch(count);
+	}
 };
 
 struct FragmentResources
@@ -367,6 +522,7 @@ struct FragmentShader : BaseShader<FragmentShader<T, Res>>
 
 	FragmentShader()
 	{
+		this->batch_func = &FragmentShader::batch_entry;
 		resources.init(*this);
 		impl.__res = &resources;
 	}
@@ -395,6 +551,7 @@ struct VertexShader : BaseShader<VertexShader<T, Res>>
 
 	VertexShader()
 	{
+		this->batch_func = &VertexShader::batch_entry;
 		resources.init(*this);
 		impl.__res = &resources;
 	}
@@ -497,25 +654,210 @@ struct ComputeResources
 struct ComputePrivateResources
 {
 	uint32_t gl_LocalInvocationIndex__;
-#define gl_LocalInvocationIndex __priv_res.gl_LocalInvocationIndex__
 	glm::uvec3 gl_LocalInvocationID__;
-#define gl_LocalInvocationID __priv_res.gl_LocalInvocationID__
 	glm::uvec3 gl_GlobalInvocationID__;
+
+	void set_local_invocation(unsigned, const glm::uvec3 &id, uint32_t index)
+	{
+		gl_LocalInvocationID__ = id;
+		gl_LocalInvocationIndex__ = index;
+	}
+
+	void set_global_invocation(unsigned, const glm::uvec3 &id)
+	{
+		gl_GlobalInvocationID__ = id;
+	}
+};
+
+// Builtins of a shader compiled with CompilerCPP::set_simd_width(), for every lane.
+// Each component is stored as its own array, so the same builtin of consecutive lanes is contiguous.
+template <unsigned Lanes>
+struct WideComputePrivateResources
+{
+	uint32_t gl_LocalInvocationIndex__[Lanes];
+	uint32_t gl_LocalInvocationID__[3][Lanes];
+	uint32_t gl_GlobalInvocationID__[3][Lanes];
+
+	void set_local_invocation(unsigned lane, const glm::uvec3 &id, uint32_t index)
+	{
+		gl_LocalInvocationID__[0][lane] = id.x;
+		gl_LocalInvocationID__[1][lane] = id.y;
+		gl_LocalInvocationID__[2][lane] = id.z;
+		gl_LocalInvocationIndex__[lane] = index;
+	}
+
+	void set_global_invocation(unsigned lane, const glm::uvec3 &id)
+	{
+		gl_GlobalInvocationID__[0][lane] = id.x;
+		gl_GlobalInvocationID__[1][lane] = id.y;
+		gl_GlobalInvocationID__[2][lane] = id.z;
+	}
+
+	glm::uvec3 local_invocation_id(unsigned lane) const
+	{
+		return glm::uvec3(gl_LocalInvocationID__[0][lane], gl_LocalInvocationID__[1][lane],
+		                  gl_LocalInvocationID__[2][lane]);
+	}
+
+	glm::uvec3 global_invocation_id(unsigned lane) const
+	{
+		return glm::uvec3(gl_GlobalInvocationID__[0][lane], gl_GlobalInvocationID__[1][lane],
+		                  gl_GlobalInvocationID__[2][lane]);
+	}
+};
+
+// The generated code defines SPIRV_CROSS_LANES when it runs several invocations per main(),
+// and passes the current lane to every function as __lane.
+#ifdef SPIRV_CROSS_LANES
+#define gl_LocalInvocationIndex __priv_res.gl_LocalInvocationIndex__[__lane]
+#define gl_LocalInvocationID __priv_res.local_invocation_id(__lane)
+#define gl_GlobalInvocationID __priv_res.global_invocation_id(__lane)
+#else
+#define gl_LocalInvocationIndex __priv_res.gl_LocalInvocationIndex__
+#define gl_LocalInvocationID __priv_res.gl_LocalInvocationID__
 #define gl_GlobalInvocationID __priv_res.gl_GlobalInvocationID__
+#endif
+
+// Lanes never depend on each other, so tell the compiler it can vectorize the loop over them.
+#if defined(__clang__)
+#define SPIRV_CROSS_LANE_LOOP _Pragma("clang loop vectorize(enable)")
+#elif defined(__GNUC__)
+#define SPIRV_CROSS_LANE_LOOP _Pragma("GCC ivdep")
+#else
+#define SPIRV_CROSS_LANE_LOOP
+#endif
+
+// Common parts of the compute shader runtimes. Impl is the runtime deriving from this, which provides main().
+// Every T runs Lanes invocations along X. If Padded, every T gets its own cache lines.
+template <typename Impl, typename T, typename Res, unsigned WorkGroupX, unsigned WorkGroupY, unsigned WorkGroupZ,
+          unsigned Lanes = 1, bool Padded = false>
+struct ComputeShaderBase : BaseShader<Impl>, CacheLineAligned
+{
+	typedef typename std::conditional<Padded, CacheLinePadded<T>, T>::type Invocation;
+
+	// Runs x * y * z work groups on the dispatcher pool.
+	// Every worker runs its work groups on its own copy of the shader, so shared memory is not shared
+	// between work groups which run at the same time. The copies are created the first time a worker
+	// picks up a work group, and take the bindings of this shader at the start of every dispatch.
+	// Must not be called for the same shader from several threads at once, or from inside any work group.
+	// Different shaders can be dispatched concurrently. The state below is written before Dispatcher::run(),
+	// which publishes it to the workers through the dispatcher lock.
+	void dispatch(unsigned x, unsigned y, unsigned z)
+	{
+		auto &dispatcher = Dispatcher::get();
+		if (workers.empty())
+			workers.resize(dispatcher.get_worker_count());
+
+		dispatch_num_work_groups = glm::uvec3(x, y, z);
+		dispatch_index++;
+
+		DispatchTask task(*this);
+		if (Impl::invocations_are_threads)
+		{
+			// Every copy would start a thread per invocation, so one copy runs the work groups one after the other.
+			for (unsigned work_group = 0; work_group < x * y * z; work_group++)
+				task.run(0, work_group);
+		}
+		else
+			dispatcher.run(task, x * y * z);
+	}
+
+	// Set by runtimes which start a thread for every invocation.
+	static const bool invocations_are_threads = false;
+
+	ComputeShaderBase()
+	{
+		this->dispatch_func = &ComputeShaderBase::dispatch_entry;
+		resources.init(*this);
+
+		unsigned i = 0;
+		for (unsigned z = 0; z < WorkGroupZ; z++)
+		{
+			for (unsigned y = 0; y < WorkGroupY; y++)
+			{
+				for (unsigned x = 0; x < WorkGroupX; x++)
+				{
+					auto &invocation = impl[z][y][x / Lanes];
+					invocation.__priv_res.set_local_invocation(x % Lanes, glm::uvec3(x, y, z), i++);
+					invocation.__res = &resources;
+				}
+			}
+		}
+	}
+
+	static_assert(WorkGroupX % Lanes == 0, "Work group size in X must be a multiple of the lane count.");
+	Invocation impl[WorkGroupZ][WorkGroupY][WorkGroupX / Lanes];
+	Res resources;
+
+private:
+	struct DispatchTask : Dispatcher::Task
+	{
+		DispatchTask(ComputeShaderBase &shader_)
+		    : shader(shader_)
+		{
+		}
+
+		void run(unsigned worker, unsigned work_group) override
+		{
+			auto &copy = shader.workers[worker];
+			if (!copy)
+				copy.reset(new Impl);
+
+			if (copy->dispatch_index != shader.dispatch_index)
+			{
+				copy->copy_bindings(shader);
+				copy->resources.gl_WorkGroupID__.ptr = &copy->dispatch_work_group_id;
+				copy->resources.gl_NumWorkGroups__.ptr = &shader.dispatch_num_work_groups;
+				copy->dispatch_index = shader.dispatch_index;
+			}
+
+			auto &count = shader.dispatch_num_work_groups;
+			copy->dispatch_work_group_id =
+			    glm::uvec3(work_group % count.x, (work_group / count.x) % count.y, work_group / (count.x * count.y));
+			copy->main();
+		}
+
+		ComputeShaderBase &shader;
+	};
+
+	static void dispatch_entry(spirv_cross_shader *shader, unsigned x, unsigned y, unsigned z)
+	{
+		static_cast<Impl *>(shader)->dispatch(x, y, z);
+	}
+
+	// One copy of the shader per dispatcher worker.
+	std::vector<std::unique_ptr<Impl>> workers;
+	uint64_t dispatch_index = 0;
+	glm::uvec3 dispatch_num_work_groups;
+	glm::uvec3 dispatch_work_group_id;
 };
 
+// For shaders with barriers. Every invocation of a work group runs as a fiber on the calling thread,
+// and a fiber switches to the next one when it has to wait in barrier().
+// With SPIRV_CROSS_COMPUTE_THREADS, every invocation runs on its own thread instead. Those threads are
+// the parallelism of a dispatch then, so dispatch() runs its work groups on the calling thread.
 template <typename T, typename Res, unsigned WorkGroupX, unsigned WorkGroupY, unsigned WorkGroupZ>
-struct ComputeShader : BaseShader<ComputeShader<T, Res, WorkGroupX, WorkGroupY, WorkGroupZ>>
+struct ComputeShader
+    : ComputeShaderBase<ComputeShader<T, Res, WorkGroupX, WorkGroupY, WorkGroupZ>, T, Res, WorkGroupX, WorkGroupY,
+                        WorkGroupZ, 1,
+#ifdef SPIRV_CROSS_COMPUTE_THREADS
+                        WorkGroupX * WorkGroupY * WorkGroupZ >= SPIRV_CROSS_MIN_PADDED_WORK_GROUP_SIZE
+#else
+                        false
+#endif
+                        >
 {
+	typedef typename ComputeShader::Invocation Invocation;
+
 	inline void main()
 	{
-		resources.barrier__.reset_counter();
+		this->resources.barrier__.reset_counter();
 
 		for (unsigned z = 0; z < WorkGroupZ; z++)
 			for (unsigned y = 0; y < WorkGroupY; y++)
 				for (unsigned x = 0; x < WorkGroupX; x++)
-					impl[z][y][x].__priv_res.gl_GlobalInvocationID__ =
-					    glm::uvec3(WorkGroupX, WorkGroupY, WorkGroupZ) * resources.gl_WorkGroupID__.get() +
+					this->impl[z][y][x].__priv_res.gl_GlobalInvocationID__ =
+					    glm::uvec3(WorkGroupX, WorkGroupY, WorkGroupZ) * this->resources.gl_WorkGroupID__.get() +
 					    glm::uvec3(x, y, z);
 
 		group.run();
@@ -523,50 +865,190 @@ struct ComputeShader : BaseShader<ComputeShader<T, Res, WorkGroupX, WorkGroupY,
 	}
 
 	ComputeShader()
-	    : group(&impl[0][0][0])
+	    : group(&this->impl[0][0][0])
 	{
-		resources.init(*this);
-		resources.barrier__.set_release_divisor(WorkGroupX * WorkGroupY * WorkGroupZ);
+		this->resources.barrier__.set_release_divisor(WorkGroupX * WorkGroupY * WorkGroupZ);
+#ifndef SPIRV_CROSS_COMPUTE_THREADS
+		this->resources.barrier__.set_yield_callback(&Group::yield, &group);
+#endif
+	}
 
-		unsigned i = 0;
-		for (unsigned z = 0; z < WorkGroupZ; z++)
+#ifdef SPIRV_CROSS_COMPUTE_THREADS
+	typedef ThreadGroup<Invocation, WorkGroupX * WorkGroupY * WorkGroupZ> Group;
+	static const bool invocations_are_threads = true;
+#else
+	typedef FiberGroup<Invocation, WorkGroupX * WorkGroupY * WorkGroupZ> Group;
+#endif
+	Group group;
+};
+
+// For shaders without barriers. The invocations of a work group run one after the other on the calling thread.
+template <typename T, typename Res, unsigned WorkGroupX, unsigned WorkGroupY, unsigned WorkGroupZ>
+struct SerialComputeShader : ComputeShaderBase<SerialComputeShader<T, Res, WorkGroupX, WorkGroupY, WorkGroupZ>, T,
+                                               Res, WorkGroupX, WorkGroupY, WorkGroupZ>
+{
+	inline void main()
+	{
+		auto base = glm::uvec3(WorkGroupX, WorkGroupY, WorkGroupZ) * this->resources.gl_WorkGroupID__.get();
+		auto id = base;
+
+		for (unsigned z = 0; z < WorkGroupZ; z++, id.z++)
 		{
-			for (unsigned y = 0; y < WorkGroupY; y++)
+			id.y = base.y;
+			for (unsigned y = 0; y < WorkGroupY; y++, id.y++)
 			{
-				for (unsigned x = 0; x < WorkGroupX; x++)
+				id.x = base.x;
+				for (unsigned x = 0; x < WorkGroupX; x++, id.x++)
 				{
-					impl[z][y][x].__priv_res.gl_LocalInvocationID__ = glm::uvec3(x, y, z);
-					impl[z][y][x].__priv_res.gl_LocalInvocationIndex__ = i++;
-					impl[z][y][x].__res = &resources;
+					auto &invocation = this->impl[z][y][x];
+					invocation.__priv_res.gl_GlobalInvocationID__ = id;
+					invocation.main();
 				}
 			}
 		}
 	}
+};
 
-	T impl[WorkGroupZ][WorkGroupY][WorkGroupX];
-	ThreadGroup<T, WorkGroupX * WorkGroupY * WorkGroupZ> group;
-	Res resources;
+// For shaders compiled with CompilerCPP::set_simd_width(). Every call to main() of T runs Lanes invocations.
+template <typename T, typename Res, unsigned WorkGroupX, unsigned WorkGroupY, unsigned WorkGroupZ, unsigned Lanes>
+struct WideComputeShader
+    : ComputeShaderBase<WideComputeShader<T, Res, WorkGroupX, WorkGroupY, WorkGroupZ, Lanes>, T, Res, WorkGroupX,
+                        WorkGroupY, WorkGroupZ, Lanes>
+{
+	inline void main()
+	{
+		auto base = glm::uvec3(WorkGroupX, WorkGroupY, WorkGroupZ) * this->resources.gl_WorkGroupID__.get();
+		auto id = base;
+
+		for (unsigned z = 0; z < WorkGroupZ; z++, id.z++)
+		{
+			id.y = base.y;
+			for (unsigned y = 0; y < WorkGroupY; y++, id.y++)
+			{
+				id.x = base.x;
+				for (unsigned x = 0; x < WorkGroupX / Lanes; x++)
+				{
+					auto &invocations = this->impl[z][y][x];
+					for (unsigned lane = 0; lane < Lanes; lane++, id.x++)
+						invocations.__priv_res.set_global_invocation(lane, id);
+					invocations.main();
+				}
+			}
+		}
+	}
 };
 
+// Memory barriers only order the accesses of an invocation, so they map to acquire-release fences.
+// Shared memory never leaves the thread which runs the work group unless invocations are threads,
+// and only has to be protected from the C++ compiler otherwise. Buffers and images are shared by work groups
+// running on different threads.
 inline void memoryBarrierShared()
 {
-	Barrier::memoryBarrier();
+#ifdef SPIRV_CROSS_COMPUTE_THREADS
+	std::atomic_thread_fence(std::memory_order_acq_rel);
+#else
+	std::atomic_signal_fence(std::memory_order_acq_rel);
+#endif
+}
+inline void groupMemoryBarrier()
+{
+	memoryBarrierShared();
+}
+inline void memoryBarrierBuffer()
+{
+	std::atomic_thread_fence(std::memory_order_acq_rel);
+}
+inline void memoryBarrierImage()
+{
+	std::atomic_thread_fence(std::memory_order_acq_rel);
+}
+inline void memoryBarrierAtomicCounter()
+{
+	std::atomic_thread_fence(std::memory_order_acq_rel);
 }
 inline void memoryBarrier()
 {
-	Barrier::memoryBarrier();
+	std::atomic_thread_fence(std::memory_order_acq_rel);
 }
-// TODO: Rest of the barriers.
 
 // Atomics
+// GLSL atomics operate on plain buffer and shared variables, which are accessed as std::atomic<T> in place,
+// like std::atomic_ref in C++20. This is only valid if std::atomic<T> is a lock-free T with the same layout.
+// GLSL atomics are relaxed, ordering is up to the memory barriers.
 template <typename T>
-inline T atomicAdd(T &v, T a)
+inline std::atomic<T> &atomic_ref(T &v)
 {
-	static_assert(sizeof(std::atomic<T>) == sizeof(T), "Cannot cast properly to std::atomic<T>.");
+	static_assert(std::is_integral<T>::value, "GLSL atomics operate on integers.");
+	static_assert(sizeof(std::atomic<T>) == sizeof(T) && alignof(std::atomic<T>) == alignof(T),
+	              "Cannot access T as std::atomic<T> in place.");
+	static_assert((sizeof(T) == sizeof(int) && ATOMIC_INT_LOCK_FREE == 2) ||
+	                  (sizeof(T) == sizeof(long long) && ATOMIC_LLONG_LOCK_FREE == 2),
+	              "std::atomic<T> is not lock-free.");
+	return *reinterpret_cast<std::atomic<T> *>(&v);
+}
+
+// The data argument does not take part in deduction, so literals of the other signedness convert like in GLSL.
+template <typename T>
+using AtomicData = typename std::common_type<T>::type;
 
-	// We need explicit memory barriers in GLSL to enfore any ordering.
-	// FIXME: Can we really cast this? There is no other way I think ...
-	return std::atomic_fetch_add_explicit(reinterpret_cast<std::atomic<T> *>(&v), a, std::memory_order_relaxed);
+template <typename T>
+inline T atomicAdd(T &v, AtomicData<T> a)
+{
+	return atomic_ref(v).fetch_add(a, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline T atomicAnd(T &v, AtomicData<T> a)
+{
+	return atomic_ref(v).fetch_and(a, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline T atomicOr(T &v, AtomicData<T> a)
+{
+	return atomic_ref(v).fetch_or(a, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline T atomicXor(T &v, AtomicData<T> a)
+{
+	return atomic_ref(v).fetch_xor(a, std::memory_order_relaxed);
+}
+
+// There is no fetch_min/fetch_max before C++26. Avoid the store when the value would not change,
+// so contended counters which are already past a are only read.
+template <typename T>
+inline T atomicMin(T &v, AtomicData<T> a)
+{
+	auto &ref = atomic_ref(v);
+	T old = ref.load(std::memory_order_relaxed);
+	while (a < old && !ref.compare_exchange_weak(old, a, std::memory_order_relaxed))
+		;
+	return old;
+}
+
+template <typename T>
+inline T atomicMax(T &v, AtomicData<T> a)
+{
+	auto &ref = atomic_ref(v);
+	T old = ref.load(std::memory_order_relaxed);
+	while (a > old && !ref.compare_exchange_weak(old, a, std::memory_order_relaxed))
+		;
+	return old;
+}
+
+template <typename T>
+inline T atomicExchange(T &v, AtomicData<T> a)
+{
+	return atomic_ref(v).exchange(a, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline T atomicCompSwap(T &v, AtomicData<T> compare, AtomicData<T> data)
+{
+	// On failure, compare is updated to the current value, on success it already is.
+	atomic_ref(v).compare_exchange_strong(compare, data, std::memory_order_relaxed);
+	return compare;
 }
 }
 
@@ -600,4 +1082,59 @@ void spirv_cross_set_builtin(spirv_cross_shader_t *shader, spirv_cross_builtin b
 	shader->set_builtin(builtin, data, size);
 }
 
+void spirv_cross_dispatch(spirv_cross_shader_t *shader, unsigned x, unsigned y, unsigned z)
+{
+	assert(shader->dispatch_func);
+	shader->dispatch_func(shader, x, y, z);
+}
+
+void spirv_cross_set_stage_input_stream(spirv_cross_shader_t *shader, unsigned location, void *data, size_t size,
+                                        size_t stride)
+{
+	shader->set_stage_input_stream(location, data, size, stride);
+}
+
+void spirv_cross_set_stage_output_stream(spirv_cross_shader_t *shader, unsigned location, void *data, size_t size,
+                                         size_t stride)
+{
+	shader->set_stage_output_stream(location, data, size, stride);
+}
+
+void spirv_cross_set_builtin_stream(spirv_cross_shader_t *shader, spirv_cross_builtin builtin, void *data, size_t size,
+                                    size_t stride)
+{
+	shader->set_builtin_stream(builtin, data, size, stride);
+}
+
+void spirv_cross_invoke_batch(spirv_cross_shader_t *shader, unsigned count)
+{
+	assert(shader->batch_func);
+	shader->batch_func(shader, count);
+}
+
+spirv_cross_sampler_2d_t *spirv_cross_create_sampler_2d(const struct spirv_cross_sampler_info *info)
+{
+	using namespace spirv_cross;
+	assert(info->num_mipmaps >= 1);
+
+	switch (info->format)
+	{
+	case SPIRV_CROSS_FORMAT_R8_UNORM:
+		return new sampler2DImpl<SPIRV_CROSS_FORMAT_R8_UNORM>(info);
+	case SPIRV_CROSS_FORMAT_R8G8_UNORM:
+		return new sampler2DImpl<SPIRV_CROSS_FORMAT_R8G8_UNORM>(info);
+	case SPIRV_CROSS_FORMAT_R8G8B8_UNORM:
+		return new sampler2DImpl<SPIRV_CROSS_FORMAT_R8G8B8_UNORM>(info);
+	case SPIRV_CROSS_FORMAT_R8G8B8A8_UNORM:
+		return new sampler2DImpl<SPIRV_CROSS_FORMAT_R8G8B8A8_UNORM>(info);
+	default:
+		return nullptr;
+	}
+}
+
+void spirv_cross_destroy_sampler_2d(spirv_cross_sampler_2d_t *samp)
+{
+	delete samp;
+}
+
 #endif
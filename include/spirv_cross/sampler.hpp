@@ -17,10 +17,23 @@
 #ifndef SPIRV_CROSS_SAMPLER_HPP
 #define SPIRV_CROSS_SAMPLER_HPP
 
+#ifndef GLM_SWIZZLE
+#define GLM_SWIZZLE
+#endif
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+
+#include <glm/glm.hpp>
+
+#include "external_interface.h"
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
 #include <vector>
 
-namespace spirv_cross
-{
+// Samplers are handed to the application as an opaque pointer through the C interface.
 struct spirv_cross_sampler_2d
 {
 	inline virtual ~spirv_cross_sampler_2d()
@@ -28,6 +41,10 @@ struct spirv_cross_sampler_2d
 	}
 };
 
+namespace spirv_cross
+{
+// Abstract sampler the shader sees. There is one virtual call per texture lookup,
+// all filtering and texel decoding is done by the implementation for the format of the texture.
 template <typename T>
 struct sampler2DBase : spirv_cross_sampler_2d
 {
@@ -42,50 +59,41 @@ struct sampler2DBase : spirv_cross_sampler_2d
 		mip_filter = info->mip_filter;
 	}
 
-	inline virtual T sample(glm::vec2 uv, float bias)
+	// There are no neighbouring invocations to take derivatives from,
+	// so implicit LOD sampling uses the bias as LOD.
+	inline T sample(glm::vec2 uv, float bias) const
 	{
 		return sampleLod(uv, bias);
 	}
 
-	inline virtual T sampleLod(glm::vec2 uv, float lod)
-	{
-		if (mag_filter == SPIRV_CROSS_FILTER_NEAREST)
-		{
-			uv.x = wrap(uv.x, wrap_s, mips[0].width);
-			uv.y = wrap(uv.y, wrap_t, mips[0].height);
-			glm::vec2 uv_full = uv * glm::vec2(mips[0].width, mips[0].height);
+	virtual T sampleLod(glm::vec2 uv, float lod) const = 0;
+	virtual T fetch(glm::ivec2 coord, int lod) const = 0;
 
-			int x = int(uv_full.x);
-			int y = int(uv_full.y);
-			return sample(x, y, 0);
-		}
-		else
-		{
-			return T(0, 0, 0, 1);
-		}
+	inline T sampleGrad(glm::vec2 uv, glm::vec2 dPdx, glm::vec2 dPdy) const
+	{
+		return sampleLod(uv, compute_lod(dPdx, dPdy));
 	}
 
-	inline float wrap(float v, spirv_cross_wrap wrap, unsigned size)
+	inline glm::ivec2 size(int lod) const
 	{
-		switch (wrap)
-		{
-		case SPIRV_CROSS_WRAP_REPEAT:
-			return v - glm::floor(v);
-		case SPIRV_CROSS_WRAP_CLAMP_TO_EDGE:
-		{
-			float half = 0.5f / size;
-			return glm::clamp(v, half, 1.0f - half);
-		}
+		return glm::ivec2(int(mips[lod].width), int(mips[lod].height));
+	}
 
-		default:
-			return 0.0f;
-		}
+	// Same as the scale factor in the GL spec, with the derivatives scaled to texels of the base level.
+	inline float compute_lod(glm::vec2 dPdx, glm::vec2 dPdy) const
+	{
+		float dx_u = dPdx.x * mips[0].width;
+		float dx_v = dPdx.y * mips[0].height;
+		float dy_u = dPdy.x * mips[0].width;
+		float dy_v = dPdy.y * mips[0].height;
+		float rho2 = std::max(dx_u * dx_u + dx_v * dx_v, dy_u * dy_u + dy_v * dy_v);
+		return 0.5f * std::log2(rho2);
 	}
 
 	std::vector<spirv_cross_miplevel> mips;
 	spirv_cross_format format;
 	spirv_cross_wrap wrap_s;
-	spirv_cross_format wrap_t;
+	spirv_cross_wrap wrap_t;
 	spirv_cross_filter min_filter;
 	spirv_cross_filter mag_filter;
 	spirv_cross_mipfilter mip_filter;
@@ -95,11 +103,175 @@ typedef sampler2DBase<glm::vec4> sampler2D;
 typedef sampler2DBase<glm::ivec4> isampler2D;
 typedef sampler2DBase<glm::uvec4> usampler2D;
 
+// Decodes one texel of a format.
+template <spirv_cross_format Format>
+struct FormatTraits;
+
+template <>
+struct FormatTraits<SPIRV_CROSS_FORMAT_R8_UNORM>
+{
+	enum
+	{
+		TexelSize = 1
+	};
+	static inline glm::vec4 decode(const uint8_t *texel)
+	{
+		return glm::vec4(texel[0] * (1.0f / 255.0f), 0.0f, 0.0f, 1.0f);
+	}
+};
+
+template <>
+struct FormatTraits<SPIRV_CROSS_FORMAT_R8G8_UNORM>
+{
+	enum
+	{
+		TexelSize = 2
+	};
+	static inline glm::vec4 decode(const uint8_t *texel)
+	{
+		return glm::vec4(texel[0] * (1.0f / 255.0f), texel[1] * (1.0f / 255.0f), 0.0f, 1.0f);
+	}
+};
+
+template <>
+struct FormatTraits<SPIRV_CROSS_FORMAT_R8G8B8_UNORM>
+{
+	enum
+	{
+		TexelSize = 3
+	};
+	static inline glm::vec4 decode(const uint8_t *texel)
+	{
+		return glm::vec4(texel[0] * (1.0f / 255.0f), texel[1] * (1.0f / 255.0f), texel[2] * (1.0f / 255.0f), 1.0f);
+	}
+};
+
+template <>
+struct FormatTraits<SPIRV_CROSS_FORMAT_R8G8B8A8_UNORM>
+{
+	enum
+	{
+		TexelSize = 4
+	};
+	static inline glm::vec4 decode(const uint8_t *texel)
+	{
+		return glm::vec4(texel[0] * (1.0f / 255.0f), texel[1] * (1.0f / 255.0f), texel[2] * (1.0f / 255.0f),
+		                 texel[3] * (1.0f / 255.0f));
+	}
+};
+
+// Sampler for a specific format. All formats are normalized, so these are always float samplers.
+template <spirv_cross_format Format>
+struct sampler2DImpl : sampler2D
+{
+	sampler2DImpl(const spirv_cross_sampler_info *info)
+	    : sampler2D(info)
+	{
+	}
+
+	glm::vec4 sampleLod(glm::vec2 uv, float lod) const override
+	{
+		unsigned max_level = unsigned(mips.size()) - 1;
+
+		// Magnification never touches other levels.
+		if (lod <= 0.0f || mip_filter == SPIRV_CROSS_MIPFILTER_BASE || max_level == 0)
+			return sample_level(0, uv, lod <= 0.0f ? mag_filter : min_filter);
+
+		lod = std::min(lod, float(max_level));
+		if (mip_filter == SPIRV_CROSS_MIPFILTER_NEAREST)
+			return sample_level(unsigned(lod + 0.5f), uv, min_filter);
+
+		unsigned level = unsigned(lod);
+		float weight = lod - float(level);
+		glm::vec4 a = sample_level(level, uv, min_filter);
+		if (level == max_level)
+			return a;
+		glm::vec4 b = sample_level(level + 1, uv, min_filter);
+		return glm::mix(a, b, weight);
+	}
+
+	glm::vec4 fetch(glm::ivec2 coord, int lod) const override
+	{
+		return load(mips[lod], coord.x, coord.y);
+	}
+
+private:
+	inline glm::vec4 sample_level(unsigned level, glm::vec2 uv, spirv_cross_filter filter) const
+	{
+		auto &mip = mips[level];
+		int width = int(mip.width);
+		int height = int(mip.height);
+		float u = uv.x * width;
+		float v = uv.y * height;
+
+		if (filter == SPIRV_CROSS_FILTER_NEAREST)
+			return load(mip, wrap(int(std::floor(u)), wrap_s, width), wrap(int(std::floor(v)), wrap_t, height));
+
+		// Bilinear, between the centers of the four closest texels.
+		u -= 0.5f;
+		v -= 0.5f;
+		float u0 = std::floor(u);
+		float v0 = std::floor(v);
+		float fu = u - u0;
+		float fv = v - v0;
+
+		int x0 = wrap(int(u0), wrap_s, width);
+		int x1 = wrap(int(u0) + 1, wrap_s, width);
+		int y0 = wrap(int(v0), wrap_t, height);
+		int y1 = wrap(int(v0) + 1, wrap_t, height);
+
+		glm::vec4 top = glm::mix(load(mip, x0, y0), load(mip, x1, y0), fu);
+		glm::vec4 bottom = glm::mix(load(mip, x0, y1), load(mip, x1, y1), fu);
+		return glm::mix(top, bottom, fv);
+	}
+
+	static inline int wrap(int coord, spirv_cross_wrap mode, int size)
+	{
+		if (mode == SPIRV_CROSS_WRAP_REPEAT)
+		{
+			coord %= size;
+			return coord < 0 ? coord + size : coord;
+		}
+		else
+			return coord < 0 ? 0 : (coord >= size ? size - 1 : coord);
+	}
+
+	static inline glm::vec4 load(const spirv_cross_miplevel &mip, int x, int y)
+	{
+		auto *row = static_cast<const uint8_t *>(mip.data) + size_t(y) * mip.stride;
+		return FormatTraits<Format>::decode(row + size_t(x) * FormatTraits<Format>::TexelSize);
+	}
+};
+
 template <typename T>
 inline T texture(const sampler2DBase<T> &samp, const glm::vec2 &uv, float bias = 0.0f)
 {
 	return samp.sample(uv, bias);
 }
+
+template <typename T>
+inline T textureLod(const sampler2DBase<T> &samp, const glm::vec2 &uv, float lod)
+{
+	return samp.sampleLod(uv, lod);
+}
+
+template <typename T>
+inline T textureGrad(const sampler2DBase<T> &samp, const glm::vec2 &uv, const glm::vec2 &dPdx, const glm::vec2 &dPdy)
+{
+	return samp.sampleGrad(uv, dPdx, dPdy);
+}
+
+template <typename T>
+inline T texelFetch(const sampler2DBase<T> &samp, const glm::ivec2 &coord, int lod)
+{
+	return samp.fetch(coord, lod);
+}
+
+template <typename T>
+inline glm::ivec2 textureSize(const sampler2DBase<T> &samp, int lod)
+{
+	return samp.size(lod);
+}
 }
 
 #endif
@@ -14,18 +14,33 @@
  * limitations under the License.
  */
 
+#include "heap_counter.hpp"
+#include "spirv_compile_cache.hpp"
 #include "spirv_cpp.hpp"
 #include "spirv_msl.hpp"
+#include "spirv_reflection.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace spv;
 using namespace spirv_cross;
 using namespace std;
@@ -167,12 +182,73 @@ static vector<uint32_t> read_spirv_file(const char *path)
 	return spirv;
 }
 
+// SPIR-V words of a file, and whatever keeps them alive.
+struct SPIRVFile
+{
+	const uint32_t *words = nullptr;
+	size_t word_count = 0;
+	shared_ptr<const void> owner;
+};
+
+// What --stats reports for one shader.
+struct CompileStats
+{
+	CompilerStats compiler;
+	// Everything compile_shader() allocates, including creating the compiler and every iteration.
+	uint64_t heap_allocation_count = 0;
+	uint64_t heap_allocation_bytes = 0;
+	double milliseconds = 0.0;
+};
+
+// Memory maps the file so that the SPIR-V is parsed in place instead of being copied.
+// Falls back to reading the file where that is not possible.
+static SPIRVFile load_spirv_file(const char *path)
+{
+	SPIRVFile file;
+
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0)
+	{
+		struct stat st;
+		void *mapping = MAP_FAILED;
+		size_t size = 0;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			size = size_t(st.st_size);
+			mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+
+		if (mapping != MAP_FAILED)
+		{
+			// The mapping lives as long as the parsed IR and every compiler created from it.
+			file.owner = shared_ptr<const void>(mapping, [size](const void *p) { munmap(const_cast<void *>(p), size); });
+			file.words = static_cast<const uint32_t *>(mapping);
+			file.word_count = size / sizeof(uint32_t);
+			return file;
+		}
+	}
+#endif
+
+	auto words = make_shared<vector<uint32_t>>(read_spirv_file(path));
+	file.words = words->data();
+	file.word_count = words->size();
+	file.owner = move(words);
+	return file;
+}
+
+static shared_ptr<const ParsedIR> parse_spirv_file(const SPIRVFile &file)
+{
+	return Compiler::parse_ir(file.words, file.word_count, file.owner);
+}
+
 static bool write_string_to_file(const char *path, const char *string)
 {
 	FILE *file = fopen(path, "w");
 	if (!file)
 	{
-		fprintf(file, "Failed to write file: %s\n", path);
+		fprintf(stderr, "Failed to write file: %s\n", path);
 		return false;
 	}
 
@@ -181,6 +257,58 @@ static bool write_string_to_file(const char *path, const char *string)
 	return true;
 }
 
+static bool write_words_to_file(const char *path, const vector<uint32_t> &words)
+{
+	FILE *file = fopen(path, "wb");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to write file: %s\n", path);
+		return false;
+	}
+
+	bool ret = fwrite(words.data(), sizeof(uint32_t), words.size(), file) == words.size();
+	fclose(file);
+	return ret;
+}
+
+static void print_json_string(FILE *file, const char *str)
+{
+	fputc('"', file);
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			fprintf(file, "\\%c", *str);
+		else if (uint8_t(*str) < 0x20)
+			fprintf(file, "\\u%04x", unsigned(uint8_t(*str)));
+		else
+			fputc(*str, file);
+	}
+	fputc('"', file);
+}
+
+static void print_stats_json(FILE *file, const char *input, const char *output, const CompileStats &stats)
+{
+	auto &c = stats.compiler;
+	fprintf(file, "{ \"input\": ");
+	print_json_string(file, input);
+	if (output)
+	{
+		fprintf(file, ", \"output\": ");
+		print_json_string(file, output);
+	}
+	fprintf(file, ", \"compile_milliseconds\": %.3f, \"phases\": { ", stats.milliseconds);
+	for (uint32_t i = 0; i < CompilerPhaseCount; i++)
+		fprintf(file, "%s\"%s\": %.3f", i ? ", " : "", compiler_phase_to_string(CompilerPhase(i)),
+		        c.phase_milliseconds[i]);
+	fprintf(file,
+	        " }, \"recompile_count\": %u, \"instruction_count\": %u, \"id_count\": %u, \"output_bytes\": %llu, "
+	        "\"ir_allocation_count\": %llu, \"ir_allocation_bytes\": %llu, \"heap_allocation_count\": %llu, "
+	        "\"heap_allocation_bytes\": %llu }",
+	        c.recompile_count, c.instruction_count, c.id_count, (unsigned long long)c.output_bytes,
+	        (unsigned long long)c.allocation_count, (unsigned long long)c.allocation_bytes,
+	        (unsigned long long)stats.heap_allocation_count, (unsigned long long)stats.heap_allocation_bytes);
+}
+
 static void print_resources(const Compiler &compiler, const char *tag, const vector<Resource> &resources)
 {
 	fprintf(stderr, "%s\n", tag);
@@ -363,6 +491,10 @@ struct CLIArguments
 	const char *input = nullptr;
 	const char *output = nullptr;
 	const char *cpp_interface_name = nullptr;
+	uint32_t cpp_simd_width = 1;
+	bool cpp_typed_resources = false;
+	uint32_t emit_threads = 1;
+	const char *reflection = nullptr;
 	uint32_t version = 0;
 	bool es = false;
 	bool set_version = false;
@@ -380,16 +512,30 @@ struct CLIArguments
 	uint32_t iterations = 1;
 	bool cpp = false;
 	bool metal = false;
+	bool msl_argument_buffers = false;
 	bool vulkan_semantics = false;
+	bool strip_unused_resources = false;
+	bool minify = false;
+	CompilerGLSL::Options::PrecisionLowering precision_lowering = CompilerGLSL::Options::NoLowering;
+
+	const char *batch = nullptr;
+	uint32_t threads = 0;
+	const char *cache_dir = nullptr;
+	uint32_t cache_size = 0;
+	const char *stats = nullptr;
 };
 
 static void print_help()
 {
 	fprintf(stderr, "Usage: spirv-cross [--output <output path>] [SPIR-V file] [--es] [--no-es] [--version <GLSL "
 	                "version>] [--dump-resources] [--help] [--force-temporary] [--cpp] [--cpp-interface-name <name>] "
-	                "[--metal] [--vulkan-semantics] [--flatten-ubo] [--fixup-clipspace] [--iterations iter] [--pls-in "
-	                "format input-name] [--pls-out format output-name] [--remap source_name target_name components] "
-	                "[--extension ext] [--entry name]\n");
+	                "[--cpp-simd-width <lanes>] [--cpp-typed-resources] [--emit-threads count] [--metal] "
+	                "[--msl-argument-buffers] [--vulkan-semantics] [--strip-unused-resources] [--minify] "
+	                "[--precision-lowering none|conservative|aggressive] [--flatten-ubo] [--fixup-clipspace] "
+	                "[--iterations iter] [--pls-in format input-name] [--pls-out format output-name] "
+	                "[--remap source_name target_name components] [--extension ext] [--entry name] "
+	                "[--reflection <reflection path>] [--batch manifest] [--threads count] [--cache-dir directory] "
+	                "[--cache-size entries] [--stats <stats path>]\n");
 }
 
 static bool remap_generic(Compiler &compiler, const vector<Resource> &resources, const Remap &remap)
@@ -476,15 +622,8 @@ static PlsFormat pls_format(const char *str)
 		return PlsNone;
 }
 
-int main(int argc, char *argv[])
+static void add_compile_options(CLICallbacks &cbs, CLIArguments &args)
 {
-	CLIArguments args;
-	CLICallbacks cbs;
-
-	cbs.add("--help", [](CLIParser &parser) {
-		print_help();
-		parser.end();
-	});
 	cbs.add("--output", [&args](CLIParser &parser) { args.output = parser.next_string(); });
 	cbs.add("--es", [&args](CLIParser &) {
 		args.es = true;
@@ -499,14 +638,32 @@ int main(int argc, char *argv[])
 		args.set_version = true;
 	});
 	cbs.add("--dump-resources", [&args](CLIParser &) { args.dump_resources = true; });
+	cbs.add("--reflection", [&args](CLIParser &parser) { args.reflection = parser.next_string(); });
 	cbs.add("--force-temporary", [&args](CLIParser &) { args.force_temporary = true; });
 	cbs.add("--flatten-ubo", [&args](CLIParser &) { args.flatten_ubo = true; });
 	cbs.add("--fixup-clipspace", [&args](CLIParser &) { args.fixup = true; });
 	cbs.add("--iterations", [&args](CLIParser &parser) { args.iterations = parser.next_uint(); });
 	cbs.add("--cpp", [&args](CLIParser &) { args.cpp = true; });
 	cbs.add("--cpp-interface-name", [&args](CLIParser &parser) { args.cpp_interface_name = parser.next_string(); });
+	cbs.add("--cpp-simd-width", [&args](CLIParser &parser) { args.cpp_simd_width = parser.next_uint(); });
+	cbs.add("--cpp-typed-resources", [&args](CLIParser &) { args.cpp_typed_resources = true; });
+	cbs.add("--emit-threads", [&args](CLIParser &parser) { args.emit_threads = parser.next_uint(); });
 	cbs.add("--metal", [&args](CLIParser &) { args.metal = true; });
+	cbs.add("--msl-argument-buffers", [&args](CLIParser &) { args.msl_argument_buffers = true; });
 	cbs.add("--vulkan-semantics", [&args](CLIParser &) { args.vulkan_semantics = true; });
+	cbs.add("--strip-unused-resources", [&args](CLIParser &) { args.strip_unused_resources = true; });
+	cbs.add("--minify", [&args](CLIParser &) { args.minify = true; });
+	cbs.add("--precision-lowering", [&args](CLIParser &parser) {
+		string mode = parser.next_string();
+		if (mode == "none")
+			args.precision_lowering = CompilerGLSL::Options::NoLowering;
+		else if (mode == "conservative")
+			args.precision_lowering = CompilerGLSL::Options::ConservativeLowering;
+		else if (mode == "aggressive")
+			args.precision_lowering = CompilerGLSL::Options::AggressiveLowering;
+		else
+			throw logic_error("Precision lowering must be none, conservative or aggressive.\n");
+	});
 	cbs.add("--extension", [&args](CLIParser &parser) { args.extensions.push_back(parser.next_string()); });
 	cbs.add("--entry", [&args](CLIParser &parser) { args.entry = parser.next_string(); });
 	cbs.add("--remap", [&args](CLIParser &parser) {
@@ -528,47 +685,38 @@ int main(int argc, char *argv[])
 	});
 
 	cbs.default_handler = [&args](const char *value) { args.input = value; };
-	cbs.error_handler = [] { print_help(); };
-
-	CLIParser parser{ move(cbs), argc - 1, argv + 1 };
-	if (!parser.parse())
-	{
-		return EXIT_FAILURE;
-	}
-	else if (parser.ended_state)
-	{
-		return EXIT_SUCCESS;
-	}
+}
 
-	if (!args.input)
-	{
-		fprintf(stderr, "Didn't specify input file.\n");
-		print_help();
-		return EXIT_FAILURE;
-	}
+static string compile_shader(const CLIArguments &args, const shared_ptr<const ParsedIR> &ir,
+                             CompileStats *stats = nullptr)
+{
+	auto start_time = chrono::steady_clock::now();
+	uint64_t start_allocation_count = heap_allocation_count;
+	uint64_t start_allocation_bytes = heap_allocation_bytes;
 
 	unique_ptr<CompilerGLSL> compiler;
 
 	if (args.cpp)
 	{
-		compiler = unique_ptr<CompilerGLSL>(new CompilerCPP(read_spirv_file(args.input)));
+		compiler = unique_ptr<CompilerGLSL>(new CompilerCPP(ir));
 		if (args.cpp_interface_name)
 			static_cast<CompilerCPP *>(compiler.get())->set_interface_name(args.cpp_interface_name);
+		static_cast<CompilerCPP *>(compiler.get())->set_simd_width(args.cpp_simd_width);
+		static_cast<CompilerCPP *>(compiler.get())->set_typed_resources(args.cpp_typed_resources);
 	}
 	else if (args.metal)
-		compiler = unique_ptr<CompilerMSL>(new CompilerMSL(read_spirv_file(args.input)));
+		compiler = unique_ptr<CompilerMSL>(new CompilerMSL(ir));
 	else
-		compiler = unique_ptr<CompilerGLSL>(new CompilerGLSL(read_spirv_file(args.input)));
+		compiler = unique_ptr<CompilerGLSL>(new CompilerGLSL(ir));
 
 	if (!args.entry.empty())
 		compiler->set_entry_point(args.entry);
+	if (stats)
+		compiler->set_stats_enabled(true);
+	compiler->set_emit_thread_count(args.emit_threads);
 
 	if (!args.set_version && !compiler->get_options().version)
-	{
-		fprintf(stderr, "Didn't specify GLSL version and SPIR-V did not specify language.\n");
-		print_help();
-		return EXIT_FAILURE;
-	}
+		throw runtime_error("Didn't specify GLSL version and SPIR-V did not specify language.");
 
 	CompilerGLSL::Options opts = compiler->get_options();
 	if (args.set_version)
@@ -577,11 +725,22 @@ int main(int argc, char *argv[])
 		opts.es = args.es;
 	opts.force_temporary = args.force_temporary;
 	opts.vulkan_semantics = args.vulkan_semantics;
+	opts.strip_unused_resources = args.strip_unused_resources;
+	opts.minify = args.minify;
+	opts.precision_lowering = args.precision_lowering;
 	opts.vertex.fixup_clipspace = args.fixup;
 	compiler->set_options(opts);
 
 	auto res = compiler->get_shader_resources();
 
+	// Reflect before flattening and remapping, so the blob describes the module itself.
+	if (args.reflection)
+	{
+		auto blob = build_reflection_blob(*compiler, hash_spirv(ir->spirv, ir->spirv_word_count));
+		if (!write_words_to_file(args.reflection, blob))
+			throw runtime_error("Failed to write reflection file.");
+	}
+
 	if (args.flatten_ubo)
 		for (auto &ubo : res.uniform_buffers)
 			compiler->flatten_interface_block(ubo.id);
@@ -609,12 +768,353 @@ int main(int argc, char *argv[])
 		print_push_constant_resources(*compiler, res.push_constant_buffers);
 	}
 
+	MSLConfiguration msl_config;
+	msl_config.argument_buffers = args.msl_argument_buffers;
+
 	string glsl;
 	for (uint32_t i = 0; i < args.iterations; i++)
-		glsl = compiler->compile();
+		glsl = args.metal ? static_cast<CompilerMSL *>(compiler.get())->compile(msl_config) : compiler->compile();
+
+	if (stats)
+	{
+		stats->compiler = compiler->get_stats();
+		stats->heap_allocation_count = heap_allocation_count - start_allocation_count;
+		stats->heap_allocation_bytes = heap_allocation_bytes - start_allocation_bytes;
+		stats->milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+	}
+
+	return glsl;
+}
+
+// A batch job is one line of the manifest, which is parsed like a regular command line.
+struct BatchJob
+{
+	vector<string> tokens;
+	CLIArguments args;
+	string error;
+	double milliseconds = 0.0;
+	bool cached = false;
+	CompileStats stats;
+};
+
+// Every argument which affects the emitted source, iterations and output paths do not.
+static CompileCacheKey make_cache_key(const CLIArguments &args, const SPIRVFile &file)
+{
+	CompileCacheKey key;
+	key.add_spirv(file.words, file.word_count);
+	key.add(args.cpp ? "cpp" : args.metal ? "msl" : "glsl");
+	key.add(args.msl_argument_buffers);
+	key.add(args.cpp_interface_name ? args.cpp_interface_name : "");
+	key.add(args.cpp_simd_width);
+	key.add(args.cpp_typed_resources);
+	key.add(args.entry);
+	key.add(args.set_version ? args.version : 0u);
+	key.add(args.set_es ? uint32_t(args.es) + 1 : 0u);
+	key.add(args.force_temporary);
+	key.add(args.flatten_ubo);
+	key.add(args.fixup);
+	key.add(args.vulkan_semantics);
+	key.add(args.strip_unused_resources);
+	key.add(args.minify);
+	key.add(uint32_t(args.precision_lowering));
+
+	key.add(uint32_t(args.pls_in.size()));
+	for (auto &pls : args.pls_in)
+		key.add(uint32_t(pls.format)).add(pls.name);
+	key.add(uint32_t(args.pls_out.size()));
+	for (auto &pls : args.pls_out)
+		key.add(uint32_t(pls.format)).add(pls.name);
+	key.add(uint32_t(args.remaps.size()));
+	for (auto &remap : args.remaps)
+		key.add(remap.src_name).add(remap.dst_name).add(remap.components);
+	key.add(uint32_t(args.extensions.size()));
+	for (auto &ext : args.extensions)
+		key.add(ext);
+
+	return key;
+}
+
+static bool read_batch_manifest(const char *path, const CLIArguments &defaults, vector<unique_ptr<BatchJob>> &jobs)
+{
+	ifstream file(path);
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open batch manifest: %s\n", path);
+		return false;
+	}
+
+	bool ret = true;
+	uint32_t line_number = 0;
+	string line;
+	while (getline(file, line))
+	{
+		line_number++;
+
+		// Lines are whitespace separated arguments, # starts a comment.
+		unique_ptr<BatchJob> job(new BatchJob);
+		const char *c = line.c_str();
+		while (*c && *c != '#')
+		{
+			while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+				c++;
+			const char *first = c;
+			while (*c && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n' && *c != '#')
+				c++;
+			if (c != first)
+				job->tokens.emplace_back(first, c);
+		}
+
+		if (job->tokens.empty())
+			continue;
+
+		// Options given on the command line apply to every job.
+		job->args = defaults;
+		job->args.input = nullptr;
+		job->args.output = nullptr;
+
+		vector<char *> argv;
+		for (auto &token : job->tokens)
+			argv.push_back(&token[0]);
+
+		CLICallbacks cbs;
+		add_compile_options(cbs, job->args);
+		cbs.error_handler = [&] { fprintf(stderr, "%s:%u: Invalid arguments.\n", path, line_number); };
+
+		CLIParser parser{ move(cbs), int(argv.size()), argv.data() };
+		if (!parser.parse())
+		{
+			ret = false;
+			continue;
+		}
+
+		if (!job->args.input || !job->args.output)
+		{
+			fprintf(stderr, "%s:%u: Batch jobs need both an input file and --output.\n", path, line_number);
+			ret = false;
+			continue;
+		}
+
+		jobs.push_back(move(job));
+	}
+
+	return ret;
+}
+
+static int run_batch(const CLIArguments &args)
+{
+	vector<unique_ptr<BatchJob>> jobs;
+	if (!read_batch_manifest(args.batch, args, jobs))
+		return EXIT_FAILURE;
+
+	uint32_t thread_count = args.threads ? args.threads : thread::hardware_concurrency();
+	thread_count = max(1u, min(thread_count, uint32_t(jobs.size())));
+
+	// Unchanged shaders are not compiled again if the cache has them.
+	unique_ptr<CompileCache> cache;
+	if (args.cache_dir || args.cache_size)
+		cache.reset(new CompileCache(args.cache_size ? args.cache_size : 256, args.cache_dir ? args.cache_dir : ""));
+
+	// The same input is often compiled with several options, so load and parse every input only once.
+	// Parsing is deferred until a job misses the cache.
+	struct BatchInput
+	{
+		// Held while the file is loaded or parsed, so other jobs for the same input wait for the result.
+		mutex lock;
+		bool loaded = false;
+		SPIRVFile file;
+		shared_ptr<const ParsedIR> ir;
+	};
+
+	mutex input_lock;
+	unordered_map<string, shared_ptr<BatchInput>> inputs;
+	auto get_input = [&](const char *path) -> shared_ptr<BatchInput> {
+		shared_ptr<BatchInput> input;
+		{
+			lock_guard<mutex> holder{ input_lock };
+			auto &slot = inputs[path];
+			if (!slot)
+				slot = make_shared<BatchInput>();
+			input = slot;
+		}
+
+		lock_guard<mutex> holder{ input->lock };
+		if (!input->loaded)
+		{
+			input->file = load_spirv_file(path);
+			input->loaded = true;
+		}
+		return input;
+	};
+
+	auto get_ir = [&](BatchInput &input) -> shared_ptr<const ParsedIR> {
+		lock_guard<mutex> holder{ input.lock };
+		if (!input.ir)
+			input.ir = parse_spirv_file(input.file);
+		return input.ir;
+	};
+
+	atomic<size_t> next_job{ 0 };
+	auto worker = [&] {
+		size_t index;
+		while ((index = next_job++) < jobs.size())
+		{
+			auto &job = *jobs[index];
+			auto start_time = chrono::steady_clock::now();
+
+			// An error in one job must not stop the rest of the batch.
+			try
+			{
+				auto input = get_input(job.args.input);
+
+				// Resource dumps and reflection files are side effects a cached result would skip.
+				bool use_cache = cache && !job.args.dump_resources && !job.args.reflection;
+				CompileCacheKey key;
+				if (use_cache)
+					key = make_cache_key(job.args, input->file);
+
+				string glsl;
+				job.cached = use_cache && cache->find(key, glsl);
+				if (!job.cached)
+				{
+					glsl = compile_shader(job.args, get_ir(*input), args.stats ? &job.stats : nullptr);
+					if (use_cache)
+						cache->insert(key, glsl);
+				}
+
+				if (!write_string_to_file(job.args.output, glsl.c_str()))
+					job.error = "Failed to write output file.";
+			}
+			catch (const exception &e)
+			{
+				job.error = e.what();
+			}
+
+			auto end_time = chrono::steady_clock::now();
+			job.milliseconds = chrono::duration<double, milli>(end_time - start_time).count();
+		}
+	};
+
+	auto start_time = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (uint32_t i = 1; i < thread_count; i++)
+		workers.emplace_back(worker);
+	worker();
+	for (auto &t : workers)
+		t.join();
+	auto end_time = chrono::steady_clock::now();
+
+	uint32_t failed = 0;
+	for (auto &job : jobs)
+	{
+		if (job->error.empty())
+			fprintf(stderr, "%s -> %s: %.3f ms%s\n", job->args.input, job->args.output, job->milliseconds,
+			        job->cached ? " (cached)" : "");
+		else
+		{
+			fprintf(stderr, "%s -> %s: FAILED: %s\n", job->args.input, job->args.output, job->error.c_str());
+			failed++;
+		}
+	}
+
+	fprintf(stderr, "Compiled %u of %u shaders with %u threads in %.3f ms.\n", unsigned(jobs.size() - failed),
+	        unsigned(jobs.size()), thread_count, chrono::duration<double, milli>(end_time - start_time).count());
+
+	if (cache)
+		fprintf(stderr, "%u of %u shaders were found in the cache.\n", cache->get_hit_count(),
+		        cache->get_hit_count() + cache->get_miss_count());
+
+	// Cached and failed shaders were not compiled, so they have no stats.
+	if (args.stats)
+	{
+		FILE *file = fopen(args.stats, "w");
+		if (!file)
+		{
+			fprintf(stderr, "Failed to write file: %s\n", args.stats);
+			return EXIT_FAILURE;
+		}
+
+		fprintf(file, "[\n");
+		bool first = true;
+		for (auto &job : jobs)
+		{
+			if (job->cached || !job->error.empty())
+				continue;
+			fprintf(file, "%s\t", first ? "" : ",\n");
+			print_stats_json(file, job->args.input, job->args.output, job->stats);
+			first = false;
+		}
+		fprintf(file, "\n]\n");
+		fclose(file);
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	CLIArguments args;
+	CLICallbacks cbs;
+
+	cbs.add("--help", [](CLIParser &parser) {
+		print_help();
+		parser.end();
+	});
+	cbs.add("--batch", [&args](CLIParser &parser) { args.batch = parser.next_string(); });
+	cbs.add("--threads", [&args](CLIParser &parser) { args.threads = parser.next_uint(); });
+	cbs.add("--cache-dir", [&args](CLIParser &parser) { args.cache_dir = parser.next_string(); });
+	cbs.add("--cache-size", [&args](CLIParser &parser) { args.cache_size = parser.next_uint(); });
+	cbs.add("--stats", [&args](CLIParser &parser) { args.stats = parser.next_string(); });
+	add_compile_options(cbs, args);
+	cbs.error_handler = [] { print_help(); };
+
+	CLIParser parser{ move(cbs), argc - 1, argv + 1 };
+	if (!parser.parse())
+	{
+		return EXIT_FAILURE;
+	}
+	else if (parser.ended_state)
+	{
+		return EXIT_SUCCESS;
+	}
+
+	if (args.batch)
+		return run_batch(args);
+
+	if (!args.input)
+	{
+		fprintf(stderr, "Didn't specify input file.\n");
+		print_help();
+		return EXIT_FAILURE;
+	}
+
+	string glsl;
+	CompileStats stats;
+	try
+	{
+		glsl = compile_shader(args, parse_spirv_file(load_spirv_file(args.input)), args.stats ? &stats : nullptr);
+	}
+	catch (const runtime_error &e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
 
 	if (args.output)
 		write_string_to_file(args.output, glsl.c_str());
 	else
 		printf("%s", glsl.c_str());
+
+	if (args.stats)
+	{
+		FILE *file = fopen(args.stats, "w");
+		if (!file)
+		{
+			fprintf(stderr, "Failed to write file: %s\n", args.stats);
+			return EXIT_FAILURE;
+		}
+
+		print_stats_json(file, args.input, args.output, stats);
+		fprintf(file, "\n");
+		fclose(file);
+	}
 }
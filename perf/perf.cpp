@@ -0,0 +1,354 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles a corpus of SPIR-V modules in-process, over and over, and reports how fast each stage is.
+// All modules are read into memory up front, so only parsing and compiling is timed.
+
+#include "heap_counter.hpp"
+#include "spirv_cpp.hpp"
+#include "spirv_msl.hpp"
+#include "spirv_reflection.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace spirv_cross;
+using namespace std;
+
+enum Stage
+{
+	StageParse,
+	StageReflect,
+	StageGLSL,
+	StageMSL,
+	StageCPP,
+	StageCount
+};
+
+static const char *stage_names[StageCount] = { "parse", "reflect", "glsl", "msl", "cpp" };
+
+struct Module
+{
+	string path;
+	vector<uint32_t> words;
+	shared_ptr<const ParsedIR> ir;
+	uint64_t hash = 0;
+};
+
+// One run of a stage on a module.
+struct Sample
+{
+	double milliseconds = 0.0;
+	uint64_t allocations = 0;
+	uint32_t recompiles = 0;
+	bool failed = false;
+};
+
+struct StageResult
+{
+	uint32_t threads = 0;
+	Stage stage = StageParse;
+	double shaders_per_second = 0.0;
+	double megabytes_per_second = 0.0;
+	double allocations_per_shader = 0.0;
+	double recompiles_per_shader = 0.0;
+	uint32_t max_recompiles = 0;
+	double p50_milliseconds = 0.0;
+	double p99_milliseconds = 0.0;
+	size_t failed = 0;
+};
+
+static bool read_module(const char *path, Module &module)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long len = ftell(file) / sizeof(uint32_t);
+	rewind(file);
+
+	module.path = path;
+	module.words.resize(len);
+	bool ok = fread(module.words.data(), sizeof(uint32_t), len, file) == size_t(len);
+	fclose(file);
+	return ok && len > 0;
+}
+
+// Compiles the module as GLSL 450 unless the module gives a version itself.
+// Unlike the CLI, which refuses such modules, this lets every test module be measured.
+static uint32_t compile_module(CompilerGLSL &compiler)
+{
+	auto options = compiler.get_options();
+	if (!options.version)
+	{
+		options.version = 450;
+		compiler.set_options(options);
+	}
+
+	compiler.set_stats_enabled(true);
+	compiler.compile();
+	return compiler.get_stats().recompile_count;
+}
+
+static uint32_t run_stage(Stage stage, const Module &module)
+{
+	switch (stage)
+	{
+	case StageParse:
+		Compiler::parse_ir(module.words.data(), module.words.size());
+		return 0;
+
+	case StageReflect:
+	{
+		CompilerGLSL compiler(module.ir);
+		compiler.get_shader_resources();
+		build_reflection_blob(compiler, module.hash);
+		return 0;
+	}
+
+	case StageGLSL:
+	{
+		CompilerGLSL compiler(module.ir);
+		return compile_module(compiler);
+	}
+
+	case StageMSL:
+	{
+		CompilerMSL compiler(module.ir);
+		return compile_module(compiler);
+	}
+
+	case StageCPP:
+	{
+		CompilerCPP compiler(module.ir);
+		return compile_module(compiler);
+	}
+
+	default:
+		return 0;
+	}
+}
+
+static double percentile(vector<double> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t index = min(sorted.size() - 1, size_t(p * sorted.size()));
+	return sorted[index];
+}
+
+// Runs every module iterations times on thread_count threads, which pick modules from a shared counter.
+static StageResult measure(Stage stage, const vector<Module> &modules, uint32_t iterations, uint32_t thread_count)
+{
+	size_t job_count = modules.size() * iterations;
+	vector<Sample> samples(job_count);
+	atomic<size_t> next_job(0);
+
+	auto worker = [&]() {
+		for (;;)
+		{
+			size_t job = next_job.fetch_add(1, memory_order_relaxed);
+			if (job >= job_count)
+				break;
+
+			auto &sample = samples[job];
+			uint64_t start_allocations = heap_allocation_count;
+			auto start = chrono::steady_clock::now();
+			try
+			{
+				sample.recompiles = run_stage(stage, modules[job % modules.size()]);
+			}
+			catch (const exception &)
+			{
+				sample.failed = true;
+			}
+			sample.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			sample.allocations = heap_allocation_count - start_allocations;
+		}
+	};
+
+	auto start = chrono::steady_clock::now();
+	vector<thread> threads;
+	for (uint32_t i = 1; i < thread_count; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &t : threads)
+		t.join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	StageResult result;
+	result.threads = thread_count;
+	result.stage = stage;
+
+	vector<double> latencies;
+	uint64_t bytes = 0;
+	uint64_t allocations = 0;
+	uint64_t recompiles = 0;
+	for (size_t i = 0; i < job_count; i++)
+	{
+		auto &sample = samples[i];
+		if (sample.failed)
+		{
+			result.failed++;
+			continue;
+		}
+
+		latencies.push_back(sample.milliseconds);
+		bytes += modules[i % modules.size()].words.size() * sizeof(uint32_t);
+		allocations += sample.allocations;
+		recompiles += sample.recompiles;
+		result.max_recompiles = max(result.max_recompiles, sample.recompiles);
+	}
+
+	if (!latencies.empty())
+	{
+		result.shaders_per_second = latencies.size() / seconds;
+		result.megabytes_per_second = bytes / (1024.0 * 1024.0) / seconds;
+		result.allocations_per_shader = double(allocations) / latencies.size();
+		result.recompiles_per_shader = double(recompiles) / latencies.size();
+	}
+
+	sort(begin(latencies), end(latencies));
+	result.p50_milliseconds = percentile(latencies, 0.50);
+	result.p99_milliseconds = percentile(latencies, 0.99);
+	return result;
+}
+
+static void print_json(FILE *file, const vector<StageResult> &results)
+{
+	fprintf(file, "[\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		auto &r = results[i];
+		fprintf(file,
+		        "  { \"stage\": \"%s\", \"threads\": %u, \"shaders_per_second\": %.1f, \"megabytes_per_second\": %.3f, "
+		        "\"allocations_per_shader\": %.1f, \"recompiles_per_shader\": %.3f, \"max_recompiles\": %u, "
+		        "\"p50_milliseconds\": %.4f, \"p99_milliseconds\": %.4f, \"failed\": %llu }%s\n",
+		        stage_names[r.stage], r.threads, r.shaders_per_second, r.megabytes_per_second,
+		        r.allocations_per_shader, r.recompiles_per_shader, r.max_recompiles, r.p50_milliseconds,
+		        r.p99_milliseconds, (unsigned long long)r.failed, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "]\n");
+}
+
+static void print_help()
+{
+	fprintf(stderr, "Usage: spirv-cross-perf-driver [--iterations count] [--threads count] [--json <path>] "
+	                "[SPIR-V file]...\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t iterations = 10;
+	uint32_t thread_count = thread::hardware_concurrency();
+	const char *json = nullptr;
+	vector<Module> modules;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--iterations") && has_value)
+			iterations = uint32_t(strtoul(argv[++i], nullptr, 0));
+		else if (!strcmp(argv[i], "--threads") && has_value)
+			thread_count = uint32_t(strtoul(argv[++i], nullptr, 0));
+		else if (!strcmp(argv[i], "--json") && has_value)
+			json = argv[++i];
+		else if (argv[i][0] == '-')
+		{
+			print_help();
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			Module module;
+			if (!read_module(argv[i], module))
+			{
+				fprintf(stderr, "Failed to read SPIR-V file: %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+			modules.push_back(move(module));
+		}
+	}
+
+	if (modules.empty() || iterations == 0)
+	{
+		print_help();
+		return EXIT_FAILURE;
+	}
+	thread_count = max(thread_count, 1u);
+
+	size_t corpus_bytes = 0;
+	for (auto &module : modules)
+	{
+		try
+		{
+			module.ir = Compiler::parse_ir(module.words.data(), module.words.size());
+		}
+		catch (const exception &e)
+		{
+			fprintf(stderr, "Failed to parse %s: %s\n", module.path.c_str(), e.what());
+			return EXIT_FAILURE;
+		}
+		module.hash = hash_spirv(module.words.data(), module.words.size());
+		corpus_bytes += module.words.size() * sizeof(uint32_t);
+	}
+
+	printf("%u modules, %.3f MB of SPIR-V, %u iterations\n", unsigned(modules.size()),
+	       corpus_bytes / (1024.0 * 1024.0), iterations);
+	printf("%-8s %-8s %12s %10s %14s %11s %9s %9s %7s\n", "threads", "stage", "shaders/s", "MB/s", "allocs/shader",
+	       "recompiles", "p50 ms", "p99 ms", "failed");
+
+	vector<StageResult> results;
+	vector<uint32_t> thread_counts = { 1 };
+	if (thread_count > 1)
+		thread_counts.push_back(thread_count);
+
+	for (auto threads : thread_counts)
+	{
+		for (int stage = 0; stage < StageCount; stage++)
+		{
+			// Warm up the allocator and caches before measuring.
+			measure(Stage(stage), modules, 1, threads);
+
+			auto r = measure(Stage(stage), modules, iterations, threads);
+			printf("%-8u %-8s %12.1f %10.2f %14.1f %7.3f/%-3u %9.4f %9.4f %7llu\n", r.threads, stage_names[r.stage],
+			       r.shaders_per_second, r.megabytes_per_second, r.allocations_per_shader, r.recompiles_per_shader,
+			       r.max_recompiles, r.p50_milliseconds, r.p99_milliseconds, (unsigned long long)r.failed);
+			results.push_back(r);
+		}
+	}
+
+	if (json)
+	{
+		FILE *file = fopen(json, "w");
+		if (!file)
+		{
+			fprintf(stderr, "Failed to write file: %s\n", json);
+			return EXIT_FAILURE;
+		}
+		print_json(file, results);
+		fclose(file);
+	}
+
+	return EXIT_SUCCESS;
+}
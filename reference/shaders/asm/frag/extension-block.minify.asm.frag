@@ -0,0 +1,3 @@
+#version 450
+#extension GL_ARB_gpu_shader_int64 : require
+layout(binding = 0, std140) uniform UBO{vec4 tint;uint64_t frame;} _8;layout(location = 0) in vec4 vColor;layout(location = 0) out vec4 FragColor;vec4 _a(vec4 _b){vec4 _c = (_b * _8.tint);return (_c + _c);}void main(){vec4 _d = vColor;FragColor = (_a(_d) * float(_8.frame));}
@@ -0,0 +1,22 @@
+#version 450
+
+layout(binding = 0, std430) buffer SSBO
+{
+    float value;
+} ssbo;
+
+layout(location = 0) in float vValue;
+layout(location = 0) out vec4 FragColor;
+
+void store_value(float hv)
+{
+    ssbo.value = hv;
+}
+
+void main()
+{
+    float param = vValue;
+    store_value(param);
+    FragColor = vec4(vValue);
+}
+
@@ -0,0 +1,21 @@
+#version 450
+
+struct S
+{
+    vec4 a;
+};
+
+layout(binding = 0, std140) uniform UBO
+{
+    S s;
+} ubo;
+
+layout(location = 0) out vec4 FragColor;
+vec4 priv;
+
+void main()
+{
+    priv = ubo.s.a;
+    FragColor = priv;
+}
+
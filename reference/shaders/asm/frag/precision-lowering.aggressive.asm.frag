@@ -0,0 +1,19 @@
+#version 310 es
+precision mediump float;
+precision highp int;
+
+layout(binding = 0) uniform highp sampler2D uTex;
+
+layout(location = 0) in vec4 vColor;
+layout(location = 1) in highp vec2 vUV;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out highp vec4 FragTint;
+
+void main()
+{
+    vec4 color = (vColor * 0.5);
+    FragColor = (color * color);
+    vec4 tint = (texture(uTex, vUV) * vColor);
+    FragTint = (tint * 0.5);
+}
+
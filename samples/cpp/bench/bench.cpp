@@ -0,0 +1,68 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_cross/external_interface.h"
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+// Runs one compute shader at several dispatch sizes and reports its throughput.
+// The spirv-cross-bench CMake target builds this once per shader, and defines
+// BENCH_NAME, BENCH_INVOCATIONS (per work group), BENCH_NUM_BUFFERS (SSBOs at bindings 0 to N - 1 of set 0),
+// BENCH_OPS (operations per invocation) and BENCH_OP (the operation the shader measures).
+
+int main()
+{
+	auto *iface = spirv_cross_get_interface();
+	auto *shader = iface->construct();
+
+	static const unsigned dispatch_sizes[] = { 1, 16, 256, 4096 };
+	const unsigned max_work_groups = 4096;
+
+	// Room for a vec4 per invocation in every buffer.
+	std::vector<float> buffers[BENCH_NUM_BUFFERS];
+	void *pointers[BENCH_NUM_BUFFERS];
+	for (unsigned i = 0; i < BENCH_NUM_BUFFERS; i++)
+	{
+		buffers[i].assign(size_t(max_work_groups) * BENCH_INVOCATIONS * 4, 1.0f);
+		pointers[i] = buffers[i].data();
+		spirv_cross_set_resource(shader, 0, i, &pointers[i], sizeof(pointers[i]));
+	}
+
+	for (unsigned work_groups : dispatch_sizes)
+	{
+		// The first dispatch also starts the worker threads.
+		spirv_cross_dispatch(shader, work_groups, 1, 1);
+
+		unsigned iterations = 0;
+		double seconds;
+		auto start = std::chrono::steady_clock::now();
+		do
+		{
+			spirv_cross_dispatch(shader, work_groups, 1, 1);
+			iterations++;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (seconds < 0.25);
+
+		double invocations = double(work_groups) * BENCH_INVOCATIONS * iterations;
+		double ops = invocations * BENCH_OPS;
+		printf("%-20s %5u work groups: %9.3f ms/dispatch, %9.2f M invocations/s, %9.2f M %s/s, %7.2f ns/%s\n",
+		       BENCH_NAME, work_groups, 1000.0 * seconds / iterations, 1e-6 * invocations / seconds, 1e-6 * ops / seconds,
+		       BENCH_OP, 1e9 * seconds / ops, BENCH_OP);
+	}
+
+	iface->destruct(shader);
+}
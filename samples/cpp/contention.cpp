@@ -0,0 +1,46 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_cross/external_interface.h"
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+// Measures how long it takes for the invocations of a work group to write their private variables in parallel.
+// Build with "make contention-bench" to compare invocations packed next to each other
+// to invocations padded to whole cache lines.
+int main()
+{
+	auto *iface = spirv_cross_get_interface();
+	auto *shader = iface->construct();
+
+#define NUM_WORKGROUPS 4
+	uint32_t results[16 * NUM_WORKGROUPS] = {};
+	void *results_ptr = results;
+	spirv_cross_set_resource(shader, 0, 0, &results_ptr, sizeof(results_ptr));
+
+	// Warm up, threads and copies of the shader are created on first use.
+	spirv_cross_dispatch(shader, NUM_WORKGROUPS, 1, 1);
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < 10; i++)
+		spirv_cross_dispatch(shader, NUM_WORKGROUPS, 1, 1);
+	auto end = std::chrono::steady_clock::now();
+
+	iface->destruct(shader);
+
+	fprintf(stderr, "10 dispatches took %.1f ms.\n", std::chrono::duration<double, std::milli>(end - start).count());
+}
@@ -0,0 +1,75 @@
+; SPIR-V
+; Version: 1.0
+; Generator: Khronos Glslang Reference Front End; 1
+; Bound: 50
+; Schema: 0
+               OpCapability Shader
+               OpCapability Int64
+          %1 = OpExtInstImport "GLSL.std.450"
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %vColor %FragColor
+               OpExecutionMode %main OriginUpperLeft
+               OpSource GLSL 450
+               OpName %main "main"
+               OpName %scale_color "scale_color(vf4;"
+               OpName %color "color"
+               OpName %UBO "UBO"
+               OpMemberName %UBO 0 "tint"
+               OpMemberName %UBO 1 "frame"
+               OpName %ubo ""
+               OpName %vColor "vColor"
+               OpName %FragColor "FragColor"
+               OpName %result "result"
+               OpName %param "param"
+               OpMemberDecorate %UBO 0 Offset 0
+               OpMemberDecorate %UBO 1 Offset 16
+               OpDecorate %UBO Block
+               OpDecorate %ubo DescriptorSet 0
+               OpDecorate %ubo Binding 0
+               OpDecorate %vColor Location 0
+               OpDecorate %FragColor Location 0
+       %void = OpTypeVoid
+          %3 = OpTypeFunction %void
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%_ptr_Function_v4float = OpTypePointer Function %v4float
+         %10 = OpTypeFunction %v4float %_ptr_Function_v4float
+      %ulong = OpTypeInt 64 0
+        %UBO = OpTypeStruct %v4float %ulong
+%_ptr_Uniform_UBO = OpTypePointer Uniform %UBO
+        %ubo = OpVariable %_ptr_Uniform_UBO Uniform
+        %int = OpTypeInt 32 1
+      %int_0 = OpConstant %int 0
+      %int_1 = OpConstant %int 1
+%_ptr_Uniform_v4float = OpTypePointer Uniform %v4float
+%_ptr_Uniform_ulong = OpTypePointer Uniform %ulong
+%_ptr_Input_v4float = OpTypePointer Input %v4float
+     %vColor = OpVariable %_ptr_Input_v4float Input
+%_ptr_Output_v4float = OpTypePointer Output %v4float
+  %FragColor = OpVariable %_ptr_Output_v4float Output
+       %main = OpFunction %void None %3
+          %5 = OpLabel
+      %param = OpVariable %_ptr_Function_v4float Function
+         %20 = OpLoad %v4float %vColor
+               OpStore %param %20
+         %21 = OpFunctionCall %v4float %scale_color %param
+         %22 = OpAccessChain %_ptr_Uniform_ulong %ubo %int_1
+         %23 = OpLoad %ulong %22
+         %24 = OpConvertUToF %float %23
+         %25 = OpVectorTimesScalar %v4float %21 %24
+               OpStore %FragColor %25
+               OpReturn
+               OpFunctionEnd
+%scale_color = OpFunction %v4float None %10
+      %color = OpFunctionParameter %_ptr_Function_v4float
+         %12 = OpLabel
+     %result = OpVariable %_ptr_Function_v4float Function
+         %30 = OpLoad %v4float %color
+         %31 = OpAccessChain %_ptr_Uniform_v4float %ubo %int_0
+         %32 = OpLoad %v4float %31
+         %33 = OpFMul %v4float %30 %32
+               OpStore %result %33
+         %34 = OpLoad %v4float %result
+         %35 = OpFAdd %v4float %34 %34
+               OpReturnValue %35
+               OpFunctionEnd
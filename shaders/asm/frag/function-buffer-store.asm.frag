@@ -0,0 +1,60 @@
+; SPIR-V
+; Version: 1.0
+; Generator: Khronos Glslang Reference Front End; 1
+; Bound: 26
+; Schema: 0
+               OpCapability Shader
+          %1 = OpExtInstImport "GLSL.std.450"
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %vValue %FragColor
+               OpExecutionMode %main OriginUpperLeft
+               OpSource GLSL 450
+               OpName %main "main"
+               OpName %store_value "store_value(f1;"
+               OpName %hv "hv"
+               OpName %SSBO "SSBO"
+               OpMemberName %SSBO 0 "value"
+               OpName %ssbo "ssbo"
+               OpName %vValue "vValue"
+               OpName %FragColor "FragColor"
+               OpName %param "param"
+               OpMemberDecorate %SSBO 0 Offset 0
+               OpDecorate %SSBO BufferBlock
+               OpDecorate %ssbo DescriptorSet 0
+               OpDecorate %ssbo Binding 0
+               OpDecorate %vValue Location 0
+               OpDecorate %FragColor Location 0
+       %void = OpTypeVoid
+          %3 = OpTypeFunction %void
+      %float = OpTypeFloat 32
+%_ptr_Function_float = OpTypePointer Function %float
+          %8 = OpTypeFunction %void %_ptr_Function_float
+       %SSBO = OpTypeStruct %float
+%_ptr_Uniform_SSBO = OpTypePointer Uniform %SSBO
+       %ssbo = OpVariable %_ptr_Uniform_SSBO Uniform
+        %int = OpTypeInt 32 1
+      %int_0 = OpConstant %int 0
+%_ptr_Uniform_float = OpTypePointer Uniform %float
+%_ptr_Input_float = OpTypePointer Input %float
+     %vValue = OpVariable %_ptr_Input_float Input
+    %v4float = OpTypeVector %float 4
+%_ptr_Output_v4float = OpTypePointer Output %v4float
+  %FragColor = OpVariable %_ptr_Output_v4float Output
+       %main = OpFunction %void None %3
+          %5 = OpLabel
+      %param = OpVariable %_ptr_Function_float Function
+         %20 = OpLoad %float %vValue
+               OpStore %param %20
+         %21 = OpFunctionCall %void %store_value %param
+         %22 = OpCompositeConstruct %v4float %20 %20 %20 %20
+               OpStore %FragColor %22
+               OpReturn
+               OpFunctionEnd
+%store_value = OpFunction %void None %8
+         %hv = OpFunctionParameter %_ptr_Function_float
+         %11 = OpLabel
+         %hl = OpLoad %float %hv
+         %sp = OpAccessChain %_ptr_Uniform_float %ssbo %int_0
+               OpStore %sp %hl
+               OpReturn
+               OpFunctionEnd
@@ -0,0 +1,92 @@
+; SPIR-V
+; Version: 1.0
+; Generator: Khronos Glslang Reference Front End; 1
+; Bound: 60
+; Schema: 0
+               OpCapability Shader
+          %1 = OpExtInstImport "GLSL.std.450"
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %out
+               OpEntryPoint Fragment %other "other" %out
+               OpExecutionMode %main OriginUpperLeft
+               OpExecutionMode %other OriginUpperLeft
+               OpSource GLSL 450
+               OpName %main "main"
+               OpName %other "other"
+               OpName %S "S"
+               OpMemberName %S 0 "a"
+               OpName %Unused "Unused"
+               OpMemberName %Unused 0 "b"
+               OpName %UBO "UBO"
+               OpMemberName %UBO 0 "s"
+               OpName %ubo "ubo"
+               OpName %UBO2 "UBO2"
+               OpMemberName %UBO2 0 "x"
+               OpName %ubo2 "ubo2"
+               OpName %priv "priv"
+               OpName %unusedpriv "unusedpriv"
+               OpName %out "FragColor"
+               OpName %tex "tex"
+               OpDecorate %out Location 0
+               OpDecorate %UBO Block
+               OpMemberDecorate %UBO 0 Offset 0
+               OpMemberDecorate %S 0 Offset 0
+               OpDecorate %ubo DescriptorSet 0
+               OpDecorate %ubo Binding 0
+               OpDecorate %UBO2 Block
+               OpMemberDecorate %UBO2 0 Offset 0
+               OpDecorate %ubo2 DescriptorSet 0
+               OpDecorate %ubo2 Binding 1
+               OpDecorate %tex DescriptorSet 0
+               OpDecorate %tex Binding 2
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+       %vec4 = OpTypeVector %float 4
+          %S = OpTypeStruct %vec4
+     %Unused = OpTypeStruct %float
+        %UBO = OpTypeStruct %S
+       %UBO2 = OpTypeStruct %vec4
+    %ptr_ubo = OpTypePointer Uniform %UBO
+   %ptr_ubo2 = OpTypePointer Uniform %UBO2
+        %ubo = OpVariable %ptr_ubo Uniform
+       %ubo2 = OpVariable %ptr_ubo2 Uniform
+   %ptr_out = OpTypePointer Output %vec4
+        %out = OpVariable %ptr_out Output
+   %ptr_priv = OpTypePointer Private %vec4
+  %ptr_privu = OpTypePointer Private %Unused
+       %priv = OpVariable %ptr_priv Private
+ %unusedpriv = OpVariable %ptr_privu Private
+        %img = OpTypeImage %float 2D 0 0 0 1 Unknown
+        %si = OpTypeSampledImage %img
+     %ptr_si = OpTypePointer UniformConstant %si
+        %tex = OpVariable %ptr_si UniformConstant
+        %int = OpTypeInt 32 1
+      %int_0 = OpConstant %int 0
+       %vec2 = OpTypeVector %float 2
+   %float_0_5 = OpConstant %float 0.5
+      %o_uv = OpConstantComposite %vec2 %float_0_5 %float_0_5
+  %ptr_uvec4 = OpTypePointer Uniform %vec4
+  %ptr_privf = OpTypePointer Private %float
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+        %acc = OpAccessChain %ptr_uvec4 %ubo %int_0 %int_0
+        %val = OpLoad %vec4 %acc
+               OpStore %priv %val
+         %p2 = OpLoad %vec4 %priv
+               OpStore %out %p2
+               OpReturn
+               OpFunctionEnd
+      %other = OpFunction %void None %fn
+    %o_entry = OpLabel
+      %o_acc = OpAccessChain %ptr_uvec4 %ubo2 %int_0
+      %o_val = OpLoad %vec4 %o_acc
+      %o_img = OpLoad %si %tex
+      %o_smp = OpImageSampleImplicitLod %vec4 %o_img %o_uv
+      %o_mem = OpAccessChain %ptr_privf %unusedpriv %int_0
+      %o_b = OpLoad %float %o_mem
+      %o_mul = OpVectorTimesScalar %vec4 %o_smp %o_b
+      %o_sum = OpFAdd %vec4 %o_val %o_mul
+               OpStore %out %o_sum
+               OpReturn
+               OpFunctionEnd
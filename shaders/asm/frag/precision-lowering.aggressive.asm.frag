@@ -0,0 +1,65 @@
+; SPIR-V
+; Version: 1.0
+; Generator: Khronos Glslang Reference Front End; 1
+; Bound: 32
+; Schema: 0
+               OpCapability Shader
+          %1 = OpExtInstImport "GLSL.std.450"
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %vColor %vUV %FragColor %FragTint
+               OpExecutionMode %main OriginUpperLeft
+               OpSource ESSL 310
+               OpName %main "main"
+               OpName %vColor "vColor"
+               OpName %vUV "vUV"
+               OpName %uTex "uTex"
+               OpName %FragColor "FragColor"
+               OpName %FragTint "FragTint"
+               OpName %color "color"
+               OpName %tint "tint"
+               OpDecorate %vColor RelaxedPrecision
+               OpDecorate %vColor Location 0
+               OpDecorate %vUV Location 1
+               OpDecorate %uTex DescriptorSet 0
+               OpDecorate %uTex Binding 0
+               OpDecorate %FragColor RelaxedPrecision
+               OpDecorate %FragColor Location 0
+               OpDecorate %FragTint Location 1
+       %void = OpTypeVoid
+          %3 = OpTypeFunction %void
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%_ptr_Input_v4float = OpTypePointer Input %v4float
+     %vColor = OpVariable %_ptr_Input_v4float Input
+    %v2float = OpTypeVector %float 2
+%_ptr_Input_v2float = OpTypePointer Input %v2float
+        %vUV = OpVariable %_ptr_Input_v2float Input
+         %10 = OpTypeImage %float 2D 0 0 0 1 Unknown
+         %11 = OpTypeSampledImage %10
+%_ptr_UniformConstant_11 = OpTypePointer UniformConstant %11
+       %uTex = OpVariable %_ptr_UniformConstant_11 UniformConstant
+%_ptr_Output_v4float = OpTypePointer Output %v4float
+  %FragColor = OpVariable %_ptr_Output_v4float Output
+   %FragTint = OpVariable %_ptr_Output_v4float Output
+  %float_0_5 = OpConstant %float 0.5
+%_ptr_Function_v4float = OpTypePointer Function %v4float
+       %main = OpFunction %void None %3
+          %5 = OpLabel
+      %color = OpVariable %_ptr_Function_v4float Function
+       %tint = OpVariable %_ptr_Function_v4float Function
+         %20 = OpLoad %v4float %vColor
+         %21 = OpVectorTimesScalar %v4float %20 %float_0_5
+               OpStore %color %21
+         %28 = OpLoad %v4float %color
+         %22 = OpFMul %v4float %28 %28
+               OpStore %FragColor %22
+         %23 = OpLoad %11 %uTex
+         %24 = OpLoad %v2float %vUV
+         %25 = OpImageSampleImplicitLod %v4float %23 %24
+         %26 = OpFMul %v4float %25 %20
+               OpStore %tint %26
+         %29 = OpLoad %v4float %tint
+         %27 = OpVectorTimesScalar %v4float %29 %float_0_5
+               OpStore %FragTint %27
+               OpReturn
+               OpFunctionEnd
@@ -17,9 +17,16 @@
 #ifndef SPIRV_COMMON_HPP
 #define SPIRV_COMMON_HPP
 
-#include <sstream>
+#include <deque>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unordered_map>
+#include <vector>
 
 namespace spirv_cross
 {
@@ -32,16 +39,208 @@ public:
 	}
 };
 
+// Replacement for std::ostringstream which avoids stream construction and locale handling.
+// Text is first written to a small inline buffer, then to heap blocks which are never
+// reallocated, so growing the stream never copies text which was already written.
+template <size_t StackSize = 4096, size_t BlockSize = 4096>
+class StringStream
+{
+public:
+	StringStream()
+	{
+		current_buffer.buffer = stack_buffer;
+		current_buffer.offset = 0;
+		current_buffer.size = sizeof(stack_buffer);
+	}
+
+	~StringStream()
+	{
+		reset();
+	}
+
+	// Disable copies and moves. Makes it easier to implement everything.
+	StringStream(const StringStream &) = delete;
+	void operator=(const StringStream &) = delete;
+
+	StringStream &operator<<(const std::string &s)
+	{
+		append(s.data(), s.size());
+		return *this;
+	}
+
+	StringStream &operator<<(const char *s)
+	{
+		append(s, strlen(s));
+		return *this;
+	}
+
+	StringStream &operator<<(char c)
+	{
+		append(&c, 1);
+		return *this;
+	}
+
+	StringStream &operator<<(bool v)
+	{
+		append(v ? "1" : "0", 1);
+		return *this;
+	}
+
+	StringStream &operator<<(int v)
+	{
+		return append_signed(v);
+	}
+	StringStream &operator<<(long v)
+	{
+		return append_signed(v);
+	}
+	StringStream &operator<<(long long v)
+	{
+		return append_signed(v);
+	}
+	StringStream &operator<<(unsigned v)
+	{
+		return append_unsigned(v);
+	}
+	StringStream &operator<<(unsigned long v)
+	{
+		return append_unsigned(v);
+	}
+	StringStream &operator<<(unsigned long long v)
+	{
+		return append_unsigned(v);
+	}
+
+	// Same formatting as the default precision of std::ostream.
+	StringStream &operator<<(double v)
+	{
+		char buf[32];
+		int len = snprintf(buf, sizeof(buf), "%g", v);
+		if (len > 0)
+			append(buf, size_t(len));
+		return *this;
+	}
+
+	// Makes sure that the next size bytes can be appended without allocating,
+	// useful when the approximate output size is known up front.
+	void reserve(size_t size)
+	{
+		if (current_buffer.size - current_buffer.offset < size)
+			switch_to_new_block(size);
+	}
+
+	size_t size() const
+	{
+		size_t total = current_buffer.offset;
+		for (auto &saved : saved_buffers)
+			total += saved.offset;
+		return total;
+	}
+
+	std::string str() const
+	{
+		std::string ret;
+		ret.reserve(size());
+		for (auto &saved : saved_buffers)
+			ret.append(saved.buffer, saved.offset);
+		ret.append(current_buffer.buffer, current_buffer.offset);
+		return ret;
+	}
+
+	void reset()
+	{
+		for (auto &saved : saved_buffers)
+			if (saved.buffer != stack_buffer)
+				free(saved.buffer);
+		if (current_buffer.buffer != stack_buffer)
+			free(current_buffer.buffer);
+
+		saved_buffers.clear();
+		current_buffer.buffer = stack_buffer;
+		current_buffer.offset = 0;
+		current_buffer.size = sizeof(stack_buffer);
+	}
+
+private:
+	struct Buffer
+	{
+		char *buffer;
+		size_t offset;
+		size_t size;
+	};
+	Buffer current_buffer;
+	char stack_buffer[StackSize];
+	std::vector<Buffer> saved_buffers;
+
+	void append(const char *s, size_t len)
+	{
+		size_t avail = current_buffer.size - current_buffer.offset;
+		if (avail < len)
+		{
+			if (avail > 0)
+			{
+				memcpy(current_buffer.buffer + current_buffer.offset, s, avail);
+				s += avail;
+				len -= avail;
+				current_buffer.offset += avail;
+			}
+			switch_to_new_block(len);
+		}
+
+		memcpy(current_buffer.buffer + current_buffer.offset, s, len);
+		current_buffer.offset += len;
+	}
+
+	void switch_to_new_block(size_t min_size)
+	{
+		saved_buffers.push_back(current_buffer);
+		size_t size = min_size > BlockSize ? min_size : BlockSize;
+		current_buffer.buffer = static_cast<char *>(malloc(size));
+		if (!current_buffer.buffer)
+			throw std::bad_alloc();
+		current_buffer.offset = 0;
+		current_buffer.size = size;
+	}
+
+	template <typename T>
+	StringStream &append_unsigned(T v)
+	{
+		char buf[24];
+		char *end = buf + sizeof(buf);
+		char *p = end;
+		do
+		{
+			*--p = char('0' + v % 10);
+			v /= 10;
+		} while (v);
+		append(p, size_t(end - p));
+		return *this;
+	}
+
+	template <typename T>
+	StringStream &append_signed(T v)
+	{
+		if (v < 0)
+		{
+			append("-", 1);
+			// Negate in unsigned arithmetic so the most negative value is handled.
+			return append_unsigned(0ull - static_cast<unsigned long long>(v));
+		}
+		else
+			return append_unsigned(static_cast<unsigned long long>(v));
+	}
+};
+
 namespace inner
 {
-template <typename T>
-void join_helper(std::ostringstream &stream, T &&t)
+template <typename Stream, typename T>
+void join_helper(Stream &stream, T &&t)
 {
 	stream << std::forward<T>(t);
 }
 
-template <typename T, typename... Ts>
-void join_helper(std::ostringstream &stream, T &&t, Ts &&... ts)
+template <typename Stream, typename T, typename... Ts>
+void join_helper(Stream &stream, T &&t, Ts &&... ts)
 {
 	stream << std::forward<T>(t);
 	join_helper(stream, std::forward<Ts>(ts)...);
@@ -49,10 +248,11 @@ void join_helper(std::ostringstream &stream, T &&t, Ts &&... ts)
 }
 
 // Helper template to avoid lots of nasty string temporary munging.
+// join() is called for every token and recursively through to_expression(), so keep its inline buffer small.
 template <typename... Ts>
 std::string join(Ts &&... ts)
 {
-	std::ostringstream stream;
+	StringStream<256> stream;
 	inner::join_helper(stream, std::forward<Ts>(ts)...);
 	return stream.str();
 }
@@ -72,7 +272,7 @@ inline std::string merge(const std::vector<std::string> &list)
 template <typename T>
 inline std::string convert_to_string(T &&t)
 {
-	return std::to_string(std::forward<T>(t));
+	return join(std::forward<T>(t));
 }
 
 // Allow implementations to set a convenient standard precision
@@ -106,7 +306,7 @@ inline std::string convert_to_string(double t)
 
 struct Instruction
 {
-	Instruction(const std::vector<uint32_t> &spirv, uint32_t &index);
+	Instruction(const uint32_t *spirv, size_t word_count, uint32_t &index);
 
 	uint16_t op;
 	uint16_t count;
@@ -133,7 +333,8 @@ enum Types
 	TypeBlock,
 	TypeExtension,
 	TypeExpression,
-	TypeUndef
+	TypeUndef,
+	TypeCount
 };
 
 struct SPIRUndef : IVariant
@@ -258,6 +459,102 @@ struct SPIREntryPoint
 	spv::ExecutionModel model = {};
 };
 
+// Text of an expression which references the text of other expressions instead of copying it.
+// Forwarded expressions are nested in each other, so copying the operands at every step
+// would make long chains of forwarded expressions quadratic in time and memory.
+// Ropes are never modified once an expression owns them, so they can be shared freely.
+struct ExpressionRope
+{
+	ExpressionRope() = default;
+	ExpressionRope(const ExpressionRope &) = delete;
+	void operator=(const ExpressionRope &) = delete;
+
+	// Releases deep chains without recursing.
+	~ExpressionRope()
+	{
+		std::vector<std::shared_ptr<const ExpressionRope>> pending;
+		for (auto &child : children)
+			pending.push_back(std::move(child.second));
+
+		while (!pending.empty())
+		{
+			auto rope = std::move(pending.back());
+			pending.pop_back();
+
+			// If this is the last reference, take the children before the rope goes away.
+			if (rope.use_count() == 1)
+				for (auto &child : const_cast<ExpressionRope &>(*rope).children)
+					pending.push_back(std::move(child.second));
+		}
+	}
+
+	void append(const std::string &str)
+	{
+		text += str;
+		length += str.size();
+	}
+
+	void append(const char *str)
+	{
+		append(std::string(str));
+	}
+
+	void append(std::shared_ptr<const ExpressionRope> rope)
+	{
+		length += rope->length;
+		children.emplace_back(text.size(), std::move(rope));
+	}
+
+	void enclose()
+	{
+		text.insert(begin(text), '(');
+		text += ')';
+		length += 2;
+		for (auto &child : children)
+			child.first++;
+	}
+
+	std::string flatten() const
+	{
+		std::string result;
+		result.reserve(length);
+
+		struct Frame
+		{
+			const ExpressionRope *rope;
+			size_t child;
+			size_t offset;
+		};
+		std::vector<Frame> stack = { { this, 0, 0 } };
+
+		while (!stack.empty())
+		{
+			auto &frame = stack.back();
+			auto *rope = frame.rope;
+			if (frame.child < rope->children.size())
+			{
+				auto &child = rope->children[frame.child++];
+				result.append(rope->text, frame.offset, child.first - frame.offset);
+				frame.offset = child.first;
+				stack.push_back({ child.second.get(), 0, 0 });
+			}
+			else
+			{
+				result.append(rope->text, frame.offset, std::string::npos);
+				stack.pop_back();
+			}
+		}
+
+		return result;
+	}
+
+	// Text around the children, which go in front of the character at their offset.
+	std::string text;
+	std::vector<std::pair<size_t, std::shared_ptr<const ExpressionRope>>> children;
+	// Of the flattened text.
+	size_t length = 0;
+};
+
 struct SPIRExpression : IVariant
 {
 	enum
@@ -281,6 +578,9 @@ struct SPIRExpression : IVariant
 	std::string expression;
 	uint32_t expression_type = 0;
 
+	// If set, this is the text of the expression instead of expression.
+	std::shared_ptr<const ExpressionRope> rope;
+
 	// If this expression is a forwarded load,
 	// allow us to reference the original variable.
 	uint32_t loaded_from = 0;
@@ -294,8 +594,12 @@ struct SPIRExpression : IVariant
 	// If this expression has been used while invalidated.
 	bool used_while_invalidated = false;
 
-	// A list of expressions which this expression depends on.
+	// A list of expressions which this expression depends on directly.
+	// Their own dependencies apply as well.
 	std::vector<uint32_t> expression_dependencies;
+
+	// Value of Compiler::invalidation_epoch when all dependencies were last checked for invalidation.
+	uint64_t dependencies_checked_epoch = 0;
 };
 
 struct SPIRFunctionPrototype : IVariant
@@ -701,32 +1005,169 @@ struct SPIRConstant : IVariant
 	std::vector<uint32_t> subconstants;
 };
 
+// Type-erased interface so a Variant can return its object to the right pool.
+class ObjectPoolBase
+{
+public:
+	virtual ~ObjectPoolBase() = default;
+	virtual void free_opaque(void *ptr) = 0;
+	virtual IVariant *clone(const IVariant *ptr) = 0;
+
+	// Every object allocated so far, for CompilerStats.
+	uint64_t allocation_count = 0;
+	uint64_t allocation_bytes = 0;
+};
+
+// Allocates IR objects of a single type out of slabs which grow geometrically.
+// Freed objects go on a free list and are reused, and the slabs themselves
+// are only released in bulk when the pool is destroyed.
+template <typename T>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+	explicit ObjectPool(unsigned start_object_count_ = 16)
+	    : start_object_count(start_object_count_)
+	{
+	}
+
+	template <typename... P>
+	T *allocate(P &&... p)
+	{
+		if (vacants.empty())
+		{
+			unsigned num_objects = start_object_count << memory.size();
+			T *ptr = static_cast<T *>(malloc(num_objects * sizeof(T)));
+			if (!ptr)
+				throw CompilerError("Out of memory in object pool.");
+
+			vacants.reserve(vacants.size() + num_objects);
+			for (unsigned i = 0; i < num_objects; i++)
+				vacants.push_back(&ptr[num_objects - i - 1]);
+
+			memory.emplace_back(ptr);
+		}
+
+		T *ptr = vacants.back();
+		vacants.pop_back();
+		new (ptr) T(std::forward<P>(p)...);
+		allocation_count++;
+		allocation_bytes += sizeof(T);
+		return ptr;
+	}
+
+	void free(T *ptr)
+	{
+		ptr->~T();
+		vacants.push_back(ptr);
+	}
+
+	void free_opaque(void *ptr) override
+	{
+		free(static_cast<T *>(ptr));
+	}
+
+	IVariant *clone(const IVariant *ptr) override
+	{
+		return allocate(*static_cast<const T *>(ptr));
+	}
+
+private:
+	struct MallocDeleter
+	{
+		void operator()(T *ptr)
+		{
+			::free(ptr);
+		}
+	};
+
+	std::vector<T *> vacants;
+	std::vector<std::unique_ptr<T, MallocDeleter>> memory;
+	unsigned start_object_count;
+};
+
+// One pool per IR type, owned by the Compiler.
+// Must outlive every Variant which allocates from it.
+struct ObjectPoolGroup
+{
+	ObjectPoolGroup()
+	{
+		pools[TypeType].reset(new ObjectPool<SPIRType>);
+		pools[TypeVariable].reset(new ObjectPool<SPIRVariable>);
+		pools[TypeConstant].reset(new ObjectPool<SPIRConstant>);
+		pools[TypeFunction].reset(new ObjectPool<SPIRFunction>);
+		pools[TypeFunctionPrototype].reset(new ObjectPool<SPIRFunctionPrototype>);
+		pools[TypeBlock].reset(new ObjectPool<SPIRBlock>);
+		pools[TypeExtension].reset(new ObjectPool<SPIRExtension>);
+		pools[TypeExpression].reset(new ObjectPool<SPIRExpression>);
+		pools[TypeUndef].reset(new ObjectPool<SPIRUndef>);
+	}
+
+	std::unique_ptr<ObjectPoolBase> pools[TypeCount];
+};
+
 class Variant
 {
 public:
+	explicit Variant(ObjectPoolGroup *group_ = nullptr)
+	    : group(group_)
+	{
+	}
+
+	~Variant()
+	{
+		if (holder)
+			group->pools[type]->free_opaque(holder);
+	}
+
 	// MSVC 2013 workaround, we shouldn't need these constructors.
-	Variant() = default;
 	Variant(Variant &&other)
 	{
 		*this = std::move(other);
 	}
+
 	Variant &operator=(Variant &&other)
 	{
 		if (this != &other)
 		{
-			holder = move(other.holder);
+			if (holder)
+				group->pools[type]->free_opaque(holder);
+			holder = other.holder;
+			group = other.group;
 			type = other.type;
+			other.holder = nullptr;
 			other.type = TypeNone;
 		}
 		return *this;
 	}
 
-	void set(std::unique_ptr<IVariant> val, uint32_t new_type)
+	template <typename T, typename... P>
+	T *allocate_and_set(P &&... args)
 	{
-		holder = std::move(val);
-		if (type != TypeNone && type != new_type)
+		if (!group)
+			throw CompilerError("Variant has no object pool.");
+		if (type != TypeNone && type != T::type)
 			throw CompilerError("Overwriting a variant with new type.");
-		type = new_type;
+
+		auto *ptr = static_cast<ObjectPool<T> &>(*group->pools[T::type]).allocate(std::forward<P>(args)...);
+		if (holder)
+			group->pools[type]->free_opaque(holder);
+		holder = ptr;
+		type = T::type;
+		return ptr;
+	}
+
+	// Deep copies the object held by another variant into our own pool.
+	void set_clone(const Variant &other)
+	{
+		if (!group)
+			throw CompilerError("Variant has no object pool.");
+
+		reset();
+		if (other.holder)
+		{
+			holder = group->pools[other.type]->clone(other.holder);
+			type = other.type;
+		}
 	}
 
 	template <typename T>
@@ -736,7 +1177,7 @@ public:
 			throw CompilerError("nullptr");
 		if (T::type != type)
 			throw CompilerError("Bad cast");
-		return *static_cast<T *>(holder.get());
+		return *static_cast<T *>(holder);
 	}
 
 	template <typename T>
@@ -746,7 +1187,7 @@ public:
 			throw CompilerError("nullptr");
 		if (T::type != type)
 			throw CompilerError("Bad cast");
-		return *static_cast<const T *>(holder.get());
+		return *static_cast<const T *>(holder);
 	}
 
 	uint32_t get_type() const
@@ -759,12 +1200,15 @@ public:
 	}
 	void reset()
 	{
-		holder.reset();
+		if (holder)
+			group->pools[type]->free_opaque(holder);
+		holder = nullptr;
 		type = TypeNone;
 	}
 
 private:
-	std::unique_ptr<IVariant> holder;
+	ObjectPoolGroup *group = nullptr;
+	IVariant *holder = nullptr;
 	uint32_t type = TypeNone;
 };
 
@@ -783,19 +1227,52 @@ const T &variant_get(const Variant &var)
 template <typename T, typename... P>
 T &variant_set(Variant &var, P &&... args)
 {
-	auto uptr = std::unique_ptr<T>(new T(std::forward<P>(args)...));
-	auto ptr = uptr.get();
-	var.set(std::move(uptr), T::type);
-	return *ptr;
+	return *var.allocate_and_set<T>(std::forward<P>(args)...);
 }
 
+// Names are interned per module, so Meta only stores an index for them.
+// Index 0 is always the empty string. References from get() stay valid while the table grows.
+class StringTable
+{
+public:
+	StringTable()
+	{
+		strings.emplace_back();
+		lookup[strings.back()] = 0;
+	}
+
+	uint32_t intern(const std::string &str)
+	{
+		auto itr = lookup.find(str);
+		if (itr != end(lookup))
+			return itr->second;
+
+		uint32_t index = uint32_t(strings.size());
+		strings.push_back(str);
+		lookup[str] = index;
+		return index;
+	}
+
+	const std::string &get(uint32_t index) const
+	{
+		return strings[index];
+	}
+
+private:
+	std::deque<std::string> strings;
+	std::unordered_map<std::string, uint32_t> lookup;
+};
+
+// Meta is allocated for every ID, so only the commonly used fields are stored inline.
+// Names live in the StringTable and member decorations are stored out of line, see Compiler::member_meta.
 struct Meta
 {
 	struct Decoration
 	{
-		std::string alias;
 		uint64_t decoration_flags = 0;
 		spv::BuiltIn builtin_type;
+		// Index into the string table.
+		uint32_t alias = 0;
 		uint32_t location = 0;
 		uint32_t set = 0;
 		uint32_t binding = 0;
@@ -807,7 +1284,8 @@ struct Meta
 	};
 
 	Decoration decoration;
-	std::vector<Decoration> members;
+	// Index into member_meta plus one, 0 if no member has been decorated or named.
+	uint32_t members = 0;
 	uint32_t sampler = 0;
 };
 }
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_compile_cache.hpp"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace spv;
+using namespace spirv_cross;
+
+// Two FNV-1a streams with different offset bases make up the 128-bit key.
+CompileCacheKey::CompileCacheKey()
+    : low(0xcbf29ce484222325ull)
+    , high(0x84222325cbf29ce4ull)
+{
+	add(CompileCacheVersion);
+}
+
+void CompileCacheKey::add_bytes(const void *data, size_t size)
+{
+	auto *bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		low = (low ^ bytes[i]) * 0x100000001b3ull;
+		high = (high ^ bytes[i]) * 0x100000001b3ull;
+		high ^= high >> 29;
+	}
+}
+
+CompileCacheKey &CompileCacheKey::add(uint32_t value)
+{
+	uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+	add_bytes(bytes, sizeof(bytes));
+	return *this;
+}
+
+CompileCacheKey &CompileCacheKey::add(const string &value)
+{
+	// Length prefix, so "ab", "c" and "a", "bc" differ.
+	add(uint32_t(value.size()));
+	add_bytes(value.data(), value.size());
+	return *this;
+}
+
+CompileCacheKey &CompileCacheKey::add_spirv(const uint32_t *spirv, size_t word_count)
+{
+	add(uint32_t(word_count));
+	for (size_t i = 0; i < word_count; i++)
+		add(spirv[i]);
+	return *this;
+}
+
+CompileCacheKey &CompileCacheKey::add(const CompilerGLSL::Options &options)
+{
+	add(options.version);
+	add(options.es);
+	add(options.force_temporary);
+	add(options.vulkan_semantics);
+	add(options.strip_unused_resources);
+	add(options.minify);
+	add(uint32_t(options.precision_lowering));
+	add(options.vertex.fixup_clipspace);
+	add(uint32_t(options.fragment.default_float_precision));
+	add(uint32_t(options.fragment.default_int_precision));
+	return *this;
+}
+
+CompileCacheKey &CompileCacheKey::add(const PlsRemap &remap)
+{
+	add(remap.id);
+	add(uint32_t(remap.format));
+	return *this;
+}
+
+CompileCacheKey &CompileCacheKey::add(const MSLConfiguration &config)
+{
+	add(config.vtx_attr_stage_in_binding);
+	add(config.flip_vert_y);
+	add(config.flip_frag_y);
+	add(config.is_rendering_points);
+	add(config.argument_buffers);
+	return *this;
+}
+
+CompileCacheKey &CompileCacheKey::add(const MSLVertexAttr &attr)
+{
+	// used_by_shader is written by the compiler, it is not an input.
+	add(attr.location);
+	add(attr.msl_buffer);
+	add(attr.msl_offset);
+	add(attr.msl_stride);
+	add(attr.per_instance);
+	return *this;
+}
+
+CompileCacheKey &CompileCacheKey::add(const MSLResourceBinding &binding)
+{
+	add(uint32_t(binding.stage));
+	add(binding.desc_set);
+	add(binding.binding);
+	add(binding.msl_buffer);
+	add(binding.msl_texture);
+	add(binding.msl_sampler);
+	return *this;
+}
+
+string CompileCacheKey::to_string() const
+{
+	char buffer[33];
+	sprintf(buffer, "%016llx%016llx", static_cast<unsigned long long>(high), static_cast<unsigned long long>(low));
+	return buffer;
+}
+
+CompileCache::CompileCache(size_t max_entries_, string directory_)
+    : max_entries(max_entries_)
+    , directory(move(directory_))
+{
+}
+
+string CompileCache::get_path(const CompileCacheKey &key) const
+{
+	return directory + "/" + key.to_string() + ".spvc";
+}
+
+bool CompileCache::find(const CompileCacheKey &key, string &source)
+{
+	{
+		lock_guard<mutex> holder{ lock };
+		auto itr = lookup.find(key);
+		if (itr != end(lookup))
+		{
+			entries.splice(begin(entries), entries, itr->second);
+			source = itr->second->second;
+			hits++;
+			return true;
+		}
+
+		if (directory.empty())
+		{
+			misses++;
+			return false;
+		}
+	}
+
+	// Don't hold the lock while reading, other threads can use the memory cache meanwhile.
+	FILE *file = fopen(get_path(key).c_str(), "rb");
+	if (!file)
+	{
+		lock_guard<mutex> holder{ lock };
+		misses++;
+		return false;
+	}
+
+	string data;
+	char buffer[4096];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		data.append(buffer, count);
+	bool ok = !ferror(file);
+	fclose(file);
+
+	lock_guard<mutex> holder{ lock };
+	if (!ok)
+	{
+		misses++;
+		return false;
+	}
+
+	insert_in_memory(key, data);
+	source = move(data);
+	hits++;
+	return true;
+}
+
+void CompileCache::insert(const CompileCacheKey &key, const string &source)
+{
+	uint32_t temp_index;
+	{
+		lock_guard<mutex> holder{ lock };
+		insert_in_memory(key, source);
+		if (directory.empty())
+			return;
+		temp_index = temp_file_index++;
+	}
+
+	// Write to a temporary file first, so a reader never sees a partial entry.
+	// Other processes may share the directory, so the name includes our process ID.
+	auto path = get_path(key);
+	auto temp_path = join(path, ".tmp", uint32_t(getpid()), ".", temp_index);
+	FILE *file = fopen(temp_path.c_str(), "wb");
+	if (!file)
+		return;
+
+	bool ok = fwrite(source.data(), 1, source.size(), file) == source.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok || rename(temp_path.c_str(), path.c_str()) != 0)
+		remove(temp_path.c_str());
+}
+
+void CompileCache::insert_in_memory(const CompileCacheKey &key, const string &source)
+{
+	if (!max_entries)
+		return;
+
+	auto itr = lookup.find(key);
+	if (itr != end(lookup))
+	{
+		itr->second->second = source;
+		entries.splice(begin(entries), entries, itr->second);
+		return;
+	}
+
+	entries.emplace_front(key, source);
+	lookup[key] = begin(entries);
+
+	while (entries.size() > max_entries)
+	{
+		lookup.erase(entries.back().first);
+		entries.pop_back();
+	}
+}
+
+uint32_t CompileCache::get_hit_count() const
+{
+	lock_guard<mutex> holder{ lock };
+	return hits;
+}
+
+uint32_t CompileCache::get_miss_count() const
+{
+	lock_guard<mutex> holder{ lock };
+	return misses;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_COMPILE_CACHE_HPP
+#define SPIRV_COMPILE_CACHE_HPP
+
+#include "spirv_msl.hpp"
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace spirv_cross
+{
+// Bump this whenever the emitted source changes, so stale on-disk entries are never used.
+// That includes changes to code generation which are not controlled by an option.
+static const uint32_t CompileCacheVersion = 3;
+
+// Key of a compile cache entry, a 128-bit hash of everything which affects the emitted source.
+// That is the SPIR-V, the backend, its options, the entry point, and every call made on the compiler
+// before compile(), like flatten_interface_block(), remap_pixel_local_storage(), set_name() or set_decoration().
+// The cache cannot see those calls, so they must be added to the key in the order they are made.
+class CompileCacheKey
+{
+public:
+	CompileCacheKey();
+
+	CompileCacheKey &add(uint32_t value);
+	CompileCacheKey &add(const std::string &value);
+	CompileCacheKey &add_spirv(const uint32_t *spirv, size_t word_count);
+
+	CompileCacheKey &add(const CompilerGLSL::Options &options);
+	CompileCacheKey &add(const PlsRemap &remap);
+	CompileCacheKey &add(const MSLConfiguration &config);
+	CompileCacheKey &add(const MSLVertexAttr &attr);
+	CompileCacheKey &add(const MSLResourceBinding &binding);
+
+	// 32 hex digits, also used as the file name in the cache directory.
+	std::string to_string() const;
+
+	bool operator==(const CompileCacheKey &other) const
+	{
+		return low == other.low && high == other.high;
+	}
+
+	uint64_t low;
+	uint64_t high;
+
+private:
+	void add_bytes(const void *data, size_t size);
+};
+
+struct CompileCacheKeyHasher
+{
+	size_t operator()(const CompileCacheKey &key) const
+	{
+		return size_t(key.low);
+	}
+};
+
+// Maps keys to emitted source. All functions are thread safe.
+// The most recently used entries are kept in memory. If a directory is given, every entry is also
+// stored in a file there, so the cache survives between runs. The directory must already exist.
+class CompileCache
+{
+public:
+	explicit CompileCache(size_t max_entries = 256, std::string directory = std::string());
+
+	bool find(const CompileCacheKey &key, std::string &source);
+	void insert(const CompileCacheKey &key, const std::string &source);
+
+	uint32_t get_hit_count() const;
+	uint32_t get_miss_count() const;
+
+private:
+	typedef std::list<std::pair<CompileCacheKey, std::string>> EntryList;
+
+	void insert_in_memory(const CompileCacheKey &key, const std::string &source);
+	std::string get_path(const CompileCacheKey &key) const;
+
+	size_t max_entries;
+	std::string directory;
+
+	mutable std::mutex lock;
+	// Most recently used first.
+	EntryList entries;
+	std::unordered_map<CompileCacheKey, EntryList::iterator, CompileCacheKeyHasher> lookup;
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	uint32_t temp_file_index = 0;
+};
+}
+
+#endif
@@ -54,9 +54,8 @@ void CompilerCPP::emit_interface_block(const SPIRVariable &var)
 	auto flags = meta[type.self].decoration.decoration_flags;
 	if (flags & (1ull << DecorationBlock))
 		emit_block_struct(type);
-	auto buffer_name = to_name(type.self);
 
-	statement("internal::", qual, "<", buffer_name, type_to_array_glsl(type), "> ", instance_name, "__;");
+	statement("internal::", qual, "<", type_to_glsl(type), type_to_array_glsl(type), "> ", instance_name, "__;");
 	statement_no_indent("#define ", instance_name, " __res->", instance_name, "__.get()");
 	resource_registrations.push_back(join("s.register_", lowerqual, "(", instance_name, "__", ", ", location, ");"));
 	statement("");
@@ -134,10 +133,8 @@ void CompilerCPP::emit_block_struct(SPIRType &type)
 	emit_struct(self);
 }
 
-void CompilerCPP::emit_resources()
+void CompilerCPP::emit_plain_structs()
 {
-	// Output all basic struct types which are not Block or BufferBlock as these are declared inplace
-	// when such variables are instantiated.
 	for (auto &id : ids)
 	{
 		if (id.get_type() == TypeType)
@@ -151,8 +148,119 @@ void CompilerCPP::emit_resources()
 			}
 		}
 	}
+}
+
+bool CompilerCPP::is_typed_buffer(const SPIRVariable &var)
+{
+	if (!typed_resources || var.storage == StorageClassFunction || is_builtin_variable(var))
+		return false;
+
+	// Arrays of buffers keep going through the binding tables.
+	auto &type = get<SPIRType>(var.basetype);
+	if (!type.pointer || !type.array.empty())
+		return false;
 
-	statement("struct Resources : ", resource_type);
+	if (type.storage == StorageClassPushConstant)
+		return true;
+
+	return type.storage == StorageClassUniform &&
+	       (meta[type.self].decoration.decoration_flags &
+	        ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))) != 0;
+}
+
+void CompilerCPP::emit_bindings()
+{
+	statement("namespace Impl");
+	begin_scope();
+
+	// The buffer types, and any struct types they contain, are needed by the host as well.
+	emit_plain_structs();
+
+	typed_buffers.clear();
+	for (auto &id : ids)
+	{
+		if (id.get_type() == TypeVariable)
+		{
+			auto &var = id.get<SPIRVariable>();
+			if (is_typed_buffer(var))
+			{
+				emit_block_struct(get<SPIRType>(var.basetype));
+				typed_buffers.push_back(var.self);
+			}
+		}
+	}
+
+	statement("struct Bindings");
+	begin_scope();
+	for (auto id : typed_buffers)
+	{
+		add_resource_name(id);
+
+		auto &type = get<SPIRType>(get<SPIRVariable>(id).basetype);
+		auto &flags = meta[id].decoration.decoration_flags;
+		auto instance_name = to_name(id);
+
+		// Uniform buffers and push constants are always read-only, storage buffers if all members are.
+		bool readonly = type.storage == StorageClassPushConstant ||
+		                (meta[type.self].decoration.decoration_flags & (1ull << DecorationBlock)) ||
+		                (flags & (1ull << DecorationNonWritable));
+		if (!readonly)
+		{
+			readonly = true;
+			for (uint32_t i = 0; i < uint32_t(type.member_types.size()); i++)
+				if (!(get_member_decoration_mask(type.self, i) & (1ull << DecorationNonWritable)))
+					readonly = false;
+		}
+
+		if (type.storage == StorageClassPushConstant)
+		{
+			if ((flags & (1ull << DecorationBinding)) || (flags & (1ull << DecorationDescriptorSet)))
+				throw CompilerError("Push constant blocks cannot be compiled to GLSL with Binding or Set syntax. "
+				                    "Remap to location with reflection API first or disable these decorations.");
+
+			statement("// Push constants.");
+			resource_registrations.push_back(join("s.register_push_constant(", instance_name, ");"));
+		}
+		else
+		{
+			uint32_t descriptor_set = meta[id].decoration.set;
+			uint32_t binding = meta[id].decoration.binding;
+			statement("// Set ", descriptor_set, ", binding ", binding, ".");
+			resource_registrations.push_back(
+			    join("s.register_resource(", instance_name, ", ", descriptor_set, ", ", binding, ");"));
+		}
+		statement(readonly ? "const " : "", to_name(type.self), " *", instance_name, " = nullptr;");
+	}
+	end_scope_decl();
+
+	end_scope();
+	statement("");
+}
+
+void CompilerCPP::emit_function_prologue(const SPIRFunction &func)
+{
+	// Bind the typed buffers this function uses once, so the C++ compiler can see that they don't change.
+	auto &uses = get_function_analysis(func.self).uses;
+	for (auto id : typed_buffers)
+	{
+		if (!uses.count(id))
+			continue;
+
+		bool is_restrict = (meta[id].decoration.decoration_flags & (1ull << DecorationRestrict)) != 0;
+		auto instance_name = to_name(id);
+		statement("auto &", is_restrict ? "SPIRV_CROSS_RESTRICT " : "", instance_name, " = *__res->", instance_name,
+		          ";");
+	}
+}
+
+void CompilerCPP::emit_resources()
+{
+	// Output all basic struct types which are not Block or BufferBlock as these are declared inplace
+	// when such variables are instantiated. With typed resources, these come before Impl::Bindings instead.
+	if (!typed_resources)
+		emit_plain_structs();
+
+	statement("struct Resources : ", resource_type, typed_resources ? ", Bindings" : "");
 	begin_scope();
 
 	// Output UBOs and SSBOs
@@ -164,8 +272,9 @@ void CompilerCPP::emit_resources()
 			auto &type = get<SPIRType>(var.basetype);
 
 			if (var.storage != StorageClassFunction && type.pointer && type.storage == StorageClassUniform &&
-			    !is_builtin_variable(var) && (meta[type.self].decoration.decoration_flags &
-			                                  ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))))
+			    !is_builtin_variable(var) && !is_typed_buffer(var) &&
+			    (meta[type.self].decoration.decoration_flags &
+			     ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))))
 			{
 				emit_buffer_block(var);
 			}
@@ -179,7 +288,8 @@ void CompilerCPP::emit_resources()
 		{
 			auto &var = id.get<SPIRVariable>();
 			auto &type = get<SPIRType>(var.basetype);
-			if (var.storage != StorageClassFunction && type.pointer && type.storage == StorageClassPushConstant)
+			if (var.storage != StorageClassFunction && type.pointer && type.storage == StorageClassPushConstant &&
+			    !is_typed_buffer(var))
 				emit_push_constant_block(var);
 		}
 	}
@@ -246,7 +356,12 @@ void CompilerCPP::emit_resources()
 	statement("");
 	statement("Resources* __res;");
 	if (get_entry_point().model == ExecutionModelGLCompute)
-		statement("ComputePrivateResources __priv_res;");
+	{
+		if (lanes > 1)
+			statement("WideComputePrivateResources<", lanes, "> __priv_res;");
+		else
+			statement("ComputePrivateResources __priv_res;");
+	}
 	statement("");
 
 	// Emit regular globals which are allocated per invocation.
@@ -258,6 +373,14 @@ void CompilerCPP::emit_resources()
 		{
 			if (var.storage == StorageClassWorkgroup)
 				emit_shared(var);
+			else if (lanes > 1)
+			{
+				// One copy per lane.
+				add_resource_name(var.self);
+				auto name = to_name(var.self);
+				statement(variable_decl(get<SPIRType>(var.basetype), join(name, "__[", lanes, "]")), ";");
+				statement_no_indent("#define ", name, " ", name, "__[__lane]");
+			}
 			else
 				statement(CompilerGLSL::variable_decl(var), ";");
 			emitted = true;
@@ -273,6 +396,7 @@ string CompilerCPP::compile()
 	// Do not deal with ES-isms like precision, older extensions and such.
 	options.es = false;
 	options.version = 450;
+	options.minify = false;
 	backend.float_literal_suffix = true;
 	backend.double_literal_suffix = false;
 	backend.long_long_literal_suffix = true;
@@ -285,6 +409,14 @@ string CompilerCPP::compile()
 	backend.explicit_struct_type = true;
 	backend.use_initializer_list = true;
 
+	begin_stats();
+
+	{
+		PhaseScope phase(*this, CompilerPhaseAnalysis);
+		analyze_usage();
+		lanes = select_lane_count();
+	}
+
 	uint32_t pass_count = 0;
 	do
 	{
@@ -294,26 +426,78 @@ string CompilerCPP::compile()
 		resource_registrations.clear();
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
-
-		emit_header();
-		emit_resources();
+		{
+			PhaseScope phase(*this, CompilerPhaseEmitResources);
+			emit_header();
+			emit_resources();
+		}
 
-		emit_function(get<SPIRFunction>(entry_point), 0);
+		{
+			PhaseScope phase(*this, CompilerPhaseEmitFunctions);
+			emit_function(get<SPIRFunction>(entry_point), 0);
+			if (lanes > 1)
+				emit_lane_loop();
+		}
 
 		pass_count++;
 	} while (force_recompile);
 
+	recompile_count = pass_count - 1;
+
 	// Match opening scope of emit_header().
 	end_scope_decl();
 	// namespace
 	end_scope();
 
 	// Emit C entry points
-	emit_c_linkage();
+	{
+		PhaseScope phase(*this, CompilerPhaseEmitResources);
+		emit_c_linkage();
+		if (typed_resources)
+			statement("#endif");
+	}
+
+	auto output = buffer.str();
+	end_stats(output);
+	return output;
+}
+
+uint32_t CompilerCPP::select_lane_count()
+{
+	auto &execution = get_entry_point();
+	if (simd_width <= 1 || execution.model != ExecutionModelGLCompute || execution.workgroup_size.x % simd_width != 0)
+		return 1;
+
+	// Lanes run one after the other, so they cannot wait for each other.
+	if (function_uses_opcode(get<SPIRFunction>(entry_point), OpControlBarrier))
+		return 1;
+
+	// Initializers would have to be repeated for every lane.
+	for (auto global : global_variables)
+	{
+		auto &var = get<SPIRVariable>(global);
+		if (var.storage == StorageClassPrivate && var.initializer)
+			return 1;
+	}
 
-	return buffer->str();
+	return simd_width;
+}
+
+void CompilerCPP::emit_lane_loop()
+{
+	statement("inline void main()");
+	begin_scope();
+	statement_no_indent("SPIRV_CROSS_LANE_LOOP");
+	statement("for (uint32_t __lane = 0; __lane < ", lanes, "; __lane++)");
+	statement("    main_lane(__lane);");
+	end_scope();
+	statement("");
+}
+
+string CompilerCPP::implicit_function_arguments(const SPIRFunction &)
+{
+	// Builtins and private variables are indexed by lane, so every function needs to know it.
+	return lanes > 1 ? "__lane" : "";
 }
 
 void CompilerCPP::emit_c_linkage()
@@ -337,12 +521,22 @@ void CompilerCPP::emit_c_linkage()
 	statement("static_cast<", impl_type, "*>(shader)->invoke();");
 	end_scope();
 
+	if (typed_resources)
+	{
+		statement("");
+		statement("static void *spirv_cross_get_bindings(spirv_cross_shader_t *shader)");
+		begin_scope();
+		statement("return static_cast<Impl::Bindings*>(&static_cast<", impl_type, "*>(shader)->resources);");
+		end_scope();
+	}
+
 	statement("");
 	statement("static const struct spirv_cross_interface vtable =");
 	begin_scope();
 	statement("spirv_cross_construct,");
 	statement("spirv_cross_destruct,");
 	statement("spirv_cross_invoke,");
+	statement(typed_resources ? "spirv_cross_get_bindings," : "nullptr,");
 	end_scope_decl();
 
 	statement("");
@@ -365,13 +559,19 @@ void CompilerCPP::emit_function_prototype(SPIRFunction &func, uint64_t)
 
 	if (func.self == entry_point)
 	{
-		decl += "main";
+		decl += lanes > 1 ? "main_lane" : "main";
 		processing_entry_point = true;
 	}
 	else
 		decl += to_name(func.self);
 
 	decl += "(";
+	if (lanes > 1)
+	{
+		decl += "uint32_t __lane";
+		if (!func.arguments.empty())
+			decl += ", ";
+	}
 	for (auto &arg : func.arguments)
 	{
 		add_local_variable_name(arg.id);
@@ -428,14 +628,36 @@ void CompilerCPP::emit_header()
 	auto &execution = get_entry_point();
 
 	statement("// This C++ shader is autogenerated by spirv-cross.");
+	if (typed_resources)
+	{
+		statement("// Define SPIRV_CROSS_BINDINGS_ONLY before including this file to only declare Impl::Bindings.");
+		statement("#ifdef SPIRV_CROSS_BINDINGS_ONLY");
+		statement("#include <glm/glm.hpp>");
+		statement("#else");
+	}
+	if (lanes > 1)
+		statement("#define SPIRV_CROSS_LANES ", lanes);
 	statement("#include \"spirv_cross/internal_interface.hpp\"");
 	statement("#include \"spirv_cross/external_interface.h\"");
+	if (typed_resources)
+		statement("#endif");
 	// Needed to properly implement GLSL-style arrays.
 	statement("#include <array>");
 	statement("#include <stdint.h>");
 	statement("");
-	statement("using namespace spirv_cross;");
-	statement("using namespace glm;");
+	if (typed_resources)
+	{
+		statement("using namespace glm;");
+		statement("");
+		emit_bindings();
+		statement("#ifndef SPIRV_CROSS_BINDINGS_ONLY");
+		statement("using namespace spirv_cross;");
+	}
+	else
+	{
+		statement("using namespace spirv_cross;");
+		statement("using namespace glm;");
+	}
 	statement("");
 
 	statement("namespace Impl");
@@ -475,10 +697,19 @@ void CompilerCPP::emit_header()
 		break;
 
 	case ExecutionModelGLCompute:
-		impl_type = join("ComputeShader<Impl::Shader, Impl::Shader::Resources, ", execution.workgroup_size.x, ", ",
-		                 execution.workgroup_size.y, ", ", execution.workgroup_size.z, ">");
+	{
+		// Without barriers, invocations never wait for each other and can run one after the other on one thread.
+		bool uses_barrier = function_uses_opcode(get<SPIRFunction>(entry_point), OpControlBarrier);
+		if (lanes > 1)
+			impl_type = join("WideComputeShader<Impl::Shader, Impl::Shader::Resources, ", execution.workgroup_size.x,
+			                 ", ", execution.workgroup_size.y, ", ", execution.workgroup_size.z, ", ", lanes, ">");
+		else
+			impl_type = join(uses_barrier ? "ComputeShader" : "SerialComputeShader",
+			                 "<Impl::Shader, Impl::Shader::Resources, ", execution.workgroup_size.x, ", ",
+			                 execution.workgroup_size.y, ", ", execution.workgroup_size.z, ">");
 		resource_type = "ComputeResources";
 		break;
+	}
 
 	case ExecutionModelTessellationControl:
 		impl_type = "TessControlShader<Impl::Shader, Impl::Shader::Resources>";
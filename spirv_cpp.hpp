@@ -30,6 +30,16 @@ public:
 	    : CompilerGLSL(move(spirv_))
 	{
 	}
+
+	CompilerCPP(const uint32_t *ir, size_t word_count)
+	    : CompilerGLSL(ir, word_count)
+	{
+	}
+
+	CompilerCPP(std::shared_ptr<const ParsedIR> ir)
+	    : CompilerGLSL(move(ir))
+	{
+	}
 	std::string compile() override;
 
 	// Sets a custom symbol name that can override
@@ -42,12 +52,34 @@ public:
 		interface_name = std::move(name);
 	}
 
+	// Sets how many compute invocations are run by one call to the generated main(), 1 by default.
+	// The invocations are run as a loop over lanes, which the C++ compiler can vectorize.
+	// Only used for compute shaders without barriers whose work group size in X is a multiple of the width,
+	// other shaders are compiled as if the width was 1.
+	void set_simd_width(uint32_t width)
+	{
+		simd_width = width;
+	}
+
+	// Declares buffers and push constants as typed pointers in a struct, Impl::Bindings, instead of going through
+	// the binding tables. The host can fill it in directly through get_bindings() in the interface, and include
+	// the generated file with SPIRV_CROSS_BINDINGS_ONLY defined to get the declaration.
+	// Functions bind the buffers they use up front, and buffers declared restrict are assumed not to alias.
+	void set_typed_resources(bool enable)
+	{
+		typed_resources = enable;
+	}
+
 private:
 	void emit_header() override;
 	void emit_c_linkage();
 	void emit_function_prototype(SPIRFunction &func, uint64_t return_flags) override;
 
 	void emit_resources();
+	void emit_bindings();
+	void emit_plain_structs();
+	bool is_typed_buffer(const SPIRVariable &var);
+	void emit_function_prologue(const SPIRFunction &func) override;
 	void emit_buffer_block(const SPIRVariable &type);
 	void emit_push_constant_block(const SPIRVariable &var);
 	void emit_interface_block(const SPIRVariable &type);
@@ -58,11 +90,21 @@ private:
 	std::string variable_decl(const SPIRType &type, const std::string &name) override;
 
 	std::string argument_decl(const SPIRFunction::Parameter &arg);
+	std::string implicit_function_arguments(const SPIRFunction &func) override;
+
+	uint32_t select_lane_count();
+	void emit_lane_loop();
 
 	std::vector<std::string> resource_registrations;
 	std::string impl_type;
 	std::string resource_type;
 	uint32_t shared_counter = 0;
+	uint32_t simd_width = 1;
+	// Invocations per main() in the current compile, see set_simd_width().
+	uint32_t lanes = 1;
+	bool typed_resources = false;
+	// Variables declared in Impl::Bindings in the current compile.
+	std::vector<uint32_t> typed_buffers;
 
 	std::string interface_name;
 };
@@ -17,7 +17,9 @@
 #include "spirv_cross.hpp"
 #include "GLSL.std.450.h"
 #include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <map>
 #include <utility>
 
 using namespace std;
@@ -26,7 +28,7 @@ using namespace spirv_cross;
 
 #define log(...) fprintf(stderr, __VA_ARGS__)
 
-Instruction::Instruction(const vector<uint32_t> &spirv, uint32_t &index)
+Instruction::Instruction(const uint32_t *spirv, size_t word_count, uint32_t &index)
 {
 	op = spirv[index] & 0xffff;
 	count = (spirv[index] >> 16) & 0xffff;
@@ -39,14 +41,126 @@ Instruction::Instruction(const vector<uint32_t> &spirv, uint32_t &index)
 
 	index += count;
 
-	if (index > spirv.size())
+	if (index > word_count)
 		throw CompilerError("SPIR-V instruction goes out of bounds.");
 }
 
 Compiler::Compiler(vector<uint32_t> ir)
-    : spirv(move(ir))
+    : pool_group(new ObjectPoolGroup)
 {
-	parse();
+	parse(move(ir));
+}
+
+Compiler::Compiler(const uint32_t *ir, size_t word_count)
+    : pool_group(new ObjectPoolGroup)
+{
+	parse(ir, word_count);
+}
+
+Compiler::Compiler(shared_ptr<const ParsedIR> ir)
+    : spirv(ir->spirv)
+    , spirv_word_count(ir->spirv_word_count)
+    , spirv_owner(ir->spirv_owner)
+    , pool_group(new ObjectPoolGroup)
+{
+	ids.reserve(ir->ids.size());
+	for (auto &id : ir->ids)
+	{
+		ids.emplace_back(pool_group.get());
+		ids.back().set_clone(id);
+	}
+
+	meta = ir->meta;
+	member_meta = ir->member_meta;
+	strings = ir->strings;
+	global_variables = ir->global_variables;
+	aliased_variables = ir->aliased_variables;
+	entry_point = ir->default_entry_point;
+	entry_points = ir->entry_points;
+	source = ir->source;
+	loop_blocks = ir->loop_blocks;
+	continue_blocks = ir->continue_blocks;
+	loop_merge_targets = ir->loop_merge_targets;
+	selection_merge_targets = ir->selection_merge_targets;
+	multiselect_merge_targets = ir->multiselect_merge_targets;
+
+	stats.phase_milliseconds[CompilerPhaseParse] = ir->parse_milliseconds;
+	stats.instruction_count = ir->instruction_count;
+}
+
+shared_ptr<const ParsedIR> Compiler::parse_ir(vector<uint32_t> spirv)
+{
+	Compiler compiler(move(spirv));
+	return move_to_parsed_ir(compiler);
+}
+
+shared_ptr<const ParsedIR> Compiler::parse_ir(const uint32_t *spirv, size_t word_count, shared_ptr<const void> owner)
+{
+	Compiler compiler(spirv, word_count);
+
+	// If the module had to be byte-swapped, the compiler owns a copy and the caller's memory is no longer needed.
+	if (!compiler.spirv_owner)
+		compiler.spirv_owner = move(owner);
+	return move_to_parsed_ir(compiler);
+}
+
+shared_ptr<const ParsedIR> Compiler::move_to_parsed_ir(Compiler &compiler)
+{
+	auto ir = make_shared<ParsedIR>();
+
+	ir->spirv = compiler.spirv;
+	ir->spirv_word_count = compiler.spirv_word_count;
+	ir->spirv_owner = move(compiler.spirv_owner);
+	ir->pool_group = move(compiler.pool_group);
+	ir->ids = move(compiler.ids);
+	ir->meta = move(compiler.meta);
+	ir->member_meta = move(compiler.member_meta);
+	ir->strings = move(compiler.strings);
+	ir->global_variables = move(compiler.global_variables);
+	ir->aliased_variables = move(compiler.aliased_variables);
+	ir->default_entry_point = compiler.entry_point;
+	ir->entry_points = move(compiler.entry_points);
+	ir->source = compiler.source;
+	ir->loop_blocks = move(compiler.loop_blocks);
+	ir->continue_blocks = move(compiler.continue_blocks);
+	ir->loop_merge_targets = move(compiler.loop_merge_targets);
+	ir->selection_merge_targets = move(compiler.selection_merge_targets);
+	ir->multiselect_merge_targets = move(compiler.multiselect_merge_targets);
+	ir->parse_milliseconds = compiler.stats.phase_milliseconds[CompilerPhaseParse];
+	ir->instruction_count = compiler.stats.instruction_count;
+	return ir;
+}
+
+shared_ptr<const ParsedIR> Compiler::copy_ir() const
+{
+	auto ir = make_shared<ParsedIR>();
+
+	ir->spirv = spirv;
+	ir->spirv_word_count = spirv_word_count;
+	ir->spirv_owner = spirv_owner;
+	ir->pool_group.reset(new ObjectPoolGroup);
+	ir->ids.reserve(ids.size());
+	for (auto &id : ids)
+	{
+		ir->ids.emplace_back(ir->pool_group.get());
+		ir->ids.back().set_clone(id);
+	}
+	ir->meta = meta;
+	ir->member_meta = member_meta;
+	ir->strings = strings;
+	ir->global_variables = global_variables;
+	ir->aliased_variables = aliased_variables;
+	ir->default_entry_point = entry_point;
+	ir->entry_points = entry_points;
+	ir->source = source;
+	ir->loop_blocks = loop_blocks;
+	ir->continue_blocks = continue_blocks;
+	ir->loop_merge_targets = loop_merge_targets;
+	ir->selection_merge_targets = selection_merge_targets;
+	ir->multiselect_merge_targets = multiselect_merge_targets;
+	ir->parse_milliseconds = stats.phase_milliseconds[CompilerPhaseParse];
+	ir->instruction_count = stats.instruction_count;
+	return ir;
 }
 
 string Compiler::compile()
@@ -66,6 +180,16 @@ bool Compiler::variable_storage_is_aliased(const SPIRVariable &v)
 
 bool Compiler::block_is_pure(const SPIRBlock &block)
 {
+	return compute_block_purity(block);
+}
+
+bool Compiler::compute_block_purity(const SPIRBlock &block) const
+{
+	auto itr = block_purity.find(block.self);
+	if (itr != end(block_purity))
+		return itr->second;
+
+	bool pure = true;
 	for (auto &i : block.ops)
 	{
 		auto ops = stream(i);
@@ -76,21 +200,22 @@ bool Compiler::block_is_pure(const SPIRBlock &block)
 		case OpFunctionCall:
 		{
 			uint32_t func = ops[2];
-			if (!function_is_pure(get<SPIRFunction>(func)))
-				return false;
+			if (!get_function_analysis(func).pure)
+				pure = false;
 			break;
 		}
 
 		case OpStore:
 		{
-			auto &type = expression_type(ops[0]);
-			if (type.storage != StorageClassFunction)
-				return false;
+			// The pointer might not have been emitted yet, so don't rely on expression_type().
+			if (get_pointer_storage_class(ops[0]) != StorageClassFunction)
+				pure = false;
 			break;
 		}
 
 		case OpImageWrite:
-			return false;
+			pure = false;
+			break;
 
 		// Atomics are impure.
 		case OpAtomicLoad:
@@ -108,28 +233,35 @@ bool Compiler::block_is_pure(const SPIRBlock &block)
 		case OpAtomicAnd:
 		case OpAtomicOr:
 		case OpAtomicXor:
-			return false;
+			pure = false;
+			break;
 
 		// Geometry shader builtins modify global state.
 		case OpEndPrimitive:
 		case OpEmitStreamVertex:
 		case OpEndStreamPrimitive:
 		case OpEmitVertex:
-			return false;
+			pure = false;
+			break;
 
 		// Barriers disallow any reordering, so we should treat blocks with barrier as writing.
 		case OpControlBarrier:
 		case OpMemoryBarrier:
-			return false;
+			pure = false;
+			break;
 
 		// OpExtInst is potentially impure depending on extension, but GLSL builtins are at least pure.
 
 		default:
 			break;
 		}
+
+		if (!pure)
+			break;
 	}
 
-	return true;
+	block_purity[block.self] = pure;
+	return pure;
 }
 
 string Compiler::to_name(uint32_t id, bool allow_alias)
@@ -145,25 +277,37 @@ string Compiler::to_name(uint32_t id, bool allow_alias)
 			return to_name(type.type_alias);
 	}
 
-	if (meta[id].decoration.alias.empty())
+	auto &alias = get_alias(meta.at(id).decoration);
+	if (alias.empty())
 		return join("_", id);
 	else
-		return meta.at(id).decoration.alias;
+		return alias;
 }
 
 bool Compiler::function_is_pure(const SPIRFunction &func)
 {
-	for (auto block : func.blocks)
+	return get_function_analysis(func.self).pure;
+}
+
+bool Compiler::function_uses_opcode(const SPIRFunction &func, Op op) const
+{
+	struct Handler : OpcodeHandler
 	{
-		if (!block_is_pure(get<SPIRBlock>(block)))
+		Handler(Op op_)
+		    : op(op_)
 		{
-			//fprintf(stderr, "Function %s is impure!\n", to_name(func.self).c_str());
-			return false;
 		}
-	}
 
-	//fprintf(stderr, "Function %s is pure!\n", to_name(func.self).c_str());
-	return true;
+		bool handle(Op opcode, const uint32_t *, uint32_t) override
+		{
+			// Stop at the first match.
+			return opcode != op;
+		}
+
+		Op op;
+	} handler(op);
+
+	return !traverse_all_reachable_opcodes(func, handler);
 }
 
 void Compiler::register_global_read_dependencies(const SPIRBlock &block, uint32_t id)
@@ -272,10 +416,16 @@ void Compiler::register_write(uint32_t chain)
 	}
 }
 
+void Compiler::invalidate_expression(uint32_t id)
+{
+	if (invalid_expressions.insert(id).second)
+		invalidation_epoch++;
+}
+
 void Compiler::flush_dependees(SPIRVariable &var)
 {
 	for (auto expr : var.dependees)
-		invalid_expressions.insert(expr);
+		invalidate_expression(expr);
 	var.dependees.clear();
 }
 
@@ -366,7 +516,7 @@ bool Compiler::is_builtin_variable(const SPIRVariable &var) const
 		return true;
 
 	// We can have builtin structs as well. If one member of a struct is builtin, the struct must also be builtin.
-	for (auto &m : meta[get<SPIRType>(var.basetype).self].members)
+	for (auto &m : get_member_meta(get<SPIRType>(var.basetype).self))
 		if (m.builtin)
 			return true;
 
@@ -375,7 +525,7 @@ bool Compiler::is_builtin_variable(const SPIRVariable &var) const
 
 bool Compiler::is_member_builtin(const SPIRType &type, uint32_t index, BuiltIn *builtin) const
 {
-	auto &memb = meta[type.self].members;
+	auto &memb = get_member_meta(type.self);
 	if (index < memb.size() && memb[index].builtin)
 	{
 		if (builtin)
@@ -422,56 +572,56 @@ ShaderResources Compiler::get_shader_resources() const
 		if (var.storage == StorageClassInput && interface_variable_exists_in_entry_point(var.self))
 		{
 			if (meta[type.self].decoration.decoration_flags & (1ull << DecorationBlock))
-				res.stage_inputs.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+				res.stage_inputs.push_back({ var.self, var.basetype, type.self, get_alias(meta[type.self].decoration) });
 			else
-				res.stage_inputs.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+				res.stage_inputs.push_back({ var.self, var.basetype, type.self, get_alias(meta[var.self].decoration) });
 		}
 		// Subpass inputs
 		else if (var.storage == StorageClassUniformConstant && type.image.dim == DimSubpassData)
 		{
-			res.subpass_inputs.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.subpass_inputs.push_back({ var.self, var.basetype, type.self, get_alias(meta[var.self].decoration) });
 		}
 		// Outputs
 		else if (var.storage == StorageClassOutput && interface_variable_exists_in_entry_point(var.self))
 		{
 			if (meta[type.self].decoration.decoration_flags & (1ull << DecorationBlock))
-				res.stage_outputs.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+				res.stage_outputs.push_back({ var.self, var.basetype, type.self, get_alias(meta[type.self].decoration) });
 			else
-				res.stage_outputs.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+				res.stage_outputs.push_back({ var.self, var.basetype, type.self, get_alias(meta[var.self].decoration) });
 		}
 		// UBOs
 		else if (type.storage == StorageClassUniform &&
 		         (meta[type.self].decoration.decoration_flags & (1ull << DecorationBlock)))
 		{
-			res.uniform_buffers.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+			res.uniform_buffers.push_back({ var.self, var.basetype, type.self, get_alias(meta[type.self].decoration) });
 		}
 		// SSBOs
 		else if (type.storage == StorageClassUniform &&
 		         (meta[type.self].decoration.decoration_flags & (1ull << DecorationBufferBlock)))
 		{
-			res.storage_buffers.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+			res.storage_buffers.push_back({ var.self, var.basetype, type.self, get_alias(meta[type.self].decoration) });
 		}
 		// Push constant blocks
 		else if (type.storage == StorageClassPushConstant)
 		{
 			// There can only be one push constant block, but keep the vector in case this restriction is lifted
 			// in the future.
-			res.push_constant_buffers.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.push_constant_buffers.push_back({ var.self, var.basetype, type.self, get_alias(meta[var.self].decoration) });
 		}
 		// Images
 		else if (type.storage == StorageClassUniformConstant && type.basetype == SPIRType::Image)
 		{
-			res.storage_images.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.storage_images.push_back({ var.self, var.basetype, type.self, get_alias(meta[var.self].decoration) });
 		}
 		// Textures
 		else if (type.storage == StorageClassUniformConstant && type.basetype == SPIRType::SampledImage)
 		{
-			res.sampled_images.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.sampled_images.push_back({ var.self, var.basetype, type.self, get_alias(meta[var.self].decoration) });
 		}
 		// Atomic counters
 		else if (type.storage == StorageClassAtomicCounter)
 		{
-			res.atomic_counters.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.atomic_counters.push_back({ var.self, var.basetype, type.self, get_alias(meta[var.self].decoration) });
 		}
 	}
 
@@ -483,10 +633,10 @@ static inline uint32_t swap_endian(uint32_t v)
 	return ((v >> 24) & 0x000000ffu) | ((v >> 8) & 0x0000ff00u) | ((v << 8) & 0x00ff0000u) | ((v << 24) & 0xff000000u);
 }
 
-static string extract_string(const vector<uint32_t> &spirv, uint32_t offset)
+static string extract_string(const uint32_t *spirv, size_t word_count, uint32_t offset)
 {
 	string ret;
-	for (uint32_t i = offset; i < spirv.size(); i++)
+	for (uint32_t i = offset; i < word_count; i++)
 	{
 		uint32_t w = spirv[i];
 
@@ -517,28 +667,56 @@ static bool is_valid_spirv_version(uint32_t version)
 	}
 }
 
+void Compiler::parse(vector<uint32_t> words)
+{
+	// Endian-swap if we need to.
+	if (!words.empty() && words[0] == swap_endian(MagicNumber))
+		transform(begin(words), end(words), begin(words), [](uint32_t c) { return swap_endian(c); });
+
+	// The words are never modified after this point, so they can be shared freely.
+	auto owner = make_shared<const vector<uint32_t>>(move(words));
+	spirv = owner->data();
+	spirv_word_count = owner->size();
+	spirv_owner = move(owner);
+	parse();
+}
+
+void Compiler::parse(const uint32_t *words, size_t word_count)
+{
+	// A byte-swapped module cannot be used in place, so it has to be copied.
+	if (word_count && words[0] == swap_endian(MagicNumber))
+	{
+		parse(vector<uint32_t>(words, words + word_count));
+		return;
+	}
+
+	spirv = words;
+	spirv_word_count = word_count;
+	parse();
+}
+
 void Compiler::parse()
 {
-	auto len = spirv.size();
+	// Parsing is so much of the cost of small shaders that it is always timed.
+	auto start_time = chrono::steady_clock::now();
+
+	auto len = spirv_word_count;
 	if (len < 5)
 		throw CompilerError("SPIRV file too small.");
 
-	auto s = spirv.data();
-
-	// Endian-swap if we need to.
-	if (s[0] == swap_endian(MagicNumber))
-		transform(begin(spirv), end(spirv), begin(spirv), [](uint32_t c) { return swap_endian(c); });
-
+	auto s = spirv;
 	if (s[0] != MagicNumber || !is_valid_spirv_version(s[1]))
 		throw CompilerError("Invalid SPIRV format.");
 
 	uint32_t bound = s[3];
-	ids.resize(bound);
+	ids.reserve(bound);
+	for (uint32_t i = 0; i < bound; i++)
+		ids.emplace_back(pool_group.get());
 	meta.resize(bound);
 
 	uint32_t offset = 5;
 	while (offset < len)
-		inst.emplace_back(spirv, offset);
+		inst.emplace_back(spirv, spirv_word_count, offset);
 
 	for (auto &i : inst)
 		parse(i);
@@ -547,6 +725,12 @@ void Compiler::parse()
 		throw CompilerError("Function was not terminated.");
 	if (current_block)
 		throw CompilerError("Block was not terminated.");
+
+	invalidate_function_analysis();
+
+	stats.instruction_count = uint32_t(inst.size());
+	stats.phase_milliseconds[CompilerPhaseParse] =
+	    chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
 }
 
 void Compiler::flatten_interface_block(uint32_t id)
@@ -618,8 +802,8 @@ void Compiler::update_name_cache(unordered_set<string> &cache, string &name)
 
 void Compiler::set_name(uint32_t id, const std::string &name)
 {
-	auto &str = meta.at(id).decoration.alias;
-	str.clear();
+	auto &dec = meta.at(id).decoration;
+	dec.alias = 0;
 
 	if (name.empty())
 		return;
@@ -629,7 +813,7 @@ void Compiler::set_name(uint32_t id, const std::string &name)
 
 	// Functions in glslangValidator are mangled with name(<mangled> stuff.
 	// Normally, we would never see '(' in any legal indentifiers, so just strip them out.
-	str = name.substr(0, name.find('('));
+	auto str = name.substr(0, name.find('('));
 
 	for (uint32_t i = 0; i < str.size(); i++)
 	{
@@ -642,6 +826,32 @@ void Compiler::set_name(uint32_t id, const std::string &name)
 		else
 			c = isalnum(c) ? c : '_';
 	}
+
+	set_alias(dec, str);
+}
+
+const vector<Meta::Decoration> &Compiler::get_member_meta(uint32_t id) const
+{
+	uint32_t index = meta.at(id).members;
+	if (!index)
+	{
+		static const vector<Meta::Decoration> empty;
+		return empty;
+	}
+
+	return member_meta[index - 1];
+}
+
+vector<Meta::Decoration> &Compiler::get_or_create_member_meta(uint32_t id)
+{
+	auto &m = meta.at(id);
+	if (!m.members)
+	{
+		member_meta.emplace_back();
+		m.members = uint32_t(member_meta.size());
+	}
+
+	return member_meta[m.members - 1];
 }
 
 const SPIRType &Compiler::get_type(uint32_t id) const
@@ -651,8 +861,11 @@ const SPIRType &Compiler::get_type(uint32_t id) const
 
 void Compiler::set_member_decoration(uint32_t id, uint32_t index, Decoration decoration, uint32_t argument)
 {
-	meta.at(id).members.resize(max(meta[id].members.size(), size_t(index) + 1));
-	auto &dec = meta.at(id).members[index];
+	invalidate_usage_analysis();
+	invalidate_layouts();
+	auto &members = get_or_create_member_meta(id);
+	members.resize(max(members.size(), size_t(index) + 1));
+	auto &dec = members[index];
 	dec.decoration_flags |= 1ull << decoration;
 
 	switch (decoration)
@@ -677,25 +890,26 @@ void Compiler::set_member_decoration(uint32_t id, uint32_t index, Decoration dec
 
 void Compiler::set_member_name(uint32_t id, uint32_t index, const std::string &name)
 {
-	meta.at(id).members.resize(max(meta[id].members.size(), size_t(index) + 1));
-	meta.at(id).members[index].alias = name;
+	auto &members = get_or_create_member_meta(id);
+	members.resize(max(members.size(), size_t(index) + 1));
+	set_alias(members[index], name);
 }
 
 const std::string &Compiler::get_member_name(uint32_t id, uint32_t index) const
 {
-	auto &m = meta.at(id);
-	if (index >= m.members.size())
+	auto &members = get_member_meta(id);
+	if (index >= members.size())
 	{
 		static string empty;
 		return empty;
 	}
 
-	return m.members[index].alias;
+	return get_alias(members[index]);
 }
 
 uint32_t Compiler::get_member_decoration(uint32_t id, uint32_t index, Decoration decoration) const
 {
-	auto &dec = meta.at(id).members.at(index);
+	auto &dec = get_member_meta(id).at(index);
 	if (!(dec.decoration_flags & (1ull << decoration)))
 		return 0;
 
@@ -714,20 +928,21 @@ uint32_t Compiler::get_member_decoration(uint32_t id, uint32_t index, Decoration
 
 uint64_t Compiler::get_member_decoration_mask(uint32_t id, uint32_t index) const
 {
-	auto &m = meta.at(id);
-	if (index >= m.members.size())
+	auto &members = get_member_meta(id);
+	if (index >= members.size())
 		return 0;
 
-	return m.members[index].decoration_flags;
+	return members[index].decoration_flags;
 }
 
 void Compiler::unset_member_decoration(uint32_t id, uint32_t index, Decoration decoration)
 {
-	auto &m = meta.at(id);
-	if (index >= m.members.size())
+	invalidate_usage_analysis();
+	invalidate_layouts();
+	if (index >= get_member_meta(id).size())
 		return;
 
-	auto &dec = m.members[index];
+	auto &dec = get_or_create_member_meta(id)[index];
 
 	dec.decoration_flags &= ~(1ull << decoration);
 	switch (decoration)
@@ -751,6 +966,8 @@ void Compiler::unset_member_decoration(uint32_t id, uint32_t index, Decoration d
 
 void Compiler::set_decoration(uint32_t id, Decoration decoration, uint32_t argument)
 {
+	invalidate_usage_analysis();
+	invalidate_layouts();
 	auto &dec = meta.at(id).decoration;
 	dec.decoration_flags |= 1ull << decoration;
 
@@ -797,7 +1014,7 @@ StorageClass Compiler::get_storage_class(uint32_t id) const
 
 const std::string &Compiler::get_name(uint32_t id) const
 {
-	return meta.at(id).decoration.alias;
+	return get_alias(meta.at(id).decoration);
 }
 
 uint64_t Compiler::get_decoration_mask(uint32_t id) const
@@ -833,6 +1050,8 @@ uint32_t Compiler::get_decoration(uint32_t id, Decoration decoration) const
 
 void Compiler::unset_decoration(uint32_t id, Decoration decoration)
 {
+	invalidate_usage_analysis();
+	invalidate_layouts();
 	auto &dec = meta.at(id).decoration;
 	dec.decoration_flags &= ~(1ull << decoration);
 	switch (decoration)
@@ -918,7 +1137,7 @@ void Compiler::parse(const Instruction &instruction)
 	case OpExtInstImport:
 	{
 		uint32_t id = ops[0];
-		auto ext = extract_string(spirv, instruction.offset + 1);
+		auto ext = extract_string(spirv, spirv_word_count, instruction.offset + 1);
 		if (ext == "GLSL.std.450")
 			set<SPIRExtension>(id, SPIRExtension::GLSL);
 		else
@@ -930,7 +1149,7 @@ void Compiler::parse(const Instruction &instruction)
 	case OpEntryPoint:
 	{
 		auto itr = entry_points.emplace(ops[1], SPIREntryPoint(ops[1], static_cast<ExecutionModel>(ops[0]),
-		                                                       extract_string(spirv, instruction.offset + 2)));
+		                                                       extract_string(spirv, spirv_word_count, instruction.offset + 2)));
 		auto &e = itr.first->second;
 
 		// Strings need nul-terminator and consume the whole word.
@@ -974,7 +1193,7 @@ void Compiler::parse(const Instruction &instruction)
 	case OpName:
 	{
 		uint32_t id = ops[0];
-		set_name(id, extract_string(spirv, instruction.offset + 1));
+		set_name(id, extract_string(spirv, spirv_word_count, instruction.offset + 1));
 		break;
 	}
 
@@ -982,7 +1201,7 @@ void Compiler::parse(const Instruction &instruction)
 	{
 		uint32_t id = ops[0];
 		uint32_t member = ops[1];
-		set_member_name(id, member, extract_string(spirv, instruction.offset + 2));
+		set_member_name(id, member, extract_string(spirv, spirv_word_count, instruction.offset + 2));
 		break;
 	}
 
@@ -1676,6 +1895,14 @@ bool Compiler::block_is_outside_flow_control_from_block(const SPIRBlock &from, c
 	if (is_continue(start->self))
 		return false;
 
+	// Both branches of a select are followed, so without memoization this is exponential in the nesting depth.
+	uint64_t key = (uint64_t(from.self) << 32) | to.self;
+	auto itr = outside_flow_control_cache.find(key);
+	if (itr != end(outside_flow_control_cache))
+		return itr->second;
+
+	bool ret;
+
 	// If our select block doesn't merge, we must break or continue in these blocks,
 	// so if continues occur branchless within these blocks, consider them branchless as well.
 	// This is typically used for loop control.
@@ -1683,18 +1910,21 @@ bool Compiler::block_is_outside_flow_control_from_block(const SPIRBlock &from, c
 	    (block_is_outside_flow_control_from_block(get<SPIRBlock>(start->true_block), to) ||
 	     block_is_outside_flow_control_from_block(get<SPIRBlock>(start->false_block), to)))
 	{
-		return true;
+		ret = true;
 	}
 	else if (start->merge_block && block_is_outside_flow_control_from_block(get<SPIRBlock>(start->merge_block), to))
 	{
-		return true;
+		ret = true;
 	}
 	else if (start->next_block && block_is_outside_flow_control_from_block(get<SPIRBlock>(start->next_block), to))
 	{
-		return true;
+		ret = true;
 	}
 	else
-		return false;
+		ret = false;
+
+	outside_flow_control_cache[key] = ret;
+	return ret;
 }
 
 bool Compiler::execution_is_noop(const SPIRBlock &from, const SPIRBlock &to) const
@@ -1702,32 +1932,62 @@ bool Compiler::execution_is_noop(const SPIRBlock &from, const SPIRBlock &to) con
 	if (!execution_is_branchless(from, to))
 		return false;
 
+	uint64_t key = (uint64_t(from.self) << 32) | to.self;
+	auto itr = noop_cache.find(key);
+	if (itr != end(noop_cache))
+		return itr->second;
+
+	bool ret;
 	auto *start = &from;
 	for (;;)
 	{
 		if (start->self == to.self)
-			return true;
+		{
+			ret = true;
+			break;
+		}
 
 		if (!start->ops.empty())
-			return false;
+		{
+			ret = false;
+			break;
+		}
 
 		start = &get<SPIRBlock>(start->next_block);
 	}
+
+	noop_cache[key] = ret;
+	return ret;
 }
 
 bool Compiler::execution_is_branchless(const SPIRBlock &from, const SPIRBlock &to) const
 {
+	uint64_t key = (uint64_t(from.self) << 32) | to.self;
+	auto itr = branchless_cache.find(key);
+	if (itr != end(branchless_cache))
+		return itr->second;
+
+	bool ret;
 	auto *start = &from;
 	for (;;)
 	{
 		if (start->self == to.self)
-			return true;
+		{
+			ret = true;
+			break;
+		}
 
 		if (start->terminator == SPIRBlock::Direct && start->merge == SPIRBlock::MergeNone)
 			start = &get<SPIRBlock>(start->next_block);
 		else
-			return false;
+		{
+			ret = false;
+			break;
+		}
 	}
+
+	branchless_cache[key] = ret;
+	return ret;
 }
 
 SPIRBlock::ContinueBlockType Compiler::continue_block_type(const SPIRBlock &block) const
@@ -1789,10 +2049,187 @@ bool Compiler::traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHa
 	return true;
 }
 
+bool Compiler::traverse_all_reachable_uses(const SPIRFunction &func, uint32_t id, OpcodeHandler &handler) const
+{
+	auto &analysis = get_function_analysis(func.self);
+	static const vector<InstructionLocation> no_uses;
+	auto itr = analysis.uses.find(id);
+	auto &uses = itr != end(analysis.uses) ? itr->second : no_uses;
+
+	// Merge uses and calls, so instructions are visited in the same order as traverse_all_reachable_opcodes().
+	auto use = begin(uses);
+	auto call = begin(analysis.calls);
+	while (use != end(uses) || call != end(analysis.calls))
+	{
+		bool is_call = use == end(uses) || (call != end(analysis.calls) && call->order <= use->order);
+		// A call which reads id is both a use and a call.
+		bool is_use = use != end(uses) && (!is_call || use->order == call->order);
+		auto &location = is_call ? *call : *use;
+		auto &block = get<SPIRBlock>(location.block);
+
+		// Skip reads by the terminator, they are not opcodes.
+		if (location.index < block.ops.size())
+		{
+			auto &i = block.ops[location.index];
+			auto ops = stream(i);
+
+			if (is_use && !handler.handle(static_cast<Op>(i.op), ops, i.length))
+				return false;
+
+			if (is_call && !traverse_all_reachable_uses(get<SPIRFunction>(ops[2]), id, handler))
+				return false;
+		}
+
+		if (is_call)
+			++call;
+		if (is_use)
+			++use;
+	}
+
+	return true;
+}
+
+static bool opcode_has_result(Op op)
+{
+	switch (op)
+	{
+	case OpStore:
+	case OpCopyMemory:
+	case OpImageWrite:
+	case OpAtomicStore:
+	case OpControlBarrier:
+	case OpMemoryBarrier:
+	case OpEmitVertex:
+	case OpEndPrimitive:
+	case OpEmitStreamVertex:
+	case OpEndStreamPrimitive:
+	case OpLine:
+	case OpNop:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+const Compiler::FunctionAnalysis &Compiler::get_function_analysis(uint32_t func) const
+{
+	auto itr = function_analysis.find(func);
+	if (itr != end(function_analysis))
+		return itr->second;
+
+	// Insert before building, purity analysis recurses into callees.
+	auto &analysis = function_analysis[func];
+	build_function_analysis(get<SPIRFunction>(func), analysis);
+	return analysis;
+}
+
+const Compiler::InstructionLocation *Compiler::get_definition(uint32_t id) const
+{
+	if (!definitions_valid)
+	{
+		for (auto &variant : ids)
+		{
+			if (variant.get_type() != TypeFunction)
+				continue;
+
+			for (auto block : variant_get<SPIRFunction>(variant).blocks)
+			{
+				auto &ops = get<SPIRBlock>(block).ops;
+				for (uint32_t index = 0; index < ops.size(); index++)
+				{
+					auto &i = ops[index];
+					if (i.length >= 2 && opcode_has_result(static_cast<Op>(i.op)))
+					{
+						InstructionLocation location;
+						location.block = block;
+						location.index = index;
+						definitions[stream(i)[1]] = location;
+					}
+				}
+			}
+		}
+		definitions_valid = true;
+	}
+
+	auto itr = definitions.find(id);
+	return itr != end(definitions) ? &itr->second : nullptr;
+}
+
+StorageClass Compiler::get_pointer_storage_class(uint32_t ptr) const
+{
+	auto *var = maybe_get<SPIRVariable>(ptr);
+	if (var)
+		return get<SPIRType>(var->basetype).storage;
+
+	auto *def = get_definition(ptr);
+	if (def)
+	{
+		auto &i = get<SPIRBlock>(def->block).ops[def->index];
+		return get<SPIRType>(stream(i)[0]).storage;
+	}
+
+	if (maybe_get<SPIRExpression>(ptr))
+		return expression_type(ptr).storage;
+
+	// Be conservative.
+	return StorageClassGeneric;
+}
+
+void Compiler::build_function_analysis(const SPIRFunction &func, FunctionAnalysis &analysis) const
+{
+	uint32_t order = 0;
+	for (auto block_id : func.blocks)
+	{
+		auto &block = get<SPIRBlock>(block_id);
+
+		InstructionLocation location;
+		location.block = block_id;
+
+		auto add_use = [&](uint32_t id) {
+			auto &uses = analysis.uses[id];
+			// Only record an instruction once, even if it reads the same ID several times.
+			if (uses.empty() || uses.back().order != location.order)
+				uses.push_back(location);
+		};
+
+		for (auto &i : block.ops)
+		{
+			if (static_cast<Op>(i.op) == OpFunctionCall)
+				analysis.calls.push_back(location);
+
+			for_each_id_operand(i, add_use);
+			location.index++;
+			location.order = ++order;
+		}
+
+		if (block.terminator == SPIRBlock::Select || block.terminator == SPIRBlock::MultiSelect)
+			add_use(block.condition);
+		else if (block.terminator == SPIRBlock::Return && block.return_value)
+			add_use(block.return_value);
+		location.order = ++order;
+
+		if (!compute_block_purity(block))
+			analysis.pure = false;
+	}
+}
+
+void Compiler::invalidate_function_analysis()
+{
+	invalidate_usage_analysis();
+	function_analysis.clear();
+	definitions.clear();
+	definitions_valid = false;
+	block_purity.clear();
+	outside_flow_control_cache.clear();
+	branchless_cache.clear();
+	noop_cache.clear();
+}
+
 uint32_t Compiler::type_struct_member_offset(const SPIRType &type, uint32_t index) const
 {
 	// Decoration must be set in valid SPIR-V, otherwise throw.
-	auto &dec = meta[type.self].members.at(index);
+	auto &dec = get_member_meta(type.self).at(index);
 	if (dec.decoration_flags & (1ull << DecorationOffset))
 		return dec.offset;
 	else
@@ -1812,10 +2249,7 @@ uint32_t Compiler::type_struct_member_array_stride(const SPIRType &type, uint32_
 
 size_t Compiler::get_declared_struct_size(const SPIRType &type) const
 {
-	uint32_t last = uint32_t(type.member_types.size() - 1);
-	size_t offset = type_struct_member_offset(type, last);
-	size_t size = get_declared_struct_member_size(type, last);
-	return offset + size;
+	return get_struct_layout(type, BufferPackingDeclared).size;
 }
 
 size_t Compiler::get_declared_struct_member_size(const SPIRType &struct_type, uint32_t index) const
@@ -1866,85 +2300,259 @@ size_t Compiler::get_declared_struct_member_size(const SPIRType &struct_type, ui
 			return type_struct_member_array_stride(struct_type, index) * type.array.back();
 		}
 	}
+	else if (!type.array.empty())
+		return type_struct_member_array_stride(struct_type, index) * type.array.back();
 	else
-	{
-		// Recurse.
-		uint32_t last = uint32_t(struct_type.member_types.size() - 1);
-		uint32_t offset = type_struct_member_offset(struct_type, last);
-		size_t size = get_declared_struct_size(get<SPIRType>(struct_type.member_types.back()));
-		return offset + size;
-	}
+		return get_declared_struct_size(type);
 }
 
-bool Compiler::BufferAccessHandler::handle(Op opcode, const uint32_t *args, uint32_t length)
+const Compiler::StructLayout &Compiler::get_struct_layout(const SPIRType &type, BufferPackingRule rule) const
 {
-	if (opcode != OpAccessChain && opcode != OpInBoundsAccessChain)
-		return true;
-
-	// Invalid SPIR-V.
-	if (length < 4)
-		return false;
-
-	if (args[2] != id)
-		return true;
-
-	// Don't bother traversing the entire access chain tree yet.
-	// If we access a struct member, assume we access the entire member.
-	uint32_t index = compiler.get<SPIRConstant>(args[3]).scalar();
-
-	// Seen this index already.
-	if (seen.find(index) != end(seen))
-		return true;
-	seen.insert(index);
+	auto &layouts = struct_layouts[rule];
+	auto itr = layouts.find(type.self);
+	// Backends append members to structs they create, which the member count catches
+	// even when no decoration changed along with it.
+	if (itr != end(layouts) && itr->second.member_offsets.size() == type.member_types.size())
+		return itr->second;
 
-	auto &type = compiler.expression_type(id);
-	uint32_t offset = compiler.type_struct_member_offset(type, index);
+	// Nested structs are laid out first, and can add entries to the map.
+	StructLayout layout;
+	layout.member_offsets.resize(type.member_types.size());
 
-	size_t range;
-	// If we have another member in the struct, deduce the range by looking at the next member.
-	// This is okay since structs in SPIR-V can have padding, but Offset decoration must be
-	// monotonically increasing.
-	// Of course, this doesn't take into account if the SPIR-V for some reason decided to add
-	// very large amounts of padding, but that's not really a big deal.
-	if (index + 1 < type.member_types.size())
+	if (rule == BufferPackingStd430)
 	{
-		range = compiler.type_struct_member_offset(type, index + 1) - offset;
+		uint32_t pad_alignment = 1;
+		for (uint32_t i = 0; i < type.member_types.size(); i++)
+		{
+			auto member_flags = get_member_meta(type.self).at(i).decoration_flags;
+			auto &member_type = get<SPIRType>(type.member_types[i]);
+
+			// Rule 9. Structs alignments are maximum alignment of its members.
+			uint32_t std430_alignment = type_to_std430_alignment(member_type, member_flags);
+			uint32_t alignment = max(std430_alignment, pad_alignment);
+			layout.alignment = max(layout.alignment, std430_alignment);
+
+			// The next member following a struct member is aligned to the base alignment of the struct that came before.
+			// GL 4.5 spec, 7.6.2.2.
+			if (member_type.basetype == SPIRType::Struct)
+				pad_alignment = std430_alignment;
+			else
+				pad_alignment = 1;
+
+			layout.size = (layout.size + alignment - 1) & ~(alignment - 1);
+			layout.member_offsets[i] = layout.size;
+			layout.size += type_to_std430_size(member_type, member_flags);
+		}
 	}
 	else
 	{
-		// No padding, so just deduce it from the size of the member directly.
-		range = compiler.get_declared_struct_member_size(type, index);
+		for (uint32_t i = 0; i < type.member_types.size(); i++)
+			layout.member_offsets[i] = type_struct_member_offset(type, i);
+
+		if (!type.member_types.empty())
+		{
+			uint32_t last = uint32_t(type.member_types.size() - 1);
+			layout.size = layout.member_offsets[last] + uint32_t(get_declared_struct_member_size(type, last));
+		}
 	}
 
-	ranges.push_back({ index, offset, range });
-	return true;
+	auto &result = layouts[type.self];
+	result = move(layout);
+	return result;
 }
 
-std::vector<BufferRange> Compiler::get_active_buffer_ranges(uint32_t id) const
+void Compiler::invalidate_layouts()
 {
-	std::vector<BufferRange> ranges;
-	BufferAccessHandler handler(*this, ranges, id);
-	traverse_all_reachable_opcodes(get<SPIRFunction>(entry_point), handler);
-	return ranges;
+	for (auto &layouts : struct_layouts)
+		layouts.clear();
 }
 
-// Increase the number of IDs by the specified incremental amount.
-// Returns the value of the first ID available for use in the expanded bound.
-uint32_t Compiler::increase_bound_by(uint32_t incr_amount)
+uint32_t Compiler::type_to_std430_base_size(const SPIRType &type) const
 {
-	uint32_t curr_bound = (uint32_t)ids.size();
-	uint32_t new_bound = curr_bound + incr_amount;
-	ids.resize(new_bound);
-	meta.resize(new_bound);
-	return curr_bound;
+	switch (type.basetype)
+	{
+	case SPIRType::Double:
+	case SPIRType::Int64:
+	case SPIRType::UInt64:
+		return 8;
+	default:
+		return 4;
+	}
 }
 
-bool Compiler::types_are_logically_equivalent(const SPIRType &a, const SPIRType &b) const
+uint32_t Compiler::type_to_std430_alignment(const SPIRType &type, uint64_t flags) const
 {
-	if (a.basetype != b.basetype)
-		return false;
-	if (a.width != b.width)
-		return false;
+	const uint32_t base_alignment = type_to_std430_base_size(type);
+
+	if (type.basetype == SPIRType::Struct)
+		return get_struct_layout(type, BufferPackingStd430).alignment;
+	else
+	{
+		// From 7.6.2.2 in GL 4.5 core spec.
+		// Rule 1
+		if (type.vecsize == 1 && type.columns == 1)
+			return base_alignment;
+
+		// Rule 2
+		if ((type.vecsize == 2 || type.vecsize == 4) && type.columns == 1)
+			return type.vecsize * base_alignment;
+
+		// Rule 3
+		if (type.vecsize == 3 && type.columns == 1)
+			return 4 * base_alignment;
+
+		// Rule 4 implied. Alignment does not change in std430.
+
+		// Rule 5. Column-major matrices are stored as arrays of
+		// vectors.
+		if ((flags & (1ull << DecorationColMajor)) && type.columns > 1)
+		{
+			if (type.vecsize == 3)
+				return 4 * base_alignment;
+			else
+				return type.vecsize * base_alignment;
+		}
+
+		// Rule 6 implied.
+
+		// Rule 7.
+		if ((flags & (1ull << DecorationRowMajor)) && type.vecsize > 1)
+		{
+			if (type.columns == 3)
+				return 4 * base_alignment;
+			else
+				return type.columns * base_alignment;
+		}
+
+		// Rule 8 implied.
+	}
+
+	throw CompilerError("Did not find suitable std430 rule for type. Bogus decorations?");
+}
+
+uint32_t Compiler::type_to_std430_array_stride(const SPIRType &type, uint64_t flags) const
+{
+	return type_to_std430_array_stride(type, flags, type.array.size());
+}
+
+uint32_t Compiler::type_to_std430_array_stride(const SPIRType &type, uint64_t flags, size_t array_depth) const
+{
+	// Array stride is equal to aligned size of the underlying type.
+	uint32_t size = type_to_std430_size(type, flags, array_depth - 1);
+	uint32_t alignment = type_to_std430_alignment(type, flags);
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+uint32_t Compiler::type_to_std430_size(const SPIRType &type, uint64_t flags) const
+{
+	return type_to_std430_size(type, flags, type.array.size());
+}
+
+uint32_t Compiler::type_to_std430_size(const SPIRType &type, uint64_t flags, size_t array_depth) const
+{
+	if (array_depth)
+		return type.array[array_depth - 1] * type_to_std430_array_stride(type, flags, array_depth);
+
+	const uint32_t base_alignment = type_to_std430_base_size(type);
+	uint32_t size = 0;
+
+	if (type.basetype == SPIRType::Struct)
+		size = get_struct_layout(type, BufferPackingStd430).size;
+	else
+	{
+		if (type.columns == 1)
+			size = type.vecsize * base_alignment;
+
+		if ((flags & (1ull << DecorationColMajor)) && type.columns > 1)
+		{
+			if (type.vecsize == 3)
+				size = type.columns * 4 * base_alignment;
+			else
+				size = type.columns * type.vecsize * base_alignment;
+		}
+
+		if ((flags & (1ull << DecorationRowMajor)) && type.vecsize > 1)
+		{
+			if (type.columns == 3)
+				size = type.vecsize * 4 * base_alignment;
+			else
+				size = type.vecsize * type.columns * base_alignment;
+		}
+	}
+
+	return size;
+}
+
+bool Compiler::BufferAccessHandler::handle(Op opcode, const uint32_t *args, uint32_t length)
+{
+	if (opcode != OpAccessChain && opcode != OpInBoundsAccessChain)
+		return true;
+
+	// Invalid SPIR-V.
+	if (length < 4)
+		return false;
+
+	if (args[2] != id)
+		return true;
+
+	// Don't bother traversing the entire access chain tree yet.
+	// If we access a struct member, assume we access the entire member.
+	uint32_t index = compiler.get<SPIRConstant>(args[3]).scalar();
+
+	// Seen this index already.
+	if (seen.find(index) != end(seen))
+		return true;
+	seen.insert(index);
+
+	auto &type = compiler.expression_type(id);
+	uint32_t offset = compiler.type_struct_member_offset(type, index);
+
+	size_t range;
+	// If we have another member in the struct, deduce the range by looking at the next member.
+	// This is okay since structs in SPIR-V can have padding, but Offset decoration must be
+	// monotonically increasing.
+	// Of course, this doesn't take into account if the SPIR-V for some reason decided to add
+	// very large amounts of padding, but that's not really a big deal.
+	if (index + 1 < type.member_types.size())
+	{
+		range = compiler.type_struct_member_offset(type, index + 1) - offset;
+	}
+	else
+	{
+		// No padding, so just deduce it from the size of the member directly.
+		range = compiler.get_declared_struct_member_size(type, index);
+	}
+
+	ranges.push_back({ index, offset, range });
+	return true;
+}
+
+std::vector<BufferRange> Compiler::get_active_buffer_ranges(uint32_t id) const
+{
+	std::vector<BufferRange> ranges;
+	BufferAccessHandler handler(*this, ranges, id);
+	traverse_all_reachable_uses(get<SPIRFunction>(entry_point), id, handler);
+	return ranges;
+}
+
+// Increase the number of IDs by the specified incremental amount.
+// Returns the value of the first ID available for use in the expanded bound.
+uint32_t Compiler::increase_bound_by(uint32_t incr_amount)
+{
+	uint32_t curr_bound = (uint32_t)ids.size();
+	uint32_t new_bound = curr_bound + incr_amount;
+	for (uint32_t i = 0; i < incr_amount; i++)
+		ids.emplace_back(pool_group.get());
+	meta.resize(new_bound);
+	return curr_bound;
+}
+
+bool Compiler::types_are_logically_equivalent(const SPIRType &a, const SPIRType &b) const
+{
+	if (a.basetype != b.basetype)
+		return false;
+	if (a.width != b.width)
+		return false;
 	if (a.vecsize != b.vecsize)
 		return false;
 	if (a.columns != b.columns)
@@ -2041,6 +2649,11 @@ uint32_t Compiler::get_execution_mode_argument(spv::ExecutionMode mode, uint32_t
 	}
 }
 
+const string &Compiler::get_current_entry_point_name() const
+{
+	return get_entry_point().name;
+}
+
 ExecutionModel Compiler::get_execution_model() const
 {
 	auto &execution = get_entry_point();
@@ -2074,15 +2687,15 @@ void Compiler::inherit_expression_dependencies(uint32_t dst, uint32_t source_exp
 	if (!s)
 		return;
 
+	// If we depend on a expression, we also depend on all sub-dependencies from source,
+	// but those are only looked up when something was invalidated.
+	// Copying them here would make long chains of forwarded expressions quadratic.
 	auto &e_deps = e.expression_dependencies;
-	auto &s_deps = s->expression_dependencies;
-
-	// If we depend on a expression, we also depend on all sub-dependencies from source.
-	e_deps.push_back(source_expression);
-	e_deps.insert(end(e_deps), begin(s_deps), end(s_deps));
-
-	// Eliminate duplicated dependencies.
-	e_deps.erase(unique(begin(e_deps), end(e_deps)), end(e_deps));
+	if (find(begin(e_deps), end(e_deps), source_expression) == end(e_deps))
+	{
+		e_deps.push_back(source_expression);
+		e.dependencies_checked_epoch = 0;
+	}
 }
 
 vector<string> Compiler::get_entry_points() const
@@ -2150,3 +2763,1265 @@ bool Compiler::interface_variable_exists_in_entry_point(uint32_t id) const
 	return find(begin(execution.interface_variables), end(execution.interface_variables), id) !=
 	       end(execution.interface_variables);
 }
+
+bool Compiler::ActiveIdHandler::handle(Op opcode, const uint32_t *args, uint32_t length)
+{
+	words.insert(end(words), args, args + length);
+	if (opcode == OpFunctionCall && length >= 3)
+		functions.insert(args[2]);
+	return true;
+}
+
+unordered_set<uint32_t> Compiler::get_active_global_ids() const
+{
+	vector<uint32_t> pending;
+	unordered_set<uint32_t> functions = { entry_point };
+	ActiveIdHandler handler(pending, functions);
+	traverse_all_reachable_opcodes(get<SPIRFunction>(entry_point), handler);
+
+	// Signatures and local variables are not opcodes in the blocks.
+	for (auto func_id : functions)
+	{
+		auto &func = get<SPIRFunction>(func_id);
+		pending.push_back(func.return_type);
+		for (auto &arg : func.arguments)
+			pending.push_back(arg.type);
+		pending.insert(end(pending), begin(func.local_variables), end(func.local_variables));
+	}
+
+	unordered_set<uint32_t> active;
+	while (!pending.empty())
+	{
+		uint32_t id = pending.back();
+		pending.pop_back();
+		if (id >= ids.size() || !active.insert(id).second)
+			continue;
+
+		switch (ids[id].get_type())
+		{
+		case TypeVariable:
+		{
+			auto &var = get<SPIRVariable>(id);
+			pending.push_back(var.basetype);
+			if (var.initializer)
+				pending.push_back(var.initializer);
+			break;
+		}
+
+		case TypeType:
+		{
+			auto &type = get<SPIRType>(id);
+			pending.push_back(type.self);
+			if (type.type_alias)
+				pending.push_back(type.type_alias);
+			pending.insert(end(pending), begin(type.member_types), end(type.member_types));
+			break;
+		}
+
+		case TypeConstant:
+		{
+			auto &c = get<SPIRConstant>(id);
+			pending.push_back(c.constant_type);
+			pending.insert(end(pending), begin(c.subconstants), end(c.subconstants));
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	return active;
+}
+
+uint32_t Compiler::get_recompile_count() const
+{
+	return recompile_count;
+}
+
+const char *spirv_cross::compiler_phase_to_string(CompilerPhase phase)
+{
+	switch (phase)
+	{
+	case CompilerPhaseParse:
+		return "parse";
+	case CompilerPhaseAnalysis:
+		return "analysis";
+	case CompilerPhaseEmitResources:
+		return "emit_resources";
+	case CompilerPhaseEmitFunctions:
+		return "emit_functions";
+	default:
+		return "unknown";
+	}
+}
+
+void Compiler::set_stats_enabled(bool enable)
+{
+	stats_enabled = enable;
+}
+
+void Compiler::set_stats_listener(CompilerStatsListener *listener)
+{
+	stats_listener = listener;
+	if (listener)
+		stats_enabled = true;
+}
+
+const CompilerStats &Compiler::get_stats() const
+{
+	return stats;
+}
+
+void Compiler::begin_stats()
+{
+	for (uint32_t i = CompilerPhaseAnalysis; i < CompilerPhaseCount; i++)
+		stats.phase_milliseconds[i] = 0.0;
+}
+
+void Compiler::end_stats(const string &output)
+{
+	stats.recompile_count = recompile_count;
+	stats.id_count = uint32_t(ids.size());
+	stats.output_bytes = output.size();
+
+	stats.allocation_count = 0;
+	stats.allocation_bytes = 0;
+	for (auto &pool : pool_group->pools)
+	{
+		if (pool)
+		{
+			stats.allocation_count += pool->allocation_count;
+			stats.allocation_bytes += pool->allocation_bytes;
+		}
+	}
+}
+
+Compiler::PhaseScope::PhaseScope(Compiler &compiler_, CompilerPhase phase_)
+    : compiler(compiler_)
+    , phase(phase_)
+    , active(compiler_.stats_enabled)
+{
+	if (!active)
+		return;
+
+	if (compiler.stats_listener)
+		compiler.stats_listener->begin_phase(phase);
+	start = chrono::steady_clock::now();
+}
+
+Compiler::PhaseScope::~PhaseScope()
+{
+	if (!active)
+		return;
+
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	compiler.stats.phase_milliseconds[phase] += ms;
+	if (compiler.stats_listener)
+		compiler.stats_listener->end_phase(phase, ms);
+}
+
+uint32_t Compiler::get_backing_variable_id(const unordered_map<uint32_t, uint32_t> &loaded_from, uint32_t id) const
+{
+	// Mirrors maybe_get_backing_variable(), but works on the loaded_from links found by analyze_usage().
+	if (maybe_get<SPIRVariable>(id))
+		return id;
+
+	auto itr = loaded_from.find(id);
+	if (itr != end(loaded_from) && maybe_get<SPIRVariable>(itr->second))
+		return itr->second;
+
+	return 0;
+}
+
+bool Compiler::op_always_emits_statement(const Instruction &i) const
+{
+	auto *ops = stream(i);
+	auto op = static_cast<Op>(i.op);
+
+	switch (op)
+	{
+	case OpStore:
+	{
+		// Stores to samplers and images are forwarded, see the statically_assigned hack.
+		auto *var = maybe_get<SPIRVariable>(ops[0]);
+		if (var)
+		{
+			auto &type = get<SPIRType>(var->basetype);
+			if (type.basetype == SPIRType::Image || type.basetype == SPIRType::SampledImage ||
+			    type.basetype == SPIRType::Sampler)
+				return false;
+		}
+		return true;
+	}
+
+	case OpLoad:
+		return analyzed_forced_temporaries.count(ops[1]) != 0;
+
+	case OpFunctionCall:
+		return get<SPIRType>(ops[0]).basetype == SPIRType::Void;
+
+	case OpCopyMemory:
+	case OpImageWrite:
+	case OpAtomicStore:
+	case OpControlBarrier:
+	case OpMemoryBarrier:
+	case OpEmitVertex:
+	case OpEndPrimitive:
+	case OpEmitStreamVertex:
+	case OpEndStreamPrimitive:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+template <typename F>
+void Compiler::for_each_id_operand(const Instruction &i, const F &func) const
+{
+	auto *ops = stream(i);
+	auto op = static_cast<Op>(i.op);
+	uint32_t length = i.length;
+
+	auto use = [&](uint32_t index) {
+		if (index < length)
+			func(ops[index]);
+	};
+
+	auto use_range = [&](uint32_t first) {
+		for (uint32_t index = first; index < length; index++)
+			func(ops[index]);
+	};
+
+	switch (op)
+	{
+	// Literal operands must not be treated as IDs.
+	case OpCompositeExtract:
+	case OpArrayLength:
+		use(2);
+		break;
+
+	case OpCompositeInsert:
+	case OpVectorShuffle:
+		use(2);
+		use(3);
+		break;
+
+	case OpExtInst:
+		use_range(4);
+		break;
+
+	case OpImageSampleImplicitLod:
+	case OpImageSampleExplicitLod:
+	case OpImageSampleProjImplicitLod:
+	case OpImageSampleProjExplicitLod:
+	case OpImageFetch:
+	case OpImageRead:
+		// Image operands follow the mask.
+		use(2);
+		use(3);
+		use_range(5);
+		break;
+
+	case OpImageSampleDrefImplicitLod:
+	case OpImageSampleDrefExplicitLod:
+	case OpImageSampleProjDrefImplicitLod:
+	case OpImageSampleProjDrefExplicitLod:
+	case OpImageGather:
+	case OpImageDrefGather:
+		use(2);
+		use(3);
+		use(4);
+		use_range(6);
+		break;
+
+	case OpImageWrite:
+		use(0);
+		use(1);
+		use(2);
+		use_range(4);
+		break;
+
+	case OpStore:
+	case OpCopyMemory:
+		use(0);
+		use(1);
+		break;
+
+	case OpFunctionCall:
+		use_range(3);
+		break;
+
+	case OpAtomicStore:
+	case OpControlBarrier:
+	case OpMemoryBarrier:
+		use_range(0);
+		break;
+
+	case OpEmitVertex:
+	case OpEndPrimitive:
+	case OpEmitStreamVertex:
+	case OpEndStreamPrimitive:
+	case OpLine:
+	case OpNop:
+		break;
+
+	default:
+		// Everything else is <result type> <result id> <id operands ...>.
+		use_range(2);
+		break;
+	}
+}
+
+template <typename F>
+void Compiler::for_each_written_pointer(const Instruction &i, const F &func) const
+{
+	// The same writes the emitter passes to register_write().
+	auto *ops = stream(i);
+	switch (static_cast<Op>(i.op))
+	{
+	case OpStore:
+		func(ops[0]);
+		break;
+
+	case OpExtInst:
+	{
+		auto op = static_cast<GLSLstd450>(ops[3]);
+		if (op == GLSLstd450Modf || op == GLSLstd450Frexp)
+			func(ops[5]);
+		break;
+	}
+
+	case OpFunctionCall:
+	{
+		auto &callee = get<SPIRFunction>(ops[2]);
+		for (uint32_t arg = 0; arg < callee.arguments.size() && arg + 3 < i.length; arg++)
+			if (callee.arguments[arg].write_count)
+				func(ops[arg + 3]);
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+void Compiler::invalidate_usage_analysis()
+{
+	usage_analysis_valid = false;
+}
+
+vector<uint32_t> Compiler::get_reachable_functions() const
+{
+	// traverse_all_reachable_opcodes() would visit a function once per call site.
+	vector<uint32_t> functions = { entry_point };
+	unordered_set<uint32_t> seen_functions = { entry_point };
+	for (size_t f = 0; f < functions.size(); f++)
+	{
+		for (auto &call : get_function_analysis(functions[f]).calls)
+		{
+			uint32_t callee = stream(get<SPIRBlock>(call.block).ops[call.index])[2];
+			if (seen_functions.insert(callee).second)
+				functions.push_back(callee);
+		}
+	}
+	return functions;
+}
+
+void Compiler::analyze_usage()
+{
+	if (usage_analysis_valid && analyzed_entry_point == entry_point)
+		return;
+
+	analyzed_use_counts.clear();
+	analyzed_forced_temporaries.clear();
+	analyzed_common_subexpressions.clear();
+
+	auto functions = get_reachable_functions();
+
+	// Record the same loaded_from links the emitter would set up.
+	unordered_map<uint32_t, uint32_t> loaded_from;
+	unordered_set<uint32_t> image_pointers;
+	for (auto f : functions)
+	{
+		for (auto block : get<SPIRFunction>(f).blocks)
+		{
+			for (auto &i : get<SPIRBlock>(block).ops)
+			{
+				auto *ops = stream(i);
+				switch (static_cast<Op>(i.op))
+				{
+				case OpImageTexelPointer:
+					image_pointers.insert(ops[1]);
+					loaded_from[ops[1]] = get_backing_variable_id(loaded_from, ops[2]);
+					break;
+
+				case OpLoad:
+					loaded_from[ops[1]] = get_backing_variable_id(loaded_from, ops[2]);
+					break;
+
+				case OpAccessChain:
+				case OpInBoundsAccessChain:
+					loaded_from[ops[1]] = ops[2];
+					break;
+
+				default:
+					break;
+				}
+			}
+		}
+	}
+
+	// Images which are actually read or written lose the speculative NonReadable/NonWritable qualifiers.
+	for (auto f : functions)
+	{
+		for (auto block : get<SPIRFunction>(f).blocks)
+		{
+			for (auto &i : get<SPIRBlock>(block).ops)
+			{
+				auto *ops = stream(i);
+				uint32_t image = 0;
+				uint64_t clear_flags = 0;
+
+				switch (static_cast<Op>(i.op))
+				{
+				case OpImageRead:
+					image = ops[2];
+					clear_flags = 1ull << DecorationNonReadable;
+					break;
+
+				case OpImageWrite:
+					image = ops[0];
+					clear_flags = 1ull << DecorationNonWritable;
+					break;
+
+				case OpAtomicExchange:
+				case OpAtomicCompareExchange:
+				case OpAtomicIIncrement:
+				case OpAtomicIDecrement:
+				case OpAtomicIAdd:
+				case OpAtomicISub:
+				case OpAtomicSMin:
+				case OpAtomicUMin:
+				case OpAtomicSMax:
+				case OpAtomicUMax:
+				case OpAtomicAnd:
+				case OpAtomicOr:
+				case OpAtomicXor:
+					if (image_pointers.count(ops[2]))
+					{
+						image = ops[2];
+						clear_flags = (1ull << DecorationNonReadable) | (1ull << DecorationNonWritable);
+					}
+					break;
+
+				default:
+					break;
+				}
+
+				uint32_t var = image ? get_backing_variable_id(loaded_from, image) : 0;
+				if (var)
+					meta[var].decoration.decoration_flags &= ~clear_flags;
+			}
+		}
+	}
+
+	// Parameters which are written to must be declared as out/inout.
+	// Writes propagate through out arguments of function calls, so iterate until nothing changes.
+	bool changed;
+	do
+	{
+		changed = false;
+		for (auto f : functions)
+		{
+			auto &func = get<SPIRFunction>(f);
+			auto mark_write = [&](uint32_t chain) {
+				uint32_t var = get_backing_variable_id(loaded_from, chain);
+				for (auto &arg : func.arguments)
+				{
+					if (var && arg.id == var && arg.write_count == 0)
+					{
+						arg.write_count++;
+						changed = true;
+					}
+				}
+			};
+
+			for (auto block : func.blocks)
+				for (auto &i : get<SPIRBlock>(block).ops)
+					for_each_written_pointer(i, mark_write);
+		}
+	} while (changed);
+
+	for (auto f : functions)
+		analyze_function_usage(get<SPIRFunction>(f), loaded_from);
+
+	// Loop headers which must emit statements before the condition can never become for/while loops,
+	// so don't try and fail during emit.
+	for (auto f : functions)
+	{
+		for (auto block_id : get<SPIRFunction>(f).blocks)
+		{
+			auto &block = get<SPIRBlock>(block_id);
+			const SPIRBlock *condition_block = nullptr;
+			if (block_is_loop_candidate(block, SPIRBlock::MergeToSelectForLoop))
+				condition_block = &block;
+			else if (block_is_loop_candidate(block, SPIRBlock::MergeToDirectForLoop))
+				condition_block = &get<SPIRBlock>(block.next_block);
+
+			if (condition_block)
+				for (auto &i : condition_block->ops)
+					if (op_always_emits_statement(i))
+						block.disable_block_optimization = true;
+		}
+	}
+
+	usage_analysis_valid = true;
+	analyzed_entry_point = entry_point;
+}
+
+void Compiler::analyze_function_usage(const SPIRFunction &func, const unordered_map<uint32_t, uint32_t> &loaded_from)
+{
+	// Values read by OpPhi are flushed when branching out of the incoming block.
+	unordered_map<uint32_t, vector<uint32_t>> phi_reads;
+	// Loads which are forwarded speculatively, and the variable they depend on.
+	unordered_map<uint32_t, uint32_t> load_variables;
+	unordered_map<uint32_t, uint32_t> load_blocks;
+
+	// The variables flush_all_active_variables() invalidates on every branch.
+	// Loads of anything else, e.g. inputs and buffers, only become invalid when they are written.
+	unordered_set<uint32_t> branch_flushed_variables(begin(func.local_variables), end(func.local_variables));
+	for (auto &arg : func.arguments)
+		branch_flushed_variables.insert(arg.id);
+	branch_flushed_variables.insert(begin(global_variables), end(global_variables));
+	branch_flushed_variables.insert(begin(aliased_variables), end(aliased_variables));
+
+	for (auto block_id : func.blocks)
+	{
+		auto &block = get<SPIRBlock>(block_id);
+		for (auto &phi : block.phi_variables)
+			phi_reads[phi.parent].push_back(phi.local_variable);
+
+		find_common_subexpressions(block, loaded_from);
+
+		for (auto &i : block.ops)
+		{
+			if (static_cast<Op>(i.op) != OpLoad)
+				continue;
+
+			auto *ops = stream(i);
+			uint32_t var = get_backing_variable_id(loaded_from, ops[2]);
+			if (var && !is_immutable(var))
+			{
+				load_variables[ops[1]] = var;
+				load_blocks[ops[1]] = block_id;
+			}
+		}
+	}
+
+	for (auto block_id : func.blocks)
+	{
+		auto &block = get<SPIRBlock>(block_id);
+
+		// Forwarded loads are invalidated when their variable is written, and on every branch.
+		// Reading them afterwards makes the emitter fall back to a temporary, so do that right away.
+		vector<uint32_t> active_loads;
+		unordered_set<uint32_t> flushed_loads;
+
+		auto read = [&](uint32_t id) {
+			// Reading a duplicate reads the expression it is replaced with.
+			auto cse = analyzed_common_subexpressions.find(id);
+			if (cse != end(analyzed_common_subexpressions))
+				id = cse->second;
+
+			analyzed_use_counts[id]++;
+
+			auto itr = load_blocks.find(id);
+			if (itr == end(load_blocks))
+				return;
+
+			// Continue blocks of for loops are emitted together with the loop header, so don't guess there.
+			bool flushed;
+			if (itr->second != block_id)
+				flushed = !is_continue(block_id) && branch_flushed_variables.count(load_variables[id]) != 0;
+			else
+				flushed = flushed_loads.count(id) != 0;
+
+			if (flushed)
+				analyzed_forced_temporaries.insert(id);
+		};
+
+		auto flush_variable = [&](uint32_t var) {
+			for (auto load : active_loads)
+				if (load_variables[load] == var)
+					flushed_loads.insert(load);
+		};
+
+		auto write = [&](uint32_t chain) {
+			uint32_t var = get_backing_variable_id(loaded_from, chain);
+			if (var)
+				flush_variable(var);
+		};
+
+		for (auto &i : block.ops)
+		{
+			auto *ops = stream(i);
+			auto op = static_cast<Op>(i.op);
+
+			// Function calls flush their out arguments before reading any argument,
+			// other writes are done after reading the operands.
+			if (op == OpFunctionCall || op == OpExtInst)
+			{
+				for_each_written_pointer(i, write);
+				if (op == OpFunctionCall && !function_is_pure(get<SPIRFunction>(ops[2])))
+				{
+					for (auto global : global_variables)
+						flush_variable(global);
+					for (auto aliased : aliased_variables)
+						flush_variable(aliased);
+				}
+				for_each_id_operand(i, read);
+			}
+			else
+			{
+				for_each_id_operand(i, read);
+				for_each_written_pointer(i, write);
+			}
+
+			switch (op)
+			{
+			case OpAtomicExchange:
+			case OpAtomicCompareExchange:
+			case OpAtomicLoad:
+			case OpAtomicIIncrement:
+			case OpAtomicIDecrement:
+			case OpAtomicIAdd:
+			case OpAtomicISub:
+			case OpAtomicSMin:
+			case OpAtomicUMin:
+			case OpAtomicSMax:
+			case OpAtomicUMax:
+			case OpAtomicAnd:
+			case OpAtomicOr:
+			case OpAtomicXor:
+				for (auto global : global_variables)
+					flush_variable(global);
+				for (auto aliased : aliased_variables)
+					flush_variable(aliased);
+				break;
+
+			case OpMemoryBarrier:
+				// Memory barriers flush the same variables as a branch.
+				if (get<SPIRConstant>(ops[1]).scalar())
+					for (auto load : active_loads)
+						if (branch_flushed_variables.count(load_variables[load]))
+							flushed_loads.insert(load);
+				break;
+
+			default:
+				break;
+			}
+
+			if (op == OpLoad && load_variables.count(ops[1]))
+				active_loads.push_back(ops[1]);
+		}
+
+		auto itr = phi_reads.find(block_id);
+		if (itr != end(phi_reads))
+			for (auto id : itr->second)
+				read(id);
+
+		if (block.terminator == SPIRBlock::Select || block.terminator == SPIRBlock::MultiSelect)
+			read(block.condition);
+		else if (block.terminator == SPIRBlock::Return && block.return_value)
+			read(block.return_value);
+	}
+}
+
+// Operations without side effects, whose result only depends on the result type and the operands.
+// All operands are IDs, except for the literals following the first id_operands operands of some of them.
+static bool op_is_pure_value(Op op, uint32_t &id_operands)
+{
+	id_operands = ~0u;
+	switch (op)
+	{
+	case OpCompositeExtract:
+		id_operands = 1;
+		return true;
+
+	case OpVectorShuffle:
+		id_operands = 2;
+		return true;
+
+	case OpCompositeConstruct:
+	case OpSNegate:
+	case OpFNegate:
+	case OpIAdd:
+	case OpFAdd:
+	case OpISub:
+	case OpFSub:
+	case OpIMul:
+	case OpFMul:
+	case OpUDiv:
+	case OpSDiv:
+	case OpFDiv:
+	case OpUMod:
+	case OpSMod:
+	case OpSRem:
+	case OpFMod:
+	case OpFRem:
+	case OpVectorTimesScalar:
+	case OpMatrixTimesScalar:
+	case OpVectorTimesMatrix:
+	case OpMatrixTimesVector:
+	case OpMatrixTimesMatrix:
+	case OpOuterProduct:
+	case OpDot:
+	case OpTranspose:
+	case OpConvertFToU:
+	case OpConvertFToS:
+	case OpConvertSToF:
+	case OpConvertUToF:
+	case OpUConvert:
+	case OpSConvert:
+	case OpFConvert:
+	case OpBitcast:
+	case OpShiftRightLogical:
+	case OpShiftRightArithmetic:
+	case OpShiftLeftLogical:
+	case OpBitwiseOr:
+	case OpBitwiseXor:
+	case OpBitwiseAnd:
+	case OpNot:
+	case OpAny:
+	case OpAll:
+	case OpIsNan:
+	case OpIsInf:
+	case OpLogicalEqual:
+	case OpLogicalNotEqual:
+	case OpLogicalOr:
+	case OpLogicalAnd:
+	case OpLogicalNot:
+	case OpSelect:
+	case OpIEqual:
+	case OpINotEqual:
+	case OpUGreaterThan:
+	case OpSGreaterThan:
+	case OpUGreaterThanEqual:
+	case OpSGreaterThanEqual:
+	case OpULessThan:
+	case OpSLessThan:
+	case OpULessThanEqual:
+	case OpSLessThanEqual:
+	case OpFOrdEqual:
+	case OpFUnordEqual:
+	case OpFOrdNotEqual:
+	case OpFUnordNotEqual:
+	case OpFOrdLessThan:
+	case OpFUnordLessThan:
+	case OpFOrdGreaterThan:
+	case OpFUnordGreaterThan:
+	case OpFOrdLessThanEqual:
+	case OpFUnordLessThanEqual:
+	case OpFOrdGreaterThanEqual:
+	case OpFUnordGreaterThanEqual:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+static bool op_is_pure_ext_inst(const uint32_t *ops)
+{
+	switch (static_cast<GLSLstd450>(ops[3]))
+	{
+	case GLSLstd450Modf:
+	case GLSLstd450Frexp:
+	case GLSLstd450InterpolateAtCentroid:
+	case GLSLstd450InterpolateAtSample:
+	case GLSLstd450InterpolateAtOffset:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+uint32_t Compiler::get_common_subexpression(const Instruction &i) const
+{
+	// Other instructions do not necessarily have a result ID in the second word.
+	uint32_t id_operands;
+	auto op = static_cast<Op>(i.op);
+	if (op != OpLoad && op != OpExtInst && !op_is_pure_value(op, id_operands))
+		return 0;
+
+	auto itr = analyzed_common_subexpressions.find(stream(i)[1]);
+	return itr != end(analyzed_common_subexpressions) ? itr->second : 0;
+}
+
+void Compiler::find_common_subexpressions(const SPIRBlock &block, const unordered_map<uint32_t, uint32_t> &loaded_from)
+{
+	auto canonical = [&](uint32_t id) {
+		auto itr = analyzed_common_subexpressions.find(id);
+		return itr != end(analyzed_common_subexpressions) ? itr->second : id;
+	};
+
+	// Access chains are never replaced, since stores need their own, but equal chains load the same value.
+	unordered_map<uint32_t, uint32_t> chains;
+	auto canonical_pointer = [&](uint32_t id) {
+		auto itr = chains.find(id);
+		return itr != end(chains) ? itr->second : id;
+	};
+
+	// Volatile and coherent memory can be written by something else between two loads, so each load reads it again.
+	const uint64_t volatile_mask = (1ull << DecorationVolatile) | (1ull << DecorationCoherent);
+	auto is_volatile_load = [&](const uint32_t *ops, uint32_t length) {
+		if (length > 3 && (ops[3] & MemoryAccessVolatileMask))
+			return true;
+
+		uint32_t var_id = get_backing_variable_id(loaded_from, ops[2]);
+		if (!var_id)
+			return false;
+		if (get_decoration_mask(var_id) & volatile_mask)
+			return true;
+
+		// Members of a block can be decorated one by one, so a decorated member keeps every load of the block.
+		auto &type = get<SPIRType>(get<SPIRVariable>(var_id).basetype);
+		for (uint32_t index = 0; index < uint32_t(type.member_types.size()); index++)
+			if (get_member_decoration_mask(type.self, index) & volatile_mask)
+				return true;
+		return false;
+	};
+
+	map<vector<uint32_t>, uint32_t> values;
+	map<vector<uint32_t>, uint32_t> pointers;
+	unordered_map<uint32_t, uint32_t> loads;
+
+	for (auto &i : block.ops)
+	{
+		auto *ops = stream(i);
+		auto op = static_cast<Op>(i.op);
+		uint32_t id_operands;
+
+		if (op == OpAccessChain || op == OpInBoundsAccessChain)
+		{
+			vector<uint32_t> key = { ops[0], canonical_pointer(ops[2]) };
+			for (uint32_t j = 3; j < i.length; j++)
+				key.push_back(canonical(ops[j]));
+
+			auto itr = pointers.find(key);
+			if (itr != end(pointers))
+				chains[ops[1]] = itr->second;
+			else
+				pointers[key] = ops[1];
+		}
+		else if (op == OpLoad)
+		{
+			// Nothing can have written to the pointer since the last load, see below.
+			// Images and samplers are left alone, backends look at how each of them was loaded.
+			if (is_volatile_load(ops, i.length))
+				continue;
+
+			auto basetype = get<SPIRType>(ops[0]).basetype;
+			uint32_t ptr = canonical_pointer(ops[2]);
+			auto itr = loads.find(ptr);
+			if (itr != end(loads) && basetype != SPIRType::Image && basetype != SPIRType::SampledImage &&
+			    basetype != SPIRType::Sampler)
+				analyzed_common_subexpressions[ops[1]] = itr->second;
+			else
+				loads[ptr] = ops[1];
+		}
+		else if (op_is_pure_value(op, id_operands) || (op == OpExtInst && op_is_pure_ext_inst(ops)))
+		{
+			vector<uint32_t> key = { uint32_t(op), ops[0] };
+			for (uint32_t j = 2; j < i.length; j++)
+			{
+				bool literal = op == OpExtInst ? j == 3 : j - 2 >= id_operands;
+				key.push_back(literal ? ops[j] : canonical(ops[j]));
+			}
+
+			auto itr = values.find(key);
+			if (itr != end(values))
+				analyzed_common_subexpressions[ops[1]] = itr->second;
+			else
+				values[key] = ops[1];
+		}
+		else
+		{
+			// Anything else might write memory. Function, private and output variables can only be written
+			// through themselves, loads of immutable variables never change.
+			uint32_t stored_var = 0;
+			if (op == OpStore)
+			{
+				stored_var = get_backing_variable_id(loaded_from, ops[0]);
+				auto *var = stored_var ? &get<SPIRVariable>(stored_var) : nullptr;
+				if (var && var->storage != StorageClassFunction && var->storage != StorageClassPrivate &&
+				    var->storage != StorageClassOutput)
+					stored_var = 0;
+			}
+
+			for (auto itr = begin(loads); itr != end(loads);)
+			{
+				uint32_t var = get_backing_variable_id(loaded_from, itr->first);
+				bool keep = stored_var ? var != stored_var : (var && is_immutable(var));
+				if (keep)
+					++itr;
+				else
+					itr = loads.erase(itr);
+			}
+		}
+	}
+}
+
+// Operations whose result is no more precise than their operands, so mediump operands give a mediump result.
+static bool op_keeps_relaxed_precision(Op op, bool aggressive)
+{
+	switch (op)
+	{
+	case OpFAdd:
+	case OpFSub:
+	case OpFMul:
+	case OpFNegate:
+	case OpVectorTimesScalar:
+	case OpCompositeConstruct:
+	case OpCompositeExtract:
+	case OpCompositeInsert:
+	case OpVectorShuffle:
+	case OpCopyObject:
+	case OpSelect:
+		return true;
+
+	case OpFDiv:
+	case OpDot:
+	case OpMatrixTimesScalar:
+	case OpMatrixTimesVector:
+	case OpVectorTimesMatrix:
+	case OpMatrixTimesMatrix:
+		return aggressive;
+
+	default:
+		return false;
+	}
+}
+
+static bool glsl_op_keeps_relaxed_precision(GLSLstd450 op, bool aggressive)
+{
+	switch (op)
+	{
+	case GLSLstd450FAbs:
+	case GLSLstd450FMin:
+	case GLSLstd450FMax:
+	case GLSLstd450FClamp:
+	case GLSLstd450FMix:
+	case GLSLstd450Step:
+	case GLSLstd450SmoothStep:
+		return true;
+
+	case GLSLstd450FSign:
+	case GLSLstd450Floor:
+	case GLSLstd450Ceil:
+	case GLSLstd450Fract:
+	case GLSLstd450Trunc:
+	case GLSLstd450Round:
+	case GLSLstd450Sqrt:
+	case GLSLstd450InverseSqrt:
+	case GLSLstd450Pow:
+	case GLSLstd450Length:
+	case GLSLstd450Normalize:
+		return aggressive;
+
+	default:
+		return false;
+	}
+}
+
+unordered_set<uint32_t> Compiler::find_relaxed_precision_ids(bool aggressive) const
+{
+	bool fragment = get_entry_point().model == ExecutionModelFragment;
+	auto is_decorated = [&](uint32_t id) {
+		return (meta[id].decoration.decoration_flags & (1ull << DecorationRelaxedPrecision)) != 0;
+	};
+	auto is_float = [&](uint32_t type) { return get<SPIRType>(type).basetype == SPIRType::Float; };
+
+	// Zero or within the range and precision ESSL guarantees for mediump.
+	auto is_mediump_constant = [&](uint32_t id) {
+		vector<uint32_t> pending = { id };
+		while (!pending.empty())
+		{
+			uint32_t c_id = pending.back();
+			pending.pop_back();
+			if (ids[c_id].get_type() == TypeUndef)
+				continue;
+
+			auto *c = maybe_get<SPIRConstant>(c_id);
+			if (!c || c->specialization || !is_float(c->constant_type))
+				return false;
+
+			if (!c->subconstants.empty())
+			{
+				pending.insert(end(pending), begin(c->subconstants), end(c->subconstants));
+				continue;
+			}
+
+			for (uint32_t col = 0; col < c->columns(); col++)
+			{
+				for (uint32_t row = 0; row < c->vector_size(); row++)
+				{
+					float v = fabs(c->scalar_f32(col, row));
+					if (v != 0.0f && (v < 1.0f / 16384.0f || v > 16384.0f))
+						return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	auto functions = get_reachable_functions();
+
+	// Candidates, and what they are computed from. A function variable is computed from the values stored to it.
+	unordered_map<uint32_t, vector<uint32_t>> inputs;
+	// Candidates and decorated values which are computed from a value.
+	unordered_map<uint32_t, vector<uint32_t>> readers;
+	// Values which are as precise as their RelaxedPrecision source.
+	unordered_set<uint32_t> exact;
+	// Candidates which are relaxed without relaxed inputs.
+	unordered_set<uint32_t> roots;
+	// Values and variables which something needs at full precision.
+	unordered_set<uint32_t> pinned;
+
+	// Function variables which are only loaded from and stored to directly can be relaxed.
+	unordered_set<uint32_t> locals;
+	for (auto f : functions)
+	{
+		auto &func = get<SPIRFunction>(f);
+		unordered_set<uint32_t> phi_variables;
+		for (auto block : func.blocks)
+		{
+			for (auto &phi : get<SPIRBlock>(block).phi_variables)
+			{
+				phi_variables.insert(phi.function_variable);
+				pinned.insert(phi.local_variable);
+			}
+		}
+
+		for (auto id : func.local_variables)
+		{
+			auto &var = get<SPIRVariable>(id);
+			if (!is_float(var.basetype) || phi_variables.count(id) ||
+			    (var.initializer && !is_mediump_constant(var.initializer)))
+				continue;
+
+			locals.insert(id);
+			auto &stored = inputs[id];
+			if (var.initializer)
+				stored.push_back(var.initializer);
+		}
+	}
+
+	auto is_exact = [&](uint32_t id) { return exact.count(id) || is_decorated(id); };
+	unordered_map<uint32_t, uint32_t> loaded_from;
+
+	for (auto f : functions)
+	{
+		for (auto block_id : get<SPIRFunction>(f).blocks)
+		{
+			auto &block = get<SPIRBlock>(block_id);
+			for (auto &i : block.ops)
+			{
+				auto *ops = stream(i);
+				auto op = static_cast<Op>(i.op);
+				auto pin_operands = [&]() { for_each_id_operand(i, [&](uint32_t id) { pinned.insert(id); }); };
+
+				switch (op)
+				{
+				case OpLoad:
+				{
+					uint32_t ptr = ops[2];
+					loaded_from[ops[1]] = ptr;
+					if (!is_float(ops[0]))
+						break;
+
+					auto *var = maybe_get<SPIRVariable>(ptr);
+					if (is_decorated(ptr))
+						exact.insert(ops[1]);
+					else if (locals.count(ptr))
+					{
+						inputs[ops[1]].push_back(ptr);
+						readers[ptr].push_back(ops[1]);
+					}
+					else if (aggressive && fragment && var && var->storage == StorageClassInput &&
+					         !is_builtin_variable(*var))
+					{
+						inputs[ops[1]];
+						roots.insert(ops[1]);
+					}
+					break;
+				}
+
+				case OpStore:
+				{
+					uint32_t ptr = ops[0];
+					uint32_t value = ops[1];
+					auto *var = maybe_get<SPIRVariable>(ptr);
+					if (locals.count(ptr))
+					{
+						inputs[ptr].push_back(value);
+						readers[value].push_back(ptr);
+					}
+					else if (!var || var->storage != StorageClassOutput || !(is_decorated(ptr) || (aggressive && fragment)))
+						pinned.insert(value);
+					break;
+				}
+
+				case OpImageSampleImplicitLod:
+				case OpImageSampleExplicitLod:
+				case OpImageSampleProjImplicitLod:
+				case OpImageSampleProjExplicitLod:
+				case OpImageSampleDrefImplicitLod:
+				case OpImageSampleDrefExplicitLod:
+				case OpImageSampleProjDrefImplicitLod:
+				case OpImageSampleProjDrefExplicitLod:
+				case OpImageFetch:
+				case OpImageGather:
+				case OpImageDrefGather:
+				{
+					// Coordinates always need full precision.
+					pin_operands();
+					if (!is_float(ops[0]))
+						break;
+
+					auto itr = loaded_from.find(ops[2]);
+					if (itr != end(loaded_from) && is_decorated(itr->second))
+						exact.insert(ops[1]);
+					else if (aggressive)
+					{
+						inputs[ops[1]];
+						roots.insert(ops[1]);
+					}
+					break;
+				}
+
+				case OpFOrdEqual:
+				case OpFUnordEqual:
+				case OpFOrdNotEqual:
+				case OpFUnordNotEqual:
+				case OpFOrdLessThan:
+				case OpFUnordLessThan:
+				case OpFOrdGreaterThan:
+				case OpFUnordGreaterThan:
+				case OpFOrdLessThanEqual:
+				case OpFUnordLessThanEqual:
+				case OpFOrdGreaterThanEqual:
+				case OpFUnordGreaterThanEqual:
+					if (!aggressive)
+						pin_operands();
+					break;
+
+				default:
+				{
+					bool keeps = op == OpExtInst ? get<SPIRExtension>(ops[2]).ext == SPIRExtension::GLSL &&
+					                                   glsl_op_keeps_relaxed_precision(GLSLstd450(ops[3]), aggressive) :
+					                               op_keeps_relaxed_precision(op, aggressive);
+					if (!keeps || !is_float(ops[0]))
+					{
+						pin_operands();
+						break;
+					}
+
+					uint32_t result = ops[1];
+					if (!is_decorated(result))
+						inputs[result];
+					for_each_id_operand(i, [&](uint32_t id) {
+						// The condition of a select is not part of the result.
+						if (op == OpSelect && id == ops[2])
+							return;
+						if (!is_decorated(result))
+							inputs[result].push_back(id);
+						readers[id].push_back(result);
+					});
+					break;
+				}
+				}
+			}
+
+			if (block.terminator == SPIRBlock::Return && block.return_value)
+				pinned.insert(block.return_value);
+		}
+	}
+
+	unordered_set<uint32_t> relaxed;
+	for (auto &candidate : inputs)
+		relaxed.insert(candidate.first);
+
+	auto keeps_relaxed = [&](uint32_t id) {
+		if (pinned.count(id))
+			return false;
+		for (auto input : inputs[id])
+			if (!is_exact(input) && !relaxed.count(input) && !is_mediump_constant(input))
+				return false;
+		for (auto reader : readers[id])
+			if (!is_decorated(reader) && !relaxed.count(reader))
+				return false;
+		return true;
+	};
+
+	vector<uint32_t> pending(begin(relaxed), end(relaxed));
+	for (;;)
+	{
+		// Dropping a candidate can break the candidates it is computed from and the ones computed from it.
+		while (!pending.empty())
+		{
+			uint32_t id = pending.back();
+			pending.pop_back();
+			if (!relaxed.count(id) || keeps_relaxed(id))
+				continue;
+
+			relaxed.erase(id);
+			auto &in = inputs[id];
+			auto &out = readers[id];
+			pending.insert(end(pending), begin(in), end(in));
+			pending.insert(end(pending), begin(out), end(out));
+		}
+
+		// Cycles of candidates which no relaxed value flows into, like loop counters, must stay as they are.
+		unordered_set<uint32_t> grounded;
+		vector<uint32_t> reached;
+		for (auto id : relaxed)
+		{
+			bool ground = roots.count(id) != 0;
+			for (auto input : inputs[id])
+				ground = ground || is_exact(input);
+			if (ground && grounded.insert(id).second)
+				reached.push_back(id);
+		}
+
+		while (!reached.empty())
+		{
+			uint32_t id = reached.back();
+			reached.pop_back();
+			for (auto reader : readers[id])
+				if (relaxed.count(reader) && grounded.insert(reader).second)
+					reached.push_back(reader);
+		}
+
+		for (auto itr = begin(relaxed); itr != end(relaxed);)
+		{
+			if (grounded.count(*itr))
+				++itr;
+			else
+			{
+				pending.insert(end(pending), begin(inputs[*itr]), end(inputs[*itr]));
+				pending.insert(end(pending), begin(readers[*itr]), end(readers[*itr]));
+				itr = relaxed.erase(itr);
+			}
+		}
+
+		if (pending.empty())
+			break;
+	}
+
+	relaxed.insert(begin(exact), end(exact));
+	return relaxed;
+}
@@ -18,6 +18,7 @@
 #define SPIRV_CROSS_HPP
 
 #include "spirv.hpp"
+#include <chrono>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -75,6 +76,91 @@ struct ShaderResources
 	std::vector<Resource> push_constant_buffers;
 };
 
+// Language and version from OpSource.
+struct SourceInfo
+{
+	uint32_t version = 0;
+	bool es = false;
+	bool known = false;
+
+	SourceInfo() = default;
+};
+
+// Result of parsing a SPIR-V module with Compiler::parse_ir().
+// The same ParsedIR can be used to create any number of compilers, e.g. one per backend
+// or per set of options, without parsing the module again.
+// The SPIR-V words are never modified after parsing and are shared between all compilers.
+// IDs, decorations and entry points are copied into each compiler since compilation mutates them.
+struct ParsedIR
+{
+	// If spirv_owner is empty, the words are a view of memory owned by the API user.
+	const uint32_t *spirv = nullptr;
+	size_t spirv_word_count = 0;
+	std::shared_ptr<const void> spirv_owner;
+
+	// IR objects are allocated from here, so it must be declared before ids.
+	std::unique_ptr<ObjectPoolGroup> pool_group;
+	std::vector<Variant> ids;
+	std::vector<Meta> meta;
+	std::deque<std::vector<Meta::Decoration>> member_meta;
+	StringTable strings;
+
+	std::vector<uint32_t> global_variables;
+	std::vector<uint32_t> aliased_variables;
+
+	uint32_t default_entry_point = 0;
+	std::unordered_map<uint32_t, SPIREntryPoint> entry_points;
+
+	SourceInfo source;
+
+	std::unordered_set<uint32_t> loop_blocks;
+	std::unordered_set<uint32_t> continue_blocks;
+	std::unordered_set<uint32_t> loop_merge_targets;
+	std::unordered_set<uint32_t> selection_merge_targets;
+	std::unordered_set<uint32_t> multiselect_merge_targets;
+
+	// Carried over to the stats of every compiler created from the module.
+	double parse_milliseconds = 0.0;
+	uint32_t instruction_count = 0;
+};
+
+// The phases of a compile, in the order they run.
+enum CompilerPhase
+{
+	CompilerPhaseParse,
+	CompilerPhaseAnalysis,
+	CompilerPhaseEmitResources,
+	CompilerPhaseEmitFunctions,
+	CompilerPhaseCount
+};
+
+const char *compiler_phase_to_string(CompilerPhase phase);
+
+// Where the time of the last compile() went, see Compiler::get_stats().
+struct CompilerStats
+{
+	// Phases are summed over every pass of compile(). Parsing is timed once when the module is parsed,
+	// the other phases only once stats are enabled.
+	double phase_milliseconds[CompilerPhaseCount] = {};
+	uint32_t recompile_count = 0;
+	uint32_t instruction_count = 0;
+	uint32_t id_count = 0;
+	size_t output_bytes = 0;
+	// IR objects allocated from the object pools of the compiler, including the ones made while parsing.
+	// Expressions and other temporaries are allocated again by every pass.
+	uint64_t allocation_count = 0;
+	uint64_t allocation_bytes = 0;
+};
+
+// Receives phases as they run, e.g. to forward them to the tracer of an application.
+// Called on the thread which calls compile().
+struct CompilerStatsListener
+{
+	virtual ~CompilerStatsListener() = default;
+	virtual void begin_phase(CompilerPhase phase) = 0;
+	virtual void end_phase(CompilerPhase phase, double milliseconds) = 0;
+};
+
 struct BufferRange
 {
 	unsigned index;
@@ -88,6 +174,22 @@ public:
 	// The constructor takes a buffer of SPIR-V words and parses it.
 	Compiler(std::vector<uint32_t> ir);
 
+	// Compiles a read-only view of SPIR-V words without copying them, e.g. from a memory mapped file.
+	// The words must outlive the compiler. Only a byte-swapped module is copied.
+	Compiler(const uint32_t *ir, size_t word_count);
+
+	// Creates a compiler from a module which has already been parsed with parse_ir().
+	Compiler(std::shared_ptr<const ParsedIR> ir);
+
+	// Parses a SPIR-V module once, so that several compilers can be created from it.
+	static std::shared_ptr<const ParsedIR> parse_ir(std::vector<uint32_t> spirv);
+
+	// Parses a view of SPIR-V words without copying them.
+	// owner is kept alive as long as the ParsedIR or any compiler created from it uses the words.
+	// If owner is empty, the words must outlive all of them.
+	static std::shared_ptr<const ParsedIR> parse_ir(const uint32_t *spirv, size_t word_count,
+	                                                std::shared_ptr<const void> owner = nullptr);
+
 	virtual ~Compiler() = default;
 
 	// After parsing, API users can modify the SPIR-V via reflection and call this
@@ -198,6 +300,7 @@ public:
 	// By default, the current entry point is set to the first OpEntryPoint which appears in the SPIR-V module.
 	std::vector<std::string> get_entry_points() const;
 	void set_entry_point(const std::string &name);
+	const std::string &get_current_entry_point_name() const;
 
 	// Returns the internal data structure for entry points to allow poking around.
 	const SPIREntryPoint &get_entry_point(const std::string &name) const;
@@ -214,6 +317,17 @@ public:
 	uint32_t get_execution_mode_argument(spv::ExecutionMode mode, uint32_t index = 0) const;
 	spv::ExecutionModel get_execution_model() const;
 
+	// Returns how many extra emit passes the last call to compile() needed.
+	// Most modules are resolved by the usage analysis up front and need none.
+	uint32_t get_recompile_count() const;
+
+	// Times the phases of compile(). Off by default, since it reads the clock a few times per pass.
+	void set_stats_enabled(bool enable);
+	// Also enables stats. The listener must outlive compile(), nullptr removes it.
+	void set_stats_listener(CompilerStatsListener *listener);
+	// Counters are updated at the end of compile().
+	const CompilerStats &get_stats() const;
+
 protected:
 	const uint32_t *stream(const Instruction &instr) const
 	{
@@ -223,15 +337,39 @@ protected:
 		if (!instr.length)
 			return nullptr;
 
-		if (instr.offset + instr.length > spirv.size())
+		if (instr.offset + instr.length > spirv_word_count)
 			throw CompilerError("Compiler::stream() out of range.");
 		return &spirv[instr.offset];
 	}
-	std::vector<uint32_t> spirv;
+
+	// The words are either owned through spirv_owner or a view of the API user's memory.
+	const uint32_t *spirv = nullptr;
+	size_t spirv_word_count = 0;
+	std::shared_ptr<const void> spirv_owner;
 
 	std::vector<Instruction> inst;
+
+	// IR objects are allocated from here, so it must be declared before ids.
+	std::unique_ptr<ObjectPoolGroup> pool_group;
 	std::vector<Variant> ids;
 	std::vector<Meta> meta;
+	// Member decorations are only needed by structs, so they are stored out of line.
+	// This is a deque so that references stay valid when other types get member decorations.
+	std::deque<std::vector<Meta::Decoration>> member_meta;
+	StringTable strings;
+
+	const std::string &get_alias(const Meta::Decoration &dec) const
+	{
+		return strings.get(dec.alias);
+	}
+
+	void set_alias(Meta::Decoration &dec, const std::string &alias)
+	{
+		dec.alias = strings.intern(alias);
+	}
+
+	const std::vector<Meta::Decoration> &get_member_meta(uint32_t id) const;
+	std::vector<Meta::Decoration> &get_or_create_member_meta(uint32_t id);
 
 	SPIRFunction *current_function = nullptr;
 	SPIRBlock *current_block = nullptr;
@@ -285,14 +423,7 @@ protected:
 	const SPIREntryPoint &get_entry_point() const;
 	SPIREntryPoint &get_entry_point();
 
-	struct Source
-	{
-		uint32_t version = 0;
-		bool es = false;
-		bool known = false;
-
-		Source() = default;
-	} source;
+	SourceInfo source;
 
 	std::unordered_set<uint32_t> loop_blocks;
 	std::unordered_set<uint32_t> continue_blocks;
@@ -340,10 +471,15 @@ protected:
 	void register_global_read_dependencies(const SPIRBlock &func, uint32_t id);
 	void register_global_read_dependencies(const SPIRFunction &func, uint32_t id);
 	std::unordered_set<uint32_t> invalid_expressions;
+	// Advanced whenever an expression is added to invalid_expressions.
+	uint64_t invalidation_epoch = 1;
+	void invalidate_expression(uint32_t id);
 
 	void update_name_cache(std::unordered_set<std::string> &cache, std::string &name);
 
 	bool function_is_pure(const SPIRFunction &func);
+	// True if op is used by func or any function it calls.
+	bool function_uses_opcode(const SPIRFunction &func, spv::Op op) const;
 	bool block_is_pure(const SPIRBlock &block);
 	bool block_is_outside_flow_control_from_block(const SPIRBlock &from, const SPIRBlock &to);
 
@@ -351,11 +487,131 @@ protected:
 	bool execution_is_noop(const SPIRBlock &from, const SPIRBlock &to) const;
 	SPIRBlock::ContinueBlockType continue_block_type(const SPIRBlock &continue_block) const;
 
+	struct InstructionLocation
+	{
+		uint32_t block = 0;
+		// Index into the ops of the block, the terminator is at ops.size().
+		uint32_t index = 0;
+		// Position among all instructions of the function, in block order.
+		uint32_t order = 0;
+	};
+
+	// Purity and use information for a function.
+	// The IR does not change shape after parsing, so this is built on the first query
+	// and reused by every compile pass instead of walking the blocks again.
+	struct FunctionAnalysis
+	{
+		// Everywhere an ID is read by an instruction or terminator, in instruction order.
+		std::unordered_map<uint32_t, std::vector<InstructionLocation>> uses;
+		// OpFunctionCall instructions, in instruction order.
+		std::vector<InstructionLocation> calls;
+		// False if the function, or any function it calls, has side effects.
+		bool pure = true;
+	};
+
+	const FunctionAnalysis &get_function_analysis(uint32_t func) const;
+	// Returns the instruction which defines an ID inside a function body, or nullptr.
+	const InstructionLocation *get_definition(uint32_t id) const;
+	// Must be called if blocks or functions are modified after parsing.
+	void invalidate_function_analysis();
+
 	bool force_recompile = false;
+	uint32_t recompile_count = 0;
+
+	// Times a phase for the rest of the scope, if stats are enabled.
+	class PhaseScope
+	{
+	public:
+		PhaseScope(Compiler &compiler, CompilerPhase phase);
+		~PhaseScope();
+
+	private:
+		PhaseScope(const PhaseScope &) = delete;
+		void operator=(const PhaseScope &) = delete;
+
+		Compiler &compiler;
+		CompilerPhase phase;
+		bool active;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	// Backends call these at the start and end of compile().
+	void begin_stats();
+	void end_stats(const std::string &output);
+
+	CompilerStats stats;
+	bool stats_enabled = false;
+	CompilerStatsListener *stats_listener = nullptr;
+
+	// Analyzes reachable code once before emit, so that decisions which would otherwise
+	// be discovered late and force a recompile can be made up front.
+	// Parameter writes, image access qualifiers and loop header shapes are resolved directly,
+	// forwarding decisions are left to the backend through analyzed_use_counts and analyzed_forced_temporaries.
+	// None of it depends on options, so the result is kept until the entry point, a decoration or the IR changes,
+	// and compiling the module again with other options only has to emit.
+	void analyze_usage();
+	void invalidate_usage_analysis();
+	bool usage_analysis_valid = false;
+	uint32_t analyzed_entry_point = 0;
+	// Number of times each ID is read in reachable code.
+	std::unordered_map<uint32_t, uint32_t> analyzed_use_counts;
+	// Loads which are read after being invalidated, and cannot be forwarded.
+	std::unordered_set<uint32_t> analyzed_forced_temporaries;
+	// Values which are computed again later in the same block, mapped to the first ID computing them.
+	// Repeated loads count when nothing can have written memory in between.
+	// The duplicates are emitted as the first ID, and their reads are counted for it.
+	std::unordered_map<uint32_t, uint32_t> analyzed_common_subexpressions;
+	// The ID computing the same value as the result of the instruction earlier, or 0.
+	uint32_t get_common_subexpression(const Instruction &i) const;
+
+	// The entry point and every function it calls, directly or indirectly, each once.
+	std::vector<uint32_t> get_reachable_functions() const;
+
+	// Values and function variables which can be given RelaxedPrecision without losing anything the shader needs.
+	// Values computed from RelaxedPrecision values and mediump-safe constants by a small set of operations qualify,
+	// as long as they only flow into other such values, function variables and RelaxedPrecision outputs.
+	// aggressive also allows the rest of the float arithmetic, texture results and fragment inputs as sources,
+	// comparisons as uses, and any fragment output as destination. Sources are still dropped when a value computed
+	// from them does not qualify.
+	std::unordered_set<uint32_t> find_relaxed_precision_ids(bool aggressive) const;
+
+	// Deep copies the IR as it is now, with everything the API user and usage analysis changed since parsing.
+	// Compilers created from the copy do not share any mutable state with this one.
+	std::shared_ptr<const ParsedIR> copy_ir() const;
 
 	uint32_t type_struct_member_offset(const SPIRType &type, uint32_t index) const;
 	uint32_t type_struct_member_array_stride(const SPIRType &type, uint32_t index) const;
 
+	enum BufferPackingRule
+	{
+		BufferPackingStd430,
+		// Offsets and array strides as decorated in the module.
+		BufferPackingDeclared,
+		BufferPackingRuleCount
+	};
+
+	// Layout of a struct under a packing rule. Every struct is laid out once per rule, and nested structs
+	// are looked up instead of laid out again, until a decoration changes.
+	// Alignment is only known for computed rules.
+	struct StructLayout
+	{
+		uint32_t size = 0;
+		uint32_t alignment = 0;
+		std::vector<uint32_t> member_offsets;
+	};
+	const StructLayout &get_struct_layout(const SPIRType &type, BufferPackingRule rule) const;
+	void invalidate_layouts();
+	mutable std::unordered_map<uint32_t, StructLayout> struct_layouts[BufferPackingRuleCount];
+
+	// From 7.6.2.2 in GL 4.5 core spec.
+	uint32_t type_to_std430_base_size(const SPIRType &type) const;
+	uint32_t type_to_std430_alignment(const SPIRType &type, uint64_t flags) const;
+	uint32_t type_to_std430_array_stride(const SPIRType &type, uint64_t flags) const;
+	uint32_t type_to_std430_size(const SPIRType &type, uint64_t flags) const;
+	// The array dimensions beyond array_depth are ignored, i.e. the size of an element for array_depth - 1.
+	uint32_t type_to_std430_size(const SPIRType &type, uint64_t flags, size_t array_depth) const;
+	uint32_t type_to_std430_array_stride(const SPIRType &type, uint64_t flags, size_t array_depth) const;
+
 	bool block_is_loop_candidate(const SPIRBlock &block, SPIRBlock::Method method) const;
 
 	uint32_t increase_bound_by(uint32_t incr_amount);
@@ -367,9 +623,17 @@ protected:
 	// variable is part of that entry points interface.
 	bool interface_variable_exists_in_entry_point(uint32_t id) const;
 
+	// Global variables, types and constants which code reachable from the entry point refers to,
+	// directly or through another one of them. Any operand word which happens to be the ID of one
+	// is taken to refer to it, so this can keep more than needed, but never less.
+	std::unordered_set<uint32_t> get_active_global_ids() const;
+
 private:
+	void parse(std::vector<uint32_t> words);
+	void parse(const uint32_t *words, size_t word_count);
 	void parse();
 	void parse(const Instruction &i);
+	static std::shared_ptr<const ParsedIR> move_to_parsed_ir(Compiler &compiler);
 
 	// Used internally to implement various traversals for queries.
 	struct OpcodeHandler
@@ -399,8 +663,46 @@ private:
 		std::unordered_set<uint32_t> seen;
 	};
 
+	struct ActiveIdHandler : OpcodeHandler
+	{
+		ActiveIdHandler(std::vector<uint32_t> &words_, std::unordered_set<uint32_t> &functions_)
+		    : words(words_)
+		    , functions(functions_)
+		{
+		}
+
+		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
+
+		std::vector<uint32_t> &words;
+		std::unordered_set<uint32_t> &functions;
+	};
+
 	bool traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHandler &handler) const;
 	bool traverse_all_reachable_opcodes(const SPIRFunction &block, OpcodeHandler &handler) const;
+	// Like traverse_all_reachable_opcodes(), but only visits the instructions which read id.
+	bool traverse_all_reachable_uses(const SPIRFunction &func, uint32_t id, OpcodeHandler &handler) const;
+
+	void build_function_analysis(const SPIRFunction &func, FunctionAnalysis &analysis) const;
+	bool compute_block_purity(const SPIRBlock &block) const;
+	spv::StorageClass get_pointer_storage_class(uint32_t ptr) const;
+
+	mutable std::unordered_map<uint32_t, FunctionAnalysis> function_analysis;
+	mutable std::unordered_map<uint32_t, InstructionLocation> definitions;
+	mutable bool definitions_valid = false;
+	mutable std::unordered_map<uint32_t, bool> block_purity;
+	// Memoized block walks, keyed on (from << 32) | to.
+	std::unordered_map<uint64_t, bool> outside_flow_control_cache;
+	mutable std::unordered_map<uint64_t, bool> branchless_cache;
+	mutable std::unordered_map<uint64_t, bool> noop_cache;
+
+	uint32_t get_backing_variable_id(const std::unordered_map<uint32_t, uint32_t> &loaded_from, uint32_t id) const;
+	bool op_always_emits_statement(const Instruction &i) const;
+	void analyze_function_usage(const SPIRFunction &func, const std::unordered_map<uint32_t, uint32_t> &loaded_from);
+	void find_common_subexpressions(const SPIRBlock &block, const std::unordered_map<uint32_t, uint32_t> &loaded_from);
+	template <typename F>
+	void for_each_id_operand(const Instruction &i, const F &func) const;
+	template <typename F>
+	void for_each_written_pointer(const Instruction &i, const F &func) const;
 	// This must be an ordered data structure so we always pick the same type aliases.
 	std::vector<uint32_t> global_struct_cache;
 };
@@ -18,6 +18,9 @@
 #include "GLSL.std.450.h"
 #include <algorithm>
 #include <assert.h>
+#include <exception>
+#include <thread>
+#include <typeinfo>
 
 using namespace spv;
 using namespace spirv_cross;
@@ -108,6 +111,27 @@ static uint32_t pls_format_to_components(PlsFormat format)
 	}
 }
 
+// The ordering bits are implied by every GLSL memory barrier, only the storage classes select the function.
+static const char *memory_barrier_function(uint32_t semantics)
+{
+	semantics &= ~uint32_t(MemorySemanticsAcquireMask | MemorySemanticsReleaseMask |
+	                       MemorySemanticsAcquireReleaseMask | MemorySemanticsSequentiallyConsistentMask);
+
+	switch (semantics)
+	{
+	case 0:
+		return nullptr;
+	case MemorySemanticsWorkgroupMemoryMask:
+		return "memoryBarrierShared";
+	case MemorySemanticsUniformMemoryMask:
+		return "memoryBarrierBuffer";
+	case MemorySemanticsImageMemoryMask:
+		return "memoryBarrierImage";
+	default:
+		return "memoryBarrier";
+	}
+}
+
 void CompilerGLSL::reset()
 {
 	// We do some speculative optimizations which should pretty much always work out,
@@ -117,14 +141,23 @@ void CompilerGLSL::reset()
 
 	// Clear invalid expression tracking.
 	invalid_expressions.clear();
+	invalidation_epoch++;
 	current_function = nullptr;
 
+	// Loads which are known to be read after they are invalidated can never be forwarded.
+	forced_temporaries.insert(begin(analyzed_forced_temporaries), end(analyzed_forced_temporaries));
+
 	// Clear temporary usage tracking.
 	expression_usage_counts.clear();
 	forwarded_temporaries.clear();
 
 	resource_names.clear();
 
+	// The previous pass is a good estimate of how much we are about to write.
+	auto size_hint = buffer.size();
+	buffer.reset();
+	buffer.reserve(size_hint);
+
 	for (auto &id : ids)
 	{
 		if (id.get_type() == TypeVariable)
@@ -147,6 +180,7 @@ void CompilerGLSL::reset()
 
 	statement_count = 0;
 	indent = 0;
+	minified_last_char = '\n';
 }
 
 void CompilerGLSL::remap_pls_variables()
@@ -178,34 +212,62 @@ void CompilerGLSL::remap_pls_variables()
 
 void CompilerGLSL::find_static_extensions()
 {
-	for (auto &id : ids)
+	// Types are never added after parsing, so the module only has to be scanned the first time.
+	if (!static_types_scanned)
 	{
-		if (id.get_type() == TypeType)
+		for (auto &id : ids)
 		{
-			auto &type = id.get<SPIRType>();
-			if (type.basetype == SPIRType::Double)
-			{
-				if (options.es)
-					throw CompilerError("FP64 not supported in ES profile.");
-				if (!options.es && options.version < 400)
-					require_extension("GL_ARB_gpu_shader_fp64");
-			}
-
-			if (type.basetype == SPIRType::Int64 || type.basetype == SPIRType::UInt64)
+			if (id.get_type() == TypeType)
 			{
-				if (options.es)
-					throw CompilerError("64-bit integers not supported in ES profile.");
-				if (!options.es)
-					require_extension("GL_ARB_gpu_shader_int64");
+				auto &type = id.get<SPIRType>();
+				if (type.basetype == SPIRType::Double)
+					uses_fp64 = true;
+				if (type.basetype == SPIRType::Int64 || type.basetype == SPIRType::UInt64)
+					uses_int64 = true;
 			}
 		}
+		static_types_scanned = true;
+	}
+
+	if (uses_fp64)
+	{
+		if (options.es)
+			throw CompilerError("FP64 not supported in ES profile.");
+		if (!options.es && options.version < 400)
+			require_extension_internal("GL_ARB_gpu_shader_fp64");
+	}
+
+	if (uses_int64)
+	{
+		if (options.es)
+			throw CompilerError("64-bit integers not supported in ES profile.");
+		if (!options.es)
+			require_extension_internal("GL_ARB_gpu_shader_int64");
 	}
 }
 
 string CompilerGLSL::compile()
 {
-	// Scan the SPIR-V to find trivial uses of extensions.
-	find_static_extensions();
+	begin_stats();
+
+	// Extensions and legacy outputs of the previous compile may not be needed with these options.
+	forced_extensions = requested_extensions;
+	restore_fragment_outputs();
+	restore_minified_names();
+	if (options.minify)
+		minify_names();
+
+	{
+		PhaseScope phase(*this, CompilerPhaseAnalysis);
+		// Scan the SPIR-V to find trivial uses of extensions.
+		find_static_extensions();
+		analyze_usage();
+
+		relaxed_precision_ids.clear();
+		if (options.es && options.precision_lowering != Options::NoLowering)
+			relaxed_precision_ids =
+			    find_relaxed_precision_ids(options.precision_lowering == Options::AggressiveLowering);
+	}
 
 	uint32_t pass_count = 0;
 	do
@@ -215,18 +277,53 @@ string CompilerGLSL::compile()
 
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
-
-		emit_header();
-		emit_resources();
+		{
+			PhaseScope phase(*this, CompilerPhaseEmitResources);
+			emit_header();
+			emit_resources();
+		}
 
-		emit_function(get<SPIRFunction>(entry_point), 0);
+		{
+			PhaseScope phase(*this, CompilerPhaseEmitFunctions);
+			if (!emit_functions_threaded())
+				emit_function(get<SPIRFunction>(entry_point), 0);
+		}
 
 		pass_count++;
 	} while (force_recompile);
 
-	return buffer->str();
+	recompile_count = pass_count - 1;
+
+	if (options.minify && minified_last_char != '\n')
+		append_minified("\n");
+
+	auto output = buffer.str();
+	end_stats(output);
+	return output;
+}
+
+vector<string> CompilerGLSL::compile_variants(const vector<Options> &variants)
+{
+	auto saved_options = options;
+	vector<string> sources;
+	sources.reserve(variants.size());
+
+	try
+	{
+		for (auto &variant : variants)
+		{
+			options = variant;
+			sources.push_back(compile());
+		}
+	}
+	catch (...)
+	{
+		options = saved_options;
+		throw;
+	}
+
+	options = saved_options;
+	return sources;
 }
 
 void CompilerGLSL::emit_header()
@@ -427,7 +524,7 @@ void CompilerGLSL::emit_struct(SPIRType &type)
 uint64_t CompilerGLSL::combined_decoration_for_member(const SPIRType &type, uint32_t index)
 {
 	uint64_t flags = 0;
-	auto &memb = meta[type.self].members;
+	auto &memb = get_member_meta(type.self);
 	if (index >= memb.size())
 		return 0;
 	auto &dec = memb[index];
@@ -447,7 +544,7 @@ string CompilerGLSL::layout_for_member(const SPIRType &type, uint32_t index)
 	if (!is_block)
 		return "";
 
-	auto &memb = meta[type.self].members;
+	auto &memb = get_member_meta(type.self);
 	if (index >= memb.size())
 		return 0;
 	auto &dec = memb[index];
@@ -608,145 +705,6 @@ const char *CompilerGLSL::format_to_glsl(spv::ImageFormat format)
 	}
 }
 
-uint32_t CompilerGLSL::type_to_std430_base_size(const SPIRType &type)
-{
-	switch (type.basetype)
-	{
-	case SPIRType::Double:
-	case SPIRType::Int64:
-	case SPIRType::UInt64:
-		return 8;
-	default:
-		return 4;
-	}
-}
-
-uint32_t CompilerGLSL::type_to_std430_alignment(const SPIRType &type, uint64_t flags)
-{
-	const uint32_t base_alignment = type_to_std430_base_size(type);
-
-	if (type.basetype == SPIRType::Struct)
-	{
-		// Rule 9. Structs alignments are maximum alignment of its members.
-		uint32_t alignment = 0;
-		for (uint32_t i = 0; i < type.member_types.size(); i++)
-		{
-			auto member_flags = meta[type.self].members.at(i).decoration_flags;
-			alignment = max(alignment, type_to_std430_alignment(get<SPIRType>(type.member_types[i]), member_flags));
-		}
-
-		return alignment;
-	}
-	else
-	{
-		// From 7.6.2.2 in GL 4.5 core spec.
-		// Rule 1
-		if (type.vecsize == 1 && type.columns == 1)
-			return base_alignment;
-
-		// Rule 2
-		if ((type.vecsize == 2 || type.vecsize == 4) && type.columns == 1)
-			return type.vecsize * base_alignment;
-
-		// Rule 3
-		if (type.vecsize == 3 && type.columns == 1)
-			return 4 * base_alignment;
-
-		// Rule 4 implied. Alignment does not change in std430.
-
-		// Rule 5. Column-major matrices are stored as arrays of
-		// vectors.
-		if ((flags & (1ull << DecorationColMajor)) && type.columns > 1)
-		{
-			if (type.vecsize == 3)
-				return 4 * base_alignment;
-			else
-				return type.vecsize * base_alignment;
-		}
-
-		// Rule 6 implied.
-
-		// Rule 7.
-		if ((flags & (1ull << DecorationRowMajor)) && type.vecsize > 1)
-		{
-			if (type.columns == 3)
-				return 4 * base_alignment;
-			else
-				return type.columns * base_alignment;
-		}
-
-		// Rule 8 implied.
-	}
-
-	throw CompilerError("Did not find suitable std430 rule for type. Bogus decorations?");
-}
-
-uint32_t CompilerGLSL::type_to_std430_array_stride(const SPIRType &type, uint64_t flags)
-{
-	// Array stride is equal to aligned size of the underlying type.
-	SPIRType tmp = type;
-	tmp.array.pop_back();
-	uint32_t size = type_to_std430_size(tmp, flags);
-	uint32_t alignment = type_to_std430_alignment(tmp, flags);
-	return (size + alignment - 1) & ~(alignment - 1);
-}
-
-uint32_t CompilerGLSL::type_to_std430_size(const SPIRType &type, uint64_t flags)
-{
-	if (!type.array.empty())
-		return type.array.back() * type_to_std430_array_stride(type, flags);
-
-	const uint32_t base_alignment = type_to_std430_base_size(type);
-	uint32_t size = 0;
-
-	if (type.basetype == SPIRType::Struct)
-	{
-		uint32_t pad_alignment = 1;
-
-		for (uint32_t i = 0; i < type.member_types.size(); i++)
-		{
-			auto member_flags = meta[type.self].members.at(i).decoration_flags;
-			auto &member_type = get<SPIRType>(type.member_types[i]);
-
-			uint32_t std430_alignment = type_to_std430_alignment(member_type, member_flags);
-			uint32_t alignment = max(std430_alignment, pad_alignment);
-
-			// The next member following a struct member is aligned to the base alignment of the struct that came before.
-			// GL 4.5 spec, 7.6.2.2.
-			if (member_type.basetype == SPIRType::Struct)
-				pad_alignment = std430_alignment;
-			else
-				pad_alignment = 1;
-
-			size = (size + alignment - 1) & ~(alignment - 1);
-			size += type_to_std430_size(member_type, member_flags);
-		}
-	}
-	else
-	{
-		if (type.columns == 1)
-			size = type.vecsize * base_alignment;
-
-		if ((flags & (1ull << DecorationColMajor)) && type.columns > 1)
-		{
-			if (type.vecsize == 3)
-				size = type.columns * 4 * base_alignment;
-			else
-				size = type.columns * type.vecsize * base_alignment;
-		}
-
-		if ((flags & (1ull << DecorationRowMajor)) && type.vecsize > 1)
-		{
-			if (type.columns == 3)
-				size = type.vecsize * 4 * base_alignment;
-			else
-				size = type.vecsize * type.columns * base_alignment;
-		}
-	}
-
-	return size;
-}
-
 bool CompilerGLSL::ssbo_is_std430_packing(const SPIRType &type)
 {
 	// This is very tricky and error prone, but try to be exhaustive and correct here.
@@ -762,28 +720,16 @@ bool CompilerGLSL::ssbo_is_std430_packing(const SPIRType &type)
 	// in arrays and structs. In std140 they take minimum vec4 alignment.
 	// std430 only removes the vec4 requirement.
 
-	uint32_t offset = 0;
-	uint32_t pad_alignment = 1;
+	auto &std430 = get_struct_layout(type, BufferPackingStd430);
+	auto &declared = get_struct_layout(type, BufferPackingDeclared);
 
 	for (uint32_t i = 0; i < type.member_types.size(); i++)
 	{
 		auto &memb_type = get<SPIRType>(type.member_types[i]);
-		auto member_flags = meta[type.self].members.at(i).decoration_flags;
+		auto member_flags = get_member_meta(type.self).at(i).decoration_flags;
 
 		// Verify alignment rules.
-		uint32_t std430_alignment = type_to_std430_alignment(memb_type, member_flags);
-		uint32_t alignment = max(std430_alignment, pad_alignment);
-		offset = (offset + alignment - 1) & ~(alignment - 1);
-
-		// The next member following a struct member is aligned to the base alignment of the struct that came before.
-		// GL 4.5 spec, 7.6.2.2.
-		if (memb_type.basetype == SPIRType::Struct)
-			pad_alignment = std430_alignment;
-		else
-			pad_alignment = 1;
-
-		uint32_t actual_offset = type_struct_member_offset(type, i);
-		if (actual_offset != offset) // This cannot be std430.
+		if (declared.member_offsets[i] != std430.member_offsets[i]) // This cannot be std430.
 			return false;
 
 		// Verify array stride rules.
@@ -794,9 +740,6 @@ bool CompilerGLSL::ssbo_is_std430_packing(const SPIRType &type)
 		// Verify that sub-structs also follow std430 rules.
 		if (!memb_type.member_types.empty() && !ssbo_is_std430_packing(memb_type))
 			return false;
-
-		// Bump size.
-		offset += type_to_std430_size(memb_type, member_flags);
 	}
 
 	return true;
@@ -1008,7 +951,7 @@ void CompilerGLSL::emit_uniform(const SPIRVariable &var)
 	if (type.basetype == SPIRType::Image)
 	{
 		if (!options.es && options.version < 420)
-			require_extension("GL_ARB_shader_image_load_store");
+			require_extension_internal("GL_ARB_shader_image_load_store");
 		else if (options.es && options.version < 310)
 			throw CompilerError("At least ESSL 3.10 required for shader image load store.");
 	}
@@ -1024,10 +967,164 @@ void CompilerGLSL::replace_fragment_output(SPIRVariable &var)
 	if (m.decoration_flags & (1ull << DecorationLocation))
 		location = m.location;
 
-	m.alias = join("gl_FragData[", location, "]");
+	replaced_fragment_outputs.push_back({ var.self, m.alias });
+	set_alias(m, join("gl_FragData[", location, "]"));
 	var.compat_builtin = true; // We don't want to declare this variable, but use the name as-is.
 }
 
+void CompilerGLSL::restore_fragment_outputs()
+{
+	for (auto &output : replaced_fragment_outputs)
+	{
+		meta[output.first].decoration.alias = output.second;
+		get<SPIRVariable>(output.first).compat_builtin = false;
+	}
+	replaced_fragment_outputs.clear();
+}
+
+// _a to _Z, then _aa and so on.
+static string minified_name(uint32_t index)
+{
+	static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	string name = "_";
+	for (;;)
+	{
+		name += alphabet[index % 52];
+		if (index < 52)
+			return name;
+		index = index / 52 - 1;
+	}
+}
+
+void CompilerGLSL::minify_names()
+{
+	// Structs which are part of the interface must keep their name, as it has to match in other stages.
+	unordered_set<uint32_t> interface_types;
+	vector<uint32_t> pending;
+	for (auto &id : ids)
+	{
+		if (id.get_type() == TypeVariable)
+		{
+			auto &var = id.get<SPIRVariable>();
+			if (var.storage != StorageClassFunction && var.storage != StorageClassPrivate &&
+			    var.storage != StorageClassWorkgroup)
+				pending.push_back(var.basetype);
+		}
+	}
+
+	while (!pending.empty())
+	{
+		auto &type = get<SPIRType>(pending.back());
+		pending.pop_back();
+		if (type.basetype == SPIRType::Struct && interface_types.insert(type.self).second)
+		{
+			// Aliased types are declared with the name of the type they alias.
+			if (type.type_alias)
+				pending.push_back(type.type_alias);
+			pending.insert(end(pending), begin(type.member_types), end(type.member_types));
+		}
+	}
+
+	vector<uint32_t> renamed;
+	unordered_set<string> kept_names;
+	for (uint32_t i = 0; i < ids.size(); i++)
+	{
+		auto &dec = meta[i].decoration;
+		bool rename = false;
+
+		switch (ids[i].get_type())
+		{
+		case TypeFunction:
+			rename = i != entry_point;
+			break;
+
+		case TypeVariable:
+		{
+			auto &var = get<SPIRVariable>(i);
+			rename = (var.storage == StorageClassFunction || var.storage == StorageClassPrivate ||
+			          var.storage == StorageClassWorkgroup) &&
+			         !is_builtin_variable(var);
+			break;
+		}
+
+		case TypeType:
+		{
+			auto &type = get<SPIRType>(i);
+			if (type.basetype == SPIRType::Struct)
+			{
+				rename = type.self == i && interface_types.count(i) == 0 &&
+				         (dec.decoration_flags & ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))) == 0;
+
+				// Members of blocks without an instance name are in the global scope.
+				for (auto &member : get_member_meta(i))
+					if (member.alias)
+						kept_names.insert(get_alias(member));
+			}
+			break;
+		}
+
+		case TypeNone:
+		case TypeExpression:
+			rename = dec.alias != 0;
+			break;
+
+		default:
+			break;
+		}
+
+		if (rename)
+			renamed.push_back(i);
+		else if (dec.alias)
+			kept_names.insert(get_alias(dec));
+	}
+
+	uint32_t index = 0;
+	for (auto id : renamed)
+	{
+		string name;
+		do
+			name = minified_name(index++);
+		while (kept_names.count(name));
+
+		auto &dec = meta[id].decoration;
+		minified_names.push_back({ id, dec.alias });
+		set_alias(dec, name);
+	}
+}
+
+void CompilerGLSL::restore_minified_names()
+{
+	for (auto &name : minified_names)
+		meta[name.first].decoration.alias = name.second;
+	minified_names.clear();
+}
+
+void CompilerGLSL::append_minified(const string &text)
+{
+	if (text.empty())
+		return;
+
+	// The preprocessor and comments need lines of their own.
+	bool own_line = text[0] == '#' || text.compare(0, 2, "//") == 0;
+	auto is_identifier = [](char c) { return isalnum(c) || c == '_'; };
+
+	if (minified_last_char != '\n')
+	{
+		if (own_line)
+			buffer << '\n';
+		else if (is_identifier(minified_last_char) && is_identifier(text[0]))
+			buffer << ' ';
+	}
+
+	buffer << text;
+	minified_last_char = text.back();
+	if (own_line && minified_last_char != '\n')
+	{
+		buffer << '\n';
+		minified_last_char = '\n';
+	}
+}
+
 void CompilerGLSL::replace_fragment_outputs()
 {
 	for (auto &id : ids)
@@ -1101,6 +1198,13 @@ void CompilerGLSL::emit_resources()
 {
 	auto &execution = get_entry_point();
 
+	unordered_set<uint32_t> active_ids;
+	if (options.strip_unused_resources)
+		active_ids = get_active_global_ids();
+	auto is_active = [&](uint32_t id) {
+		return !options.strip_unused_resources || active_ids.find(id) != end(active_ids);
+	};
+
 	// Legacy GL uses gl_FragData[], redeclare all fragment outputs
 	// with builtins.
 	if (execution.model == ExecutionModelFragment && is_legacy())
@@ -1119,7 +1223,8 @@ void CompilerGLSL::emit_resources()
 			auto &type = id.get<SPIRType>();
 			if (type.basetype == SPIRType::Struct && type.array.empty() && !type.pointer &&
 			    (meta[type.self].decoration.decoration_flags &
-			     ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))) == 0)
+			     ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))) == 0 &&
+			    is_active(type.self))
 			{
 				emit_struct(type);
 			}
@@ -1136,7 +1241,8 @@ void CompilerGLSL::emit_resources()
 
 			if (var.storage != StorageClassFunction && type.pointer && type.storage == StorageClassUniform &&
 			    !is_builtin_variable(var) && (meta[type.self].decoration.decoration_flags &
-			                                  ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))))
+			                                  ((1ull << DecorationBlock) | (1ull << DecorationBufferBlock))) &&
+			    is_active(var.self))
 			{
 				emit_buffer_block(var);
 			}
@@ -1150,7 +1256,8 @@ void CompilerGLSL::emit_resources()
 		{
 			auto &var = id.get<SPIRVariable>();
 			auto &type = get<SPIRType>(var.basetype);
-			if (var.storage != StorageClassFunction && type.pointer && type.storage == StorageClassPushConstant)
+			if (var.storage != StorageClassFunction && type.pointer && type.storage == StorageClassPushConstant &&
+			    is_active(var.self))
 				emit_push_constant_block(var);
 		}
 	}
@@ -1167,7 +1274,8 @@ void CompilerGLSL::emit_resources()
 
 			if (var.storage != StorageClassFunction && !is_builtin_variable(var) && !var.remapped_variable &&
 			    type.pointer &&
-			    (type.storage == StorageClassUniformConstant || type.storage == StorageClassAtomicCounter))
+			    (type.storage == StorageClassUniformConstant || type.storage == StorageClassAtomicCounter) &&
+			    is_active(var.self))
 			{
 				emit_uniform(var);
 				emitted = true;
@@ -1211,7 +1319,7 @@ void CompilerGLSL::emit_resources()
 	for (auto global : global_variables)
 	{
 		auto &var = get<SPIRVariable>(global);
-		if (var.storage != StorageClassOutput)
+		if (var.storage != StorageClassOutput && is_active(var.self))
 		{
 			add_resource_name(var.self);
 			statement(variable_decl(var), ";");
@@ -1238,13 +1346,13 @@ void CompilerGLSL::handle_invalid_expression(uint32_t id)
 	force_recompile = true;
 }
 
-string CompilerGLSL::to_expression(uint32_t id)
+void CompilerGLSL::check_expression_dependencies(uint32_t id)
 {
 	auto itr = invalid_expressions.find(id);
 	if (itr != end(invalid_expressions))
 		handle_invalid_expression(id);
 
-	if (ids[id].get_type() == TypeExpression)
+	if (ids[id].get_type() == TypeExpression && !invalid_expressions.empty())
 	{
 		// We might have a more complex chain of dependencies.
 		// A possible scenario is that we
@@ -1257,12 +1365,37 @@ string CompilerGLSL::to_expression(uint32_t id)
 		//
 		// However, we can propagate up a list of depended expressions when we used %2, so we can check if %2 is invalid when reading %3 after the store,
 		// and see that we should not forward reads of the original variable.
+		// Expressions only list their direct dependencies, so walk all of them.
+		// Nothing can have changed below an expression which was checked since the last invalidation,
+		// so every expression is walked at most once per invalidation, and not on every read.
 		auto &expr = get<SPIRExpression>(id);
-		for (uint32_t dep : expr.expression_dependencies)
+		if (expr.dependencies_checked_epoch == invalidation_epoch)
+			return;
+		expr.dependencies_checked_epoch = invalidation_epoch;
+
+		dependency_walk_stack.assign(begin(expr.expression_dependencies), end(expr.expression_dependencies));
+		while (!dependency_walk_stack.empty())
+		{
+			uint32_t dep = dependency_walk_stack.back();
+			dependency_walk_stack.pop_back();
+
 			if (invalid_expressions.find(dep) != end(invalid_expressions))
 				handle_invalid_expression(dep);
+
+			auto *dep_expr = maybe_get<SPIRExpression>(dep);
+			if (dep_expr && dep_expr->dependencies_checked_epoch != invalidation_epoch)
+			{
+				dep_expr->dependencies_checked_epoch = invalidation_epoch;
+				dependency_walk_stack.insert(end(dependency_walk_stack), begin(dep_expr->expression_dependencies),
+				                             end(dep_expr->expression_dependencies));
+			}
+		}
 	}
+}
 
+string CompilerGLSL::to_expression(uint32_t id)
+{
+	check_expression_dependencies(id);
 	track_expression_read(id);
 
 	switch (ids[id].get_type())
@@ -1270,7 +1403,9 @@ string CompilerGLSL::to_expression(uint32_t id)
 	case TypeExpression:
 	{
 		auto &e = get<SPIRExpression>(id);
-		if (e.base_expression)
+		if (e.rope)
+			return e.rope->flatten();
+		else if (e.base_expression)
 			return to_expression(e.base_expression) + e.expression;
 		else
 			return e.expression;
@@ -1522,7 +1657,7 @@ string CompilerGLSL::constant_expression_vector(const SPIRConstant &c, uint32_t
 string CompilerGLSL::declare_temporary(uint32_t result_type, uint32_t result_id)
 {
 	auto &type = get<SPIRType>(result_type);
-	auto flags = meta[result_id].decoration.decoration_flags;
+	auto flags = get_precision_flags(result_id);
 
 	// If we're declaring temporaries inside continue blocks,
 	// we must declare the temporary in the loop header so that the continue block can avoid declaring new variables.
@@ -1552,16 +1687,62 @@ bool CompilerGLSL::expression_is_forwarded(uint32_t id)
 	return forwarded_temporaries.find(id) != end(forwarded_temporaries);
 }
 
-SPIRExpression &CompilerGLSL::emit_op(uint32_t result_type, uint32_t result_id, const string &rhs, bool forwarding,
-                                      bool extra_parens, bool suppress_usage_tracking)
+void CompilerGLSL::append_expression(ExpressionRope &rope, uint32_t id)
+{
+	auto *e = maybe_get<SPIRExpression>(id);
+	if (e && e->rope)
+	{
+		check_expression_dependencies(id);
+		track_expression_read(id);
+		rope.append(e->rope);
+	}
+	else
+		rope.append(to_expression(id));
+}
+
+bool CompilerGLSL::should_forward_op(uint32_t result_id, bool forwarding, bool suppress_usage_tracking)
 {
+	// An expression we know will be read more than once would be forced to a temporary on the next pass anyway.
+	if (forwarding && !suppress_usage_tracking)
+	{
+		auto itr = analyzed_use_counts.find(result_id);
+		if (itr != end(analyzed_use_counts) && itr->second >= 2)
+			forced_temporaries.insert(result_id);
+	}
+
 	if (forwarding && (forced_temporaries.find(result_id) == end(forced_temporaries)))
 	{
 		// Just forward it without temporary.
 		// If the forward is trivial, we do not force flushing to temporary for this expression.
 		if (!suppress_usage_tracking)
 			forwarded_temporaries.insert(result_id);
+		return true;
+	}
+	else
+		return false;
+}
+
+SPIRExpression &CompilerGLSL::emit_op(uint32_t result_type, uint32_t result_id, shared_ptr<ExpressionRope> rhs,
+                                      bool forwarding, bool extra_parens)
+{
+	if (should_forward_op(result_id, forwarding, false))
+	{
+		if (extra_parens)
+			rhs->enclose();
 
+		auto &e = set<SPIRExpression>(result_id, "", result_type, true);
+		e.rope = move(rhs);
+		return e;
+	}
+	else
+		return emit_op(result_type, result_id, rhs->flatten(), false, false);
+}
+
+SPIRExpression &CompilerGLSL::emit_op(uint32_t result_type, uint32_t result_id, const string &rhs, bool forwarding,
+                                      bool extra_parens, bool suppress_usage_tracking)
+{
+	if (should_forward_op(result_id, forwarding, suppress_usage_tracking))
+	{
 		if (extra_parens)
 			return set<SPIRExpression>(result_id, join("(", rhs, ")"), result_type, true);
 		else
@@ -1575,10 +1756,34 @@ SPIRExpression &CompilerGLSL::emit_op(uint32_t result_type, uint32_t result_id,
 	}
 }
 
+void CompilerGLSL::emit_common_subexpression(uint32_t result_type, uint32_t result_id, uint32_t first_id)
+{
+	auto *first = maybe_get<SPIRExpression>(first_id);
+	if (first && expression_is_forwarded(first_id) && forced_temporaries.find(result_id) == end(forced_temporaries))
+	{
+		// Reading a forwarded expression counts as a use, even if the duplicate is never read itself.
+		// Share the expression instead, analyze_usage() already made it a temporary if both are read.
+		auto &e = set<SPIRExpression>(result_id, first->expression, result_type, true);
+		e.rope = first->rope;
+		e.base_expression = first->base_expression;
+		e.loaded_from = first->loaded_from;
+	}
+	else
+	{
+		auto &e = emit_op(result_type, result_id, to_expression(first_id), true, false, true);
+		if (first)
+			e.loaded_from = first->loaded_from;
+	}
+	inherit_expression_dependencies(result_id, first_id);
+}
+
 void CompilerGLSL::emit_unary_op(uint32_t result_type, uint32_t result_id, uint32_t op0, const char *op)
 {
 	bool forward = should_forward(op0);
-	emit_op(result_type, result_id, join(op, to_expression(op0)), forward, true);
+	auto rope = make_shared<ExpressionRope>();
+	rope->append(op);
+	append_expression(*rope, op0);
+	emit_op(result_type, result_id, move(rope), forward, true);
 
 	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
 		inherit_expression_dependencies(result_id, op0);
@@ -1587,7 +1792,11 @@ void CompilerGLSL::emit_unary_op(uint32_t result_type, uint32_t result_id, uint3
 void CompilerGLSL::emit_binary_op(uint32_t result_type, uint32_t result_id, uint32_t op0, uint32_t op1, const char *op)
 {
 	bool forward = should_forward(op0) && should_forward(op1);
-	emit_op(result_type, result_id, join(to_expression(op0), " ", op, " ", to_expression(op1)), forward, true);
+	auto rope = make_shared<ExpressionRope>();
+	append_expression(*rope, op0);
+	rope->append(join(" ", op, " "));
+	append_expression(*rope, op1);
+	emit_op(result_type, result_id, move(rope), forward, true);
 
 	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
 	{
@@ -1833,7 +2042,7 @@ void CompilerGLSL::emit_texture_op(const Instruction &i)
 	auto op = static_cast<Op>(i.op);
 	uint32_t length = i.length;
 
-	if (i.offset + length > spirv.size())
+	if (i.offset + length > spirv_word_count)
 		throw CompilerError("Compiler::parse() opcode out of range.");
 
 	uint32_t result_type = ops[0];
@@ -2853,6 +3062,14 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 #define BFOP(op) emit_binary_func_op(ops[0], ops[1], ops[2], ops[3], #op)
 #define UFOP(op) emit_unary_func_op(ops[0], ops[1], ops[2], #op)
 
+	// The same value was computed earlier in this block, so read that one again instead.
+	uint32_t common_subexpression = get_common_subexpression(instruction);
+	if (common_subexpression)
+	{
+		emit_common_subexpression(ops[0], ops[1], common_subexpression);
+		return;
+	}
+
 	switch (opcode)
 	{
 	// Dealing with memory
@@ -2952,6 +3169,9 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 
 		string funexpr;
 		funexpr += to_name(func) + "(";
+		funexpr += implicit_function_arguments(callee);
+		if (length && funexpr.back() != '(')
+			funexpr += ", ";
 		for (uint32_t i = 0; i < length; i++)
 		{
 			funexpr += to_expression(arg[i]);
@@ -3145,7 +3365,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 			register_write(composite);
 			register_read(id, composite, true);
 			// Invalidate the old expression we inserted into.
-			invalid_expressions.insert(composite);
+			invalidate_expression(composite);
 		}
 		break;
 	}
@@ -3773,7 +3993,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 	{
 		if (!options.es && options.version < 400)
 		{
-			require_extension("GL_ARB_texture_query_lod");
+			require_extension_internal("GL_ARB_texture_query_lod");
 			// For some reason, the ARB spec is all-caps.
 			BFOP(textureQueryLOD);
 		}
@@ -3787,7 +4007,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 	case OpImageQueryLevels:
 	{
 		if (!options.es && options.version < 430)
-			require_extension("GL_ARB_texture_query_levels");
+			require_extension_internal("GL_ARB_texture_query_levels");
 		if (options.es)
 			throw CompilerError("textureQueryLevels not supported in ES profile.");
 		UFOP(textureQueryLevels);
@@ -4014,11 +4234,9 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 		// Ignore execution and memory scope.
 		if (get_entry_point().model == ExecutionModelGLCompute)
 		{
-			uint32_t mem = get<SPIRConstant>(ops[2]).scalar();
-			if (mem == MemorySemanticsWorkgroupMemoryMask)
-				statement("memoryBarrierShared();");
-			else if (mem)
-				statement("memoryBarrier();");
+			const char *func = memory_barrier_function(get<SPIRConstant>(ops[2]).scalar());
+			if (func)
+				statement(func, "();");
 		}
 		statement("barrier();");
 		break;
@@ -4032,10 +4250,9 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 		if (mem)
 			flush_all_active_variables();
 
-		if (mem == MemorySemanticsWorkgroupMemoryMask)
-			statement("memoryBarrierShared();");
-		else if (mem)
-			statement("memoryBarrier();");
+		const char *func = memory_barrier_function(mem);
+		if (func)
+			statement(func, "();");
 		break;
 	}
 
@@ -4060,30 +4277,29 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 
 string CompilerGLSL::to_member_name(const SPIRType &type, uint32_t index)
 {
-	auto &memb = meta[type.self].members;
-	if (index < memb.size() && !memb[index].alias.empty())
-		return memb[index].alias;
+	auto &memb = get_member_meta(type.self);
+	if (index < memb.size() && memb[index].alias)
+		return get_alias(memb[index]);
 	else
 		return join("_", index);
 }
 
 void CompilerGLSL::add_member_name(SPIRType &type, uint32_t index)
 {
-	auto &memb = meta[type.self].members;
-	if (index < memb.size() && !memb[index].alias.empty())
+	if (index < get_member_meta(type.self).size() && get_member_meta(type.self)[index].alias)
 	{
-		auto &name = memb[index].alias;
-		if (name.empty())
-			return;
+		auto &dec = get_or_create_member_meta(type.self)[index];
+		auto name = get_alias(dec);
 
 		// Reserved for temporaries.
 		if (name[0] == '_' && name.size() >= 2 && isdigit(name[1]))
 		{
-			name.clear();
+			dec.alias = 0;
 			return;
 		}
 
 		update_name_cache(type.member_name_cache, name);
+		set_alias(dec, name);
 	}
 }
 
@@ -4095,7 +4311,7 @@ string CompilerGLSL::variable_decl(const SPIRType &type, const std::string &name
 string CompilerGLSL::member_decl(const SPIRType &type, const SPIRType &membertype, uint32_t index)
 {
 	uint64_t memberflags = 0;
-	auto &memb = meta[type.self].members;
+	auto &memb = get_member_meta(type.self);
 	if (index < memb.size())
 		memberflags = memb[index].decoration_flags;
 
@@ -4148,7 +4364,15 @@ const char *CompilerGLSL::flags_to_precision_qualifiers_glsl(const SPIRType &typ
 
 const char *CompilerGLSL::to_precision_qualifiers_glsl(uint32_t id)
 {
-	return flags_to_precision_qualifiers_glsl(expression_type(id), meta[id].decoration.decoration_flags);
+	return flags_to_precision_qualifiers_glsl(expression_type(id), get_precision_flags(id));
+}
+
+uint64_t CompilerGLSL::get_precision_flags(uint32_t id) const
+{
+	auto flags = meta[id].decoration.decoration_flags;
+	if (relaxed_precision_ids.count(id))
+		flags |= 1ull << DecorationRelaxedPrecision;
+	return flags;
 }
 
 string CompilerGLSL::to_qualifiers_glsl(uint32_t id)
@@ -4311,9 +4535,9 @@ string CompilerGLSL::image_type_glsl(const SPIRType &type)
 
 	case DimBuffer:
 		if (options.es && options.version < 320)
-			require_extension("GL_OES_texture_buffer");
+			require_extension_internal("GL_OES_texture_buffer");
 		else if (!options.es && options.version < 300)
-			require_extension("GL_EXT_texture_buffer_object");
+			require_extension_internal("GL_EXT_texture_buffer_object");
 		res += "Buffer";
 		break;
 
@@ -4458,18 +4682,20 @@ string CompilerGLSL::type_to_glsl(const SPIRType &type)
 
 void CompilerGLSL::add_variable(unordered_set<string> &variables, uint32_t id)
 {
-	auto &name = meta[id].decoration.alias;
+	auto &dec = meta[id].decoration;
+	auto name = get_alias(dec);
 	if (name.empty())
 		return;
 
 	// Reserved for temporaries.
 	if (name[0] == '_' && name.size() >= 2 && isdigit(name[1]))
 	{
-		name.clear();
+		dec.alias = 0;
 		return;
 	}
 
 	update_name_cache(variables, name);
+	set_alias(dec, name);
 }
 
 void CompilerGLSL::add_local_variable_name(uint32_t id)
@@ -4488,6 +4714,12 @@ void CompilerGLSL::add_header_line(const std::string &line)
 }
 
 void CompilerGLSL::require_extension(const string &ext)
+{
+	requested_extensions.insert(ext);
+	require_extension_internal(ext);
+}
+
+void CompilerGLSL::require_extension_internal(const string &ext)
 {
 	if (forced_extensions.find(ext) == end(forced_extensions))
 	{
@@ -4502,7 +4734,7 @@ bool CompilerGLSL::check_atomic_image(uint32_t id)
 	if (type.storage == StorageClassImage)
 	{
 		if (options.es && options.version < 320)
-			require_extension("GL_OES_shader_image_atomic");
+			require_extension_internal("GL_OES_shader_image_atomic");
 
 		auto *var = maybe_get_backing_variable(id);
 		if (var)
@@ -4589,8 +4821,14 @@ void CompilerGLSL::emit_function(SPIRFunction &func, uint64_t return_flags)
 		}
 	}
 
+	emit_function_body(func, return_flags);
+}
+
+void CompilerGLSL::emit_function_body(SPIRFunction &func, uint64_t return_flags)
+{
 	emit_function_prototype(func, return_flags);
 	begin_scope();
+	emit_function_prologue(func);
 
 	current_function = &func;
 
@@ -4631,6 +4869,205 @@ void CompilerGLSL::emit_function(SPIRFunction &func, uint64_t return_flags)
 	statement("");
 }
 
+void CompilerGLSL::collect_function_emit_order(uint32_t func, uint64_t return_flags, unordered_set<uint32_t> &seen,
+                                               vector<FunctionEmit> &order)
+{
+	if (!seen.insert(func).second)
+		return;
+
+	for (auto block : get<SPIRFunction>(func).blocks)
+	{
+		for (auto &i : get<SPIRBlock>(block).ops)
+		{
+			auto ops = stream(i);
+			if (static_cast<Op>(i.op) == OpFunctionCall)
+				collect_function_emit_order(ops[2], meta[ops[1]].decoration.decoration_flags, seen, order);
+		}
+	}
+
+	order.push_back({ func, return_flags });
+}
+
+// Emits the first run of functions on this thread, and hands the other runs to compilers created from a copy of the IR.
+// The copy is taken after this pass has emitted the header and resources. Every compiler emits them again from the copy,
+// which gets it to the same state, since emitting them only sets state which is already set,
+// and function bodies only depend on state of their own function.
+bool CompilerGLSL::emit_functions_threaded()
+{
+	// Subclasses can override how anything is emitted, and the other compilers would not know.
+	if (typeid(*this) != typeid(CompilerGLSL))
+		return false;
+
+	uint32_t thread_count = emit_thread_count ? emit_thread_count : thread::hardware_concurrency();
+	if (thread_count <= 1)
+		return false;
+
+	vector<FunctionEmit> functions;
+	unordered_set<uint32_t> seen;
+	collect_function_emit_order(entry_point, 0, seen, functions);
+	thread_count = min(thread_count, uint32_t(functions.size()));
+	if (thread_count <= 1)
+		return false;
+
+	// Split into runs of about the same number of instructions.
+	vector<size_t> sizes;
+	size_t total_size = 0;
+	for (auto &f : functions)
+	{
+		size_t size = 1;
+		for (auto block : get<SPIRFunction>(f.first).blocks)
+			size += get<SPIRBlock>(block).ops.size();
+		sizes.push_back(size);
+		total_size += size;
+	}
+
+	vector<size_t> run_begin = { 0 };
+	size_t accumulated = 0;
+	for (size_t i = 0; i + 1 < functions.size() && run_begin.size() < thread_count; i++)
+	{
+		accumulated += sizes[i];
+		if (accumulated * thread_count >= total_size * run_begin.size())
+			run_begin.push_back(i + 1);
+	}
+	run_begin.push_back(functions.size());
+	size_t run_count = run_begin.size() - 1;
+	if (run_count <= 1)
+		return false;
+
+	// Everything emit_header() and emit_resources() depend on besides the IR.
+	// Run 0 changes some of it as soon as it emits, so copy all of it before any thread starts.
+	struct WorkerState
+	{
+		Options options;
+		BackendVariations backend;
+		vector<PlsRemap> pls_inputs;
+		vector<PlsRemap> pls_outputs;
+		vector<string> header_lines;
+		unordered_set<string> requested_extensions;
+		unordered_set<string> forced_extensions;
+		unordered_set<uint32_t> forced_temporaries;
+		unordered_map<uint32_t, uint32_t> analyzed_use_counts;
+		unordered_set<uint32_t> analyzed_forced_temporaries;
+		unordered_map<uint32_t, uint32_t> analyzed_common_subexpressions;
+		unordered_set<uint32_t> relaxed_precision_ids;
+		uint32_t entry_point;
+	};
+	const WorkerState state = { options,
+		                        backend,
+		                        pls_inputs,
+		                        pls_outputs,
+		                        header_lines,
+		                        requested_extensions,
+		                        forced_extensions,
+		                        forced_temporaries,
+		                        analyzed_use_counts,
+		                        analyzed_forced_temporaries,
+		                        analyzed_common_subexpressions,
+		                        relaxed_precision_ids,
+		                        entry_point };
+
+	auto ir = copy_ir();
+	vector<string> chunks(run_count);
+	vector<unordered_set<string>> chunk_extensions(run_count);
+	vector<exception_ptr> errors(run_count);
+	vector<thread> threads;
+	for (size_t run = 1; run < run_count; run++)
+	{
+		threads.emplace_back([&, run] {
+			try
+			{
+				CompilerGLSL compiler(ir);
+				compiler.options = state.options;
+				compiler.backend = state.backend;
+				compiler.pls_inputs = state.pls_inputs;
+				compiler.pls_outputs = state.pls_outputs;
+				compiler.header_lines = state.header_lines;
+				compiler.requested_extensions = state.requested_extensions;
+				compiler.forced_extensions = state.forced_extensions;
+				compiler.forced_temporaries = state.forced_temporaries;
+				compiler.analyzed_use_counts = state.analyzed_use_counts;
+				compiler.analyzed_forced_temporaries = state.analyzed_forced_temporaries;
+				compiler.analyzed_common_subexpressions = state.analyzed_common_subexpressions;
+				compiler.relaxed_precision_ids = state.relaxed_precision_ids;
+				compiler.usage_analysis_valid = true;
+				compiler.analyzed_entry_point = state.entry_point;
+
+				chunks[run] = compiler.emit_function_chunk(functions, run_begin[run], run_begin[run + 1]);
+				chunk_extensions[run] = move(compiler.forced_extensions);
+			}
+			catch (...)
+			{
+				errors[run] = current_exception();
+			}
+		});
+	}
+
+	// This pass has already emitted the header and resources.
+	try
+	{
+		for (size_t i = run_begin[0]; i < run_begin[1]; i++)
+			emit_function_body(get<SPIRFunction>(functions[i].first), functions[i].second);
+	}
+	catch (...)
+	{
+		errors[0] = current_exception();
+	}
+
+	for (auto &t : threads)
+		t.join();
+	for (auto &error : errors)
+		if (error)
+			rethrow_exception(error);
+
+	for (size_t run = 1; run < run_count; run++)
+	{
+		if (options.minify)
+			append_minified(chunks[run]);
+		else
+			buffer << chunks[run];
+
+		// Extensions go in the header, so they need another pass here.
+		for (auto &ext : chunk_extensions[run])
+			require_extension_internal(ext);
+	}
+
+	return true;
+}
+
+// Emits functions [begin, end) the same way as a pass of compile(), but only returns what the functions emitted.
+string CompilerGLSL::emit_function_chunk(const vector<FunctionEmit> &functions, size_t begin, size_t end)
+{
+	uint32_t pass_count = 0;
+	for (;;)
+	{
+		if (pass_count >= 3)
+			throw CompilerError("Over 3 compilation loops detected. Must be a bug!");
+
+		reset();
+		emit_header();
+		emit_resources();
+
+		// The chunk continues wherever the output of the previous chunk ends.
+		size_t chunk_begin = buffer.size();
+		minified_last_char = '\n';
+		for (size_t i = begin; i < end; i++)
+			emit_function_body(get<SPIRFunction>(functions[i].first), functions[i].second);
+
+		pass_count++;
+		if (!force_recompile)
+			return buffer.str().substr(chunk_begin);
+	}
+}
+
+string CompilerGLSL::implicit_function_arguments(const SPIRFunction &)
+{
+	return "";
+}
+
+void CompilerGLSL::emit_function_prologue(const SPIRFunction &)
+{
+}
+
 void CompilerGLSL::emit_fixup()
 {
 	auto &execution = get_entry_point();
@@ -4968,7 +5405,7 @@ void CompilerGLSL::emit_block_chain(SPIRBlock &block)
 	// If we need to force temporaries for certain IDs due to continue blocks, do it before starting loop header.
 	for (auto &tmp : block.declare_temporary)
 	{
-		auto flags = meta[tmp.second].decoration.decoration_flags;
+		auto flags = get_precision_flags(tmp.second);
 		auto &type = get<SPIRType>(tmp.first);
 		statement(flags_to_precision_qualifiers_glsl(type, flags), variable_decl(type, to_name(tmp.second)), ";");
 	}
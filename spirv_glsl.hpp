@@ -18,7 +18,6 @@
 #define SPIRV_GLSL_HPP
 
 #include "spirv_cross.hpp"
-#include <sstream>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -64,6 +63,15 @@ public:
 		// Mostly useful for debugging SPIR-V files.
 		bool vulkan_semantics = false;
 
+		// Only declare the resources, structs and global variables which the entry point uses.
+		// Inputs and outputs are always declared, so the stages still link.
+		bool strip_unused_resources = false;
+
+		// Emit as little text as possible. Anything which is not part of the interface gets a short name,
+		// and there is no indentation, no empty lines and no line breaks other than those the preprocessor needs.
+		// Only GLSL output is minified, the MSL and C++ backends ignore this.
+		bool minify = false;
+
 		enum Precision
 		{
 			DontCare,
@@ -72,6 +80,22 @@ public:
 			Highp
 		};
 
+		enum PrecisionLowering
+		{
+			NoLowering,
+			// Values computed from RelaxedPrecision inputs, uniforms and textures by additions, multiplications,
+			// mixes and clamps are mediump, unless they reach a function call, a texture coordinate or a highp output.
+			ConservativeLowering,
+			// Also lets texture results and fragment inputs start mediump values, and lowers most float arithmetic,
+			// comparisons and values written to any fragment output.
+			// A texture result which is combined with a highp value stays highp.
+			AggressiveLowering
+		};
+
+		// In ES targets, declare values and local variables mediump where the precision
+		// they are computed from is all they can have anyway.
+		PrecisionLowering precision_lowering = NoLowering;
+
 		struct
 		{
 			// In vertex shaders, rewrite [0, w] depth (Vulkan/D3D style) to [-w, w] depth (GL style).
@@ -92,16 +116,25 @@ public:
 		pls_inputs = std::move(inputs);
 		pls_outputs = std::move(outputs);
 		remap_pls_variables();
+		invalidate_usage_analysis();
 	}
 
 	CompilerGLSL(std::vector<uint32_t> spirv_)
 	    : Compiler(move(spirv_))
 	{
-		if (source.known)
-		{
-			options.es = source.es;
-			options.version = source.version;
-		}
+		init();
+	}
+
+	CompilerGLSL(const uint32_t *ir, size_t word_count)
+	    : Compiler(ir, word_count)
+	{
+		init();
+	}
+
+	CompilerGLSL(std::shared_ptr<const ParsedIR> ir)
+	    : Compiler(move(ir))
+	{
+		init();
 	}
 
 	const Options &get_options() const
@@ -114,6 +147,20 @@ public:
 	}
 	std::string compile() override;
 
+	// Compiles the module once for every set of options, e.g. for several GLSL versions.
+	// Usage analysis is shared by all of them, so every variant after the first only costs emission.
+	// The options are restored afterwards.
+	std::vector<std::string> compile_variants(const std::vector<Options> &variants);
+
+	// Emits the functions of a module on up to this many threads, 0 means one per CPU core.
+	// Every thread emits a run of functions into its own chunk, and the chunks are joined in the order
+	// a single thread would emit them. Each thread works on its own copy of the IR, so this only pays off
+	// for modules with large or many functions. Only used by CompilerGLSL itself, not by other backends.
+	void set_emit_thread_count(uint32_t count)
+	{
+		emit_thread_count = count;
+	}
+
 	// Adds a line to be added right after #version in GLSL backend.
 	// This is useful for enabling custom extensions which are outside the scope of SPIRV-Cross.
 	// This can be combined with variable remapping.
@@ -133,6 +180,16 @@ public:
 protected:
 	void reset();
 	void emit_function(SPIRFunction &func, uint64_t return_flags);
+	void emit_function_body(SPIRFunction &func, uint64_t return_flags);
+
+	// A function and the return flags of the call which emits it.
+	typedef std::pair<uint32_t, uint64_t> FunctionEmit;
+	// Functions in the order emit_function() emits them, callees first.
+	void collect_function_emit_order(uint32_t func, uint64_t return_flags, std::unordered_set<uint32_t> &seen,
+	                                 std::vector<FunctionEmit> &order);
+	bool emit_functions_threaded();
+	std::string emit_function_chunk(const std::vector<FunctionEmit> &functions, size_t begin, size_t end);
+	uint32_t emit_thread_count = 1;
 
 	// Virtualize methods which need to be overridden by subclass targets like C++ and such.
 	virtual void emit_function_prototype(SPIRFunction &func, uint64_t return_flags);
@@ -147,20 +204,24 @@ protected:
 	virtual std::string constant_expression_vector(const SPIRConstant &c, uint32_t vector);
 	virtual void emit_fixup();
 	virtual std::string variable_decl(const SPIRType &type, const std::string &name);
+	// Arguments passed to every call of func before the arguments in the SPIR-V.
+	virtual std::string implicit_function_arguments(const SPIRFunction &func);
+	// Called at the start of every function body, before any local variables are declared.
+	virtual void emit_function_prologue(const SPIRFunction &func);
 
-	std::unique_ptr<std::ostringstream> buffer;
+	StringStream<> buffer;
 
 	template <typename T>
 	inline void statement_inner(T &&t)
 	{
-		(*buffer) << std::forward<T>(t);
+		buffer << std::forward<T>(t);
 		statement_count++;
 	}
 
 	template <typename T, typename... Ts>
 	inline void statement_inner(T &&t, Ts &&... ts)
 	{
-		(*buffer) << std::forward<T>(t);
+		buffer << std::forward<T>(t);
 		statement_count++;
 		statement_inner(std::forward<Ts>(ts)...);
 	}
@@ -170,13 +231,18 @@ protected:
 	{
 		if (redirect_statement)
 			redirect_statement->push_back(join(std::forward<Ts>(ts)...));
+		else if (options.minify)
+		{
+			statement_count++;
+			append_minified(join(std::forward<Ts>(ts)...));
+		}
 		else
 		{
 			for (uint32_t i = 0; i < indent; i++)
-				(*buffer) << "    ";
+				buffer << "    ";
 
 			statement_inner(std::forward<Ts>(ts)...);
-			(*buffer) << '\n';
+			buffer << '\n';
 		}
 	}
 
@@ -270,10 +336,18 @@ protected:
 	SPIRType binary_op_bitcast_helper(std::string &cast_op0, std::string &cast_op1, SPIRType::BaseType &input_type,
 	                                  uint32_t op0, uint32_t op1, bool skip_cast_if_equal_type);
 
+	void emit_common_subexpression(uint32_t result_type, uint32_t result_id, uint32_t first_id);
 	void emit_unary_op(uint32_t result_type, uint32_t result_id, uint32_t op0, const char *op);
 	bool expression_is_forwarded(uint32_t id);
+	bool should_forward_op(uint32_t result_id, bool forward_rhs, bool suppress_usage_tracking);
 	SPIRExpression &emit_op(uint32_t result_type, uint32_t result_id, const std::string &rhs, bool forward_rhs,
 	                        bool extra_parens, bool suppress_usage_tracking = false);
+	SPIRExpression &emit_op(uint32_t result_type, uint32_t result_id, std::shared_ptr<ExpressionRope> rhs,
+	                        bool forward_rhs, bool extra_parens);
+	// Same as to_expression(), but references the text of forwarded expressions instead of copying it.
+	void append_expression(ExpressionRope &rope, uint32_t id);
+	void check_expression_dependencies(uint32_t id);
+	std::vector<uint32_t> dependency_walk_stack;
 	std::string access_chain(uint32_t base, const uint32_t *indices, uint32_t count, bool index_is_literal,
 	                         bool chain_only = false);
 
@@ -286,6 +360,9 @@ protected:
 	std::string argument_decl(const SPIRFunction::Parameter &arg);
 	std::string to_qualifiers_glsl(uint32_t id);
 	const char *to_precision_qualifiers_glsl(uint32_t id);
+	// Decoration flags, with RelaxedPrecision for values precision lowering relaxed.
+	uint64_t get_precision_flags(uint32_t id) const;
+	std::unordered_set<uint32_t> relaxed_precision_ids;
 	const char *flags_to_precision_qualifiers_glsl(const SPIRType &type, uint64_t flags);
 	const char *format_to_glsl(spv::ImageFormat format);
 	std::string layout_for_member(const SPIRType &type, uint32_t index);
@@ -293,10 +370,6 @@ protected:
 	std::string layout_for_variable(const SPIRVariable &variable);
 
 	bool ssbo_is_std430_packing(const SPIRType &type);
-	uint32_t type_to_std430_base_size(const SPIRType &type);
-	uint32_t type_to_std430_alignment(const SPIRType &type, uint64_t flags);
-	uint32_t type_to_std430_array_stride(const SPIRType &type, uint64_t flags);
-	uint32_t type_to_std430_size(const SPIRType &type, uint64_t flags);
 
 	std::string bitcast_glsl(const SPIRType &result_type, uint32_t arg);
 	std::string bitcast_glsl_op(const SPIRType &result_type, const SPIRType &argument_type);
@@ -310,6 +383,18 @@ protected:
 
 	void replace_fragment_output(SPIRVariable &var);
 	void replace_fragment_outputs();
+	void restore_fragment_outputs();
+	// Outputs which were renamed to gl_FragData, and their original alias.
+	std::vector<std::pair<uint32_t, uint32_t>> replaced_fragment_outputs;
+
+	void minify_names();
+	void restore_minified_names();
+	// IDs which got a short name, and their original alias.
+	std::vector<std::pair<uint32_t, uint32_t>> minified_names;
+	// Appends text to the minified output as if it was the next statement.
+	void append_minified(const std::string &text);
+	// The last character of the minified output, a line is open unless this is a line break.
+	char minified_last_char = '\n';
 	std::string legacy_tex_op(const std::string &op, const SPIRType &imgtype);
 
 	uint32_t indent = 0;
@@ -323,9 +408,16 @@ protected:
 	std::unordered_set<uint32_t> forwarded_temporaries;
 	void track_expression_read(uint32_t id);
 
+	// Extensions from require_extension(), and all extensions needed by the current compile.
+	std::unordered_set<std::string> requested_extensions;
 	std::unordered_set<std::string> forced_extensions;
+	void require_extension_internal(const std::string &ext);
 	std::vector<std::string> header_lines;
 
+	bool static_types_scanned = false;
+	bool uses_fp64 = false;
+	bool uses_int64 = false;
+
 	uint32_t statement_count;
 
 	inline bool is_legacy() const
@@ -349,6 +441,16 @@ protected:
 	void check_function_call_constraints(const uint32_t *args, uint32_t length);
 	void handle_invalid_expression(uint32_t id);
 	void find_static_extensions();
+
+private:
+	void init()
+	{
+		if (source.known)
+		{
+			options.es = source.es;
+			options.version = source.version;
+		}
+	}
 };
 }
 
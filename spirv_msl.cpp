@@ -28,10 +28,22 @@ CompilerMSL::CompilerMSL(vector<uint32_t> spirv_)
 	options.vertex.fixup_clipspace = false;
 }
 
+CompilerMSL::CompilerMSL(const uint32_t *ir, size_t word_count)
+    : CompilerGLSL(ir, word_count)
+{
+	options.vertex.fixup_clipspace = false;
+}
+
+CompilerMSL::CompilerMSL(shared_ptr<const ParsedIR> ir)
+    : CompilerGLSL(move(ir))
+{
+	options.vertex.fixup_clipspace = false;
+}
+
 string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_vtx_attrs,
                             std::vector<MSLResourceBinding> *p_res_bindings)
 {
-	next_metal_resource_index = MSLResourceBinding(); // Start bindings at zero
+	begin_stats();
 
 	pad_type_ids_by_pad_len.clear();
 
@@ -48,7 +60,7 @@ string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_
 	resource_bindings.clear();
 	if (p_res_bindings)
 	{
-		resource_bindings.reserve(p_vtx_attrs->size());
+		resource_bindings.reserve(p_res_bindings->size());
 		for (auto &rb : *p_res_bindings)
 		{
 			rb.used_by_shader = false;
@@ -56,13 +68,10 @@ string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_
 		}
 	}
 
-	extract_builtins();
-	localize_global_variables();
-	add_interface_structs();
-
 	// Do not deal with ES-isms like precision, older extensions and such.
 	options.es = false;
 	options.version = 1;
+	options.minify = false;
 	backend.float_literal_suffix = false;
 	backend.uint32_t_literal_suffix = true;
 	backend.basic_int_type = "int";
@@ -70,6 +79,14 @@ string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_
 	backend.swizzle_is_function = false;
 	backend.shared_is_implied = false;
 
+	{
+		PhaseScope phase(*this, CompilerPhaseAnalysis);
+		extract_builtins();
+		localize_global_variables();
+		add_interface_structs();
+		analyze_usage();
+	}
+
 	uint32_t pass_count = 0;
 	do
 	{
@@ -78,18 +95,30 @@ string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_
 
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		// Start bindings at zero, so every pass assigns the same indices.
+		next_metal_resource_index = MSLResourceBinding();
+		next_argument_buffer_ids.clear();
 
-		emit_header();
-		emit_resources();
-		emit_function_declarations();
-		emit_function(get<SPIRFunction>(entry_point), 0);
+		{
+			PhaseScope phase(*this, CompilerPhaseEmitResources);
+			emit_header();
+			emit_resources();
+		}
+
+		{
+			PhaseScope phase(*this, CompilerPhaseEmitFunctions);
+			emit_function_declarations();
+			emit_function(get<SPIRFunction>(entry_point), 0);
+		}
 
 		pass_count++;
 	} while (force_recompile);
 
-	return buffer->str();
+	recompile_count = pass_count - 1;
+
+	auto output = buffer.str();
+	end_stats(output);
+	return output;
 }
 
 string CompilerMSL::compile()
@@ -361,7 +390,7 @@ uint32_t CompilerMSL::add_interface_struct(StorageClass storage, uint32_t vtx_bi
 
 			// Update the original variable reference to include the structure reference
 			string qual_var_name = ib_var_ref + "." + mbr_name;
-			meta[p_var->self].decoration.alias = qual_var_name;
+			set_alias(meta[p_var->self].decoration, qual_var_name);
 
 			// Copy the variable location from the original variable to the member
 			auto &dec = meta[p_var->self].decoration;
@@ -380,7 +409,7 @@ uint32_t CompilerMSL::add_interface_struct(StorageClass storage, uint32_t vtx_bi
 	if (!ib_type.is_packed)
 	{
 		// Sort the members of the interface structure, unless this is packed input
-		MemberSorterByLocation memberSorter(ib_type, meta[ib_type.self]);
+		MemberSorterByLocation memberSorter(ib_type, get_or_create_member_meta(ib_type.self));
 		memberSorter.sort();
 	}
 
@@ -435,6 +464,8 @@ void CompilerMSL::emit_resources()
 		}
 	}
 
+	emit_argument_buffers();
+
 	// Output interface blocks.
 	for (uint32_t var_id : stage_in_var_ids)
 		emit_interface_block(var_id);
@@ -444,6 +475,84 @@ void CompilerMSL::emit_resources()
 	// TODO: Consolidate and output loose uniforms into an input struct
 }
 
+// Returns whether the variable is passed in the argument buffer of its descriptor set.
+bool CompilerMSL::is_argument_buffer_resource(const SPIRVariable &var)
+{
+	if (!msl_config.argument_buffers || is_builtin_variable(var) ||
+	    (var.storage != StorageClassUniform && var.storage != StorageClassUniformConstant))
+		return false;
+
+	auto &type = get<SPIRType>(var.basetype);
+	return type.basetype == SPIRType::Struct || type.basetype == SPIRType::Image ||
+	       type.basetype == SPIRType::SampledImage || type.basetype == SPIRType::Sampler;
+}
+
+string CompilerMSL::argument_buffer_name(uint32_t desc_set) const
+{
+	return join("spvDescriptorSet", desc_set);
+}
+
+// Emit a structure declaration for the argument buffer of each descriptor set.
+void CompilerMSL::emit_argument_buffers()
+{
+	argument_buffer_resources.clear();
+	for (auto &id : ids)
+	{
+		if (id.get_type() == TypeVariable)
+		{
+			auto &var = id.get<SPIRVariable>();
+			if (is_argument_buffer_resource(var))
+				argument_buffer_resources[meta[var.self].decoration.set].push_back(var.self);
+		}
+	}
+
+	for (auto &desc_set : argument_buffer_resources)
+	{
+		auto &resources = desc_set.second;
+		sort(begin(resources), end(resources), [this](uint32_t a, uint32_t b) {
+			uint32_t binding_a = meta[a].decoration.binding;
+			uint32_t binding_b = meta[b].decoration.binding;
+			return binding_a != binding_b ? binding_a < binding_b : a < b;
+		});
+
+		statement("struct ", argument_buffer_name(desc_set.first), "Buffer");
+		begin_scope();
+		for (auto var_id : resources)
+		{
+			auto &var = get<SPIRVariable>(var_id);
+			auto &type = get<SPIRType>(var.basetype);
+			auto name = to_name(var_id);
+
+			switch (type.basetype)
+			{
+			case SPIRType::Struct:
+				statement("constant ", type_to_glsl(type), "* ", name, " [[id(",
+				          get_metal_resource_index(var, SPIRType::Struct), ")]];");
+				break;
+			case SPIRType::Sampler:
+				statement(type_to_glsl(type), " ", name, " [[id(", get_metal_resource_index(var, SPIRType::Sampler),
+				          ")]];");
+				break;
+			case SPIRType::Image:
+				statement(type_to_glsl(type), " ", name, " [[id(", get_metal_resource_index(var, SPIRType::Image),
+				          ")]];");
+				break;
+			case SPIRType::SampledImage:
+				statement(type_to_glsl(type), " ", name, " [[id(", get_metal_resource_index(var, SPIRType::Image),
+				          ")]];");
+				if (type.image.dim != DimBuffer)
+					statement("sampler ", to_sampler_expression(var_id), " [[id(",
+					          get_metal_resource_index(var, SPIRType::Sampler), ")]];");
+				break;
+			default:
+				break;
+			}
+		}
+		end_scope_decl();
+		statement("");
+	}
+}
+
 // Emit a structure declaration for the specified interface variable.
 void CompilerMSL::emit_interface_block(uint32_t ib_var_id)
 {
@@ -530,7 +639,7 @@ void CompilerMSL::emit_texture_op(const Instruction &i)
 	auto op = static_cast<Op>(i.op);
 	uint32_t length = i.length;
 
-	if (i.offset + length > spirv.size())
+	if (i.offset + length > spirv_word_count)
 		throw CompilerError("Compiler::compile() opcode out of range.");
 
 	uint32_t result_type = ops[0];
@@ -846,6 +955,35 @@ string CompilerMSL::to_sampler_expression(uint32_t id)
 	return samp_id ? to_expression(samp_id) : to_expression(id) + sampler_name_suffix;
 }
 
+// Resources in argument buffers are referenced by the same names as resources passed directly
+void CompilerMSL::emit_function_prologue(const SPIRFunction &func)
+{
+	if (func.self != entry_point)
+		return;
+
+	for (auto &desc_set : argument_buffer_resources)
+	{
+		auto buffer_name = argument_buffer_name(desc_set.first);
+		for (auto var_id : desc_set.second)
+		{
+			auto &type = get<SPIRType>(get<SPIRVariable>(var_id).basetype);
+			auto name = to_name(var_id);
+
+			if (type.basetype == SPIRType::Struct)
+				statement("constant ", type_to_glsl(type), "& ", name, " = *", buffer_name, ".", name, ";");
+			else
+			{
+				statement(type_to_glsl(type), " ", name, " = ", buffer_name, ".", name, ";");
+				if (type.basetype == SPIRType::SampledImage && type.image.dim != DimBuffer)
+				{
+					auto sampler = to_sampler_expression(var_id);
+					statement("sampler ", sampler, " = ", buffer_name, ".", sampler, ";");
+				}
+			}
+		}
+	}
+}
+
 // Called automatically at the end of the entry point function
 void CompilerMSL::emit_fixup()
 {
@@ -1087,6 +1225,16 @@ string CompilerMSL::entry_point_args(bool append_comma)
 			           convert_to_string(dec.binding) + ")]]";
 	}
 
+	// Argument buffers
+	for (auto &desc_set : argument_buffer_resources)
+	{
+		if (!ep_args.empty())
+			ep_args += ", ";
+		auto name = argument_buffer_name(desc_set.first);
+		ep_args += "constant " + name + "Buffer& " + name;
+		ep_args += " [[buffer(" + convert_to_string(get_argument_buffer_index(desc_set.first)) + ")]]";
+	}
+
 	// Uniforms
 	for (auto &id : ids)
 	{
@@ -1095,8 +1243,9 @@ string CompilerMSL::entry_point_args(bool append_comma)
 			auto &var = id.get<SPIRVariable>();
 			auto &type = get<SPIRType>(var.basetype);
 
-			if (var.storage == StorageClassUniform || var.storage == StorageClassUniformConstant ||
-			    var.storage == StorageClassPushConstant)
+			if ((var.storage == StorageClassUniform || var.storage == StorageClassUniformConstant ||
+			     var.storage == StorageClassPushConstant) &&
+			    !is_argument_buffer_resource(var))
 			{
 				switch (type.basetype)
 				{
@@ -1155,33 +1304,31 @@ string CompilerMSL::entry_point_args(bool append_comma)
 // Returns the Metal index of the resource of the specified type as used by the specified variable.
 uint32_t CompilerMSL::get_metal_resource_index(SPIRVariable &var, SPIRType::BaseType basetype)
 {
-	auto &execution = get_entry_point();
 	auto &var_dec = meta[var.self].decoration;
 	uint32_t var_desc_set = (var.storage == StorageClassPushConstant) ? kPushConstDescSet : var_dec.set;
 	uint32_t var_binding = (var.storage == StorageClassPushConstant) ? kPushConstBinding : var_dec.binding;
 
 	// If a matching binding has been specified, find and use it
-	for (auto p_res_bind : resource_bindings)
+	auto *p_res_bind = find_resource_binding(var_desc_set, var_binding);
+	if (p_res_bind)
 	{
-		if (p_res_bind->stage == execution.model && p_res_bind->desc_set == var_desc_set &&
-		    p_res_bind->binding == var_binding)
+		switch (basetype)
 		{
-
-			p_res_bind->used_by_shader = true;
-			switch (basetype)
-			{
-			case SPIRType::Struct:
-				return p_res_bind->msl_buffer;
-			case SPIRType::Image:
-				return p_res_bind->msl_texture;
-			case SPIRType::Sampler:
-				return p_res_bind->msl_sampler;
-			default:
-				return 0;
-			}
+		case SPIRType::Struct:
+			return p_res_bind->msl_buffer;
+		case SPIRType::Image:
+			return p_res_bind->msl_texture;
+		case SPIRType::Sampler:
+			return p_res_bind->msl_sampler;
+		default:
+			return 0;
 		}
 	}
 
+	// Resources in an argument buffer are numbered from zero in each set, in one space for all types
+	if (is_argument_buffer_resource(var))
+		return next_argument_buffer_ids[var_desc_set]++;
+
 	// If a binding has not been specified, revert to incrementing resource indices
 	switch (basetype)
 	{
@@ -1196,6 +1343,30 @@ uint32_t CompilerMSL::get_metal_resource_index(SPIRVariable &var, SPIRType::Base
 	}
 }
 
+// Returns the Metal buffer index of the argument buffer of the specified descriptor set.
+uint32_t CompilerMSL::get_argument_buffer_index(uint32_t desc_set)
+{
+	auto *p_res_bind = find_resource_binding(desc_set, kArgumentBufferBinding);
+	return p_res_bind ? p_res_bind->msl_buffer : next_metal_resource_index.msl_buffer++;
+}
+
+// Returns the resource binding specified for the descriptor set and binding in this stage, and marks
+// it as used by the shader, or returns nullptr if there is none.
+MSLResourceBinding *CompilerMSL::find_resource_binding(uint32_t desc_set, uint32_t binding)
+{
+	auto &execution = get_entry_point();
+	for (auto p_res_bind : resource_bindings)
+	{
+		if (p_res_bind->stage == execution.model && p_res_bind->desc_set == desc_set &&
+		    p_res_bind->binding == binding)
+		{
+			p_res_bind->used_by_shader = true;
+			return p_res_bind;
+		}
+	}
+	return nullptr;
+}
+
 // Returns the name of the entry point of this shader
 string CompilerMSL::get_entry_point_name()
 {
@@ -1504,6 +1675,7 @@ string CompilerMSL::builtin_qualifier(BuiltIn builtin)
 		if (execution.flags & (1ull << ExecutionModeDepthUnchanged))
 			return "depth(any)";
 	}
+	// fallthrough
 
 	default:
 		return "unsupported-built-in";
@@ -1615,13 +1787,7 @@ size_t CompilerMSL::get_declared_type_size(const SPIRType &type, uint64_t dec_ma
 		}
 	}
 	else
-	{
-		// Recurse.
-		uint32_t last = uint32_t(type.member_types.size() - 1);
-		uint32_t offset = type_struct_member_offset(type, last);
-		size_t size = get_declared_struct_size(get<SPIRType>(type.member_types.back()));
-		return offset + size;
-	}
+		return get_declared_struct_size(type);
 }
 
 // Sort both type and meta member content based on builtin status (put builtins at end), then by location.
@@ -1638,19 +1804,19 @@ void MemberSorterByLocation::sort()
 	// This is done by creating temporary copies of both member types and meta, and then
 	// copying back to the original content at the sorted indices.
 	auto mbr_types_cpy = type.member_types;
-	auto mbr_meta_cpy = meta.members;
+	auto mbr_meta_cpy = members;
 	for (uint32_t mbr_idx = 0; mbr_idx < mbr_cnt; mbr_idx++)
 	{
 		type.member_types[mbr_idx] = mbr_types_cpy[mbr_idxs[mbr_idx]];
-		meta.members[mbr_idx] = mbr_meta_cpy[mbr_idxs[mbr_idx]];
+		members[mbr_idx] = mbr_meta_cpy[mbr_idxs[mbr_idx]];
 	}
 }
 
 // Sort first by builtin status (put builtins at end), then by location.
 bool MemberSorterByLocation::operator()(uint32_t mbr_idx1, uint32_t mbr_idx2)
 {
-	auto &mbr_meta1 = meta.members[mbr_idx1];
-	auto &mbr_meta2 = meta.members[mbr_idx2];
+	auto &mbr_meta1 = members[mbr_idx1];
+	auto &mbr_meta2 = members[mbr_idx2];
 	if (mbr_meta1.builtin != mbr_meta2.builtin)
 		return mbr_meta2.builtin;
 	else
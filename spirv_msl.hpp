@@ -18,6 +18,7 @@
 #define SPIRV_MSL_HPP
 
 #include "spirv_glsl.hpp"
+#include <map>
 #include <set>
 #include <vector>
 
@@ -31,6 +32,11 @@ struct MSLConfiguration
 	bool flip_vert_y = true;
 	bool flip_frag_y = true;
 	bool is_rendering_points = false;
+
+	// Pass the buffers, textures and samplers of each descriptor set to the entry point as
+	// one argument buffer, instead of one argument per resource. Push constants are passed as before.
+	// Resources are [[id(n)]] members of the argument buffer, and the argument buffer of a set is [[buffer(n)]].
+	bool argument_buffers = false;
 };
 
 // Defines MSL characteristics of a vertex attribute at a particular location.
@@ -72,12 +78,20 @@ static const uint32_t kPushConstDescSet = UINT32_MAX;
 // element to indicate the bindings for the push constants.
 static const uint32_t kPushConstBinding = 0;
 
+// Special constant used in a MSLResourceBinding binding element to indicate the
+// argument buffer of the descriptor set, when argument buffers are enabled.
+// The msl_buffer element is the buffer index of the argument buffer, and the msl_buffer,
+// msl_texture and msl_sampler elements of the bindings in the set are their [[id(n)]] in it.
+static const uint32_t kArgumentBufferBinding = UINT32_MAX;
+
 // Decompiles SPIR-V to Metal Shading Language
 class CompilerMSL : public CompilerGLSL
 {
 public:
 	// Constructs an instance to compile the SPIR-V code into Metal Shading Language.
 	CompilerMSL(std::vector<uint32_t> spirv);
+	CompilerMSL(const uint32_t *ir, size_t word_count);
+	CompilerMSL(std::shared_ptr<const ParsedIR> ir);
 
 	// Compiles the SPIR-V code into Metal Shading Language using the specified configuration parameters.
 	//  - msl_cfg indicates some general configuration for directing the compilation.
@@ -101,6 +115,7 @@ protected:
 	void emit_sampled_image_op(uint32_t result_type, uint32_t result_id, uint32_t image_id, uint32_t samp_id) override;
 	void emit_texture_op(const Instruction &i) override;
 	void emit_fixup() override;
+	void emit_function_prologue(const SPIRFunction &func) override;
 	std::string type_to_glsl(const SPIRType &type) override;
 	std::string image_type_glsl(const SPIRType &type) override;
 	std::string builtin_to_glsl(spv::BuiltIn builtin) override;
@@ -115,6 +130,8 @@ protected:
 	uint32_t add_interface_struct(spv::StorageClass storage, uint32_t vtx_binding = 0);
 	void emit_resources();
 	void emit_interface_block(uint32_t ib_var_id);
+	void emit_argument_buffers();
+	bool is_argument_buffer_resource(const SPIRVariable &var);
 	void emit_function_prototype(SPIRFunction &func, bool is_decl);
 	void emit_function_declarations();
 
@@ -129,6 +146,9 @@ protected:
 	std::string argument_decl(const SPIRFunction::Parameter &arg);
 	std::string get_vtx_idx_var_name(bool per_instance);
 	uint32_t get_metal_resource_index(SPIRVariable &var, SPIRType::BaseType basetype);
+	uint32_t get_argument_buffer_index(uint32_t desc_set);
+	MSLResourceBinding *find_resource_binding(uint32_t desc_set, uint32_t binding);
+	std::string argument_buffer_name(uint32_t desc_set) const;
 	uint32_t get_ordered_member_location(uint32_t type_id, uint32_t index);
 	uint32_t pad_to_offset(SPIRType &struct_type, uint32_t offset, uint32_t struct_size);
 	SPIRType &get_pad_type(uint32_t pad_len);
@@ -140,6 +160,10 @@ protected:
 	std::vector<MSLResourceBinding *> resource_bindings;
 	std::unordered_map<uint32_t, uint32_t> builtin_vars;
 	MSLResourceBinding next_metal_resource_index;
+	// Resources of each descriptor set which are passed in an argument buffer, in binding order.
+	std::map<uint32_t, std::vector<uint32_t>> argument_buffer_resources;
+	// Resources without a binding in an argument buffer share one [[id(n)]] space.
+	std::unordered_map<uint32_t, uint32_t> next_argument_buffer_ids;
 	std::unordered_map<uint32_t, uint32_t> pad_type_ids_by_pad_len;
 	std::vector<uint32_t> stage_in_var_ids;
 	uint32_t stage_out_var_id = 0;
@@ -156,13 +180,13 @@ struct MemberSorterByLocation
 {
 	void sort();
 	bool operator()(uint32_t mbr_idx1, uint32_t mbr_idx2);
-	MemberSorterByLocation(SPIRType &t, Meta &m)
+	MemberSorterByLocation(SPIRType &t, std::vector<Meta::Decoration> &m)
 	    : type(t)
-	    , meta(m)
+	    , members(m)
 	{
 	}
 	SPIRType &type;
-	Meta &meta;
+	std::vector<Meta::Decoration> &members;
 };
 }
 
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_reflection.hpp"
+#include <cstring>
+
+using namespace std;
+using namespace spv;
+using namespace spirv_cross;
+
+// Word offsets into the blob header.
+enum
+{
+	HeaderMagic,
+	HeaderVersion,
+	HeaderHashLow,
+	HeaderHashHigh,
+	HeaderWordCount,
+	HeaderEntryPointName,
+	HeaderStringOffset,
+	HeaderStringBytes,
+	HeaderEntryPointOffset,
+	HeaderEntryPointCount,
+	HeaderResourceOffset,
+	HeaderResourceCount,
+	HeaderMemberOffset,
+	HeaderMemberCount,
+	HeaderRangeOffset,
+	HeaderRangeCount,
+	HeaderSize
+};
+
+// Record sizes in words.
+// Entry point: name, model, workgroup x, y, z.
+// Resource: list, id, type_id, base_type_id, name, set, binding, location, input attachment index,
+//           decoration mask low, decoration mask high, declared struct size,
+//           first member, member count, first range, range count.
+// Member: offset, size.
+// Range: index, offset, range.
+enum
+{
+	EntryPointRecordSize = 5,
+	ResourceRecordSize = 16,
+	MemberRecordSize = 2,
+	RangeRecordSize = 3
+};
+
+// Resource lists in the order they are numbered in resource records.
+static vector<Resource> ShaderResources::*const resource_lists[] = {
+	&ShaderResources::uniform_buffers, &ShaderResources::storage_buffers, &ShaderResources::stage_inputs,
+	&ShaderResources::stage_outputs,   &ShaderResources::subpass_inputs,  &ShaderResources::storage_images,
+	&ShaderResources::sampled_images,  &ShaderResources::atomic_counters, &ShaderResources::push_constant_buffers,
+};
+
+static const uint32_t resource_list_count = uint32_t(sizeof(resource_lists) / sizeof(resource_lists[0]));
+
+uint64_t spirv_cross::hash_spirv(const uint32_t *spirv, size_t word_count)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < word_count; i++)
+	{
+		for (uint32_t shift = 0; shift < 32; shift += 8)
+		{
+			h ^= (spirv[i] >> shift) & 0xff;
+			h *= 0x100000001b3ull;
+		}
+	}
+	return h;
+}
+
+vector<uint32_t> spirv_cross::build_reflection_blob(const Compiler &compiler, uint64_t spirv_hash)
+{
+	// Offset 0 is always the empty string.
+	struct StringWriter
+	{
+		string data = string(1, '\0');
+		unordered_map<string, uint32_t> offsets;
+
+		uint32_t add(const string &str)
+		{
+			if (str.empty())
+				return 0;
+
+			auto itr = offsets.find(str);
+			if (itr != end(offsets))
+				return itr->second;
+
+			uint32_t offset = uint32_t(data.size());
+			data += str;
+			data += '\0';
+			offsets[str] = offset;
+			return offset;
+		}
+	} strings;
+
+	vector<uint32_t> entry_points;
+	vector<uint32_t> resources;
+	vector<uint32_t> members;
+	vector<uint32_t> ranges;
+
+	for (auto &name : compiler.get_entry_points())
+	{
+		auto &entry = compiler.get_entry_point(name);
+		entry_points.insert(end(entry_points), { strings.add(entry.name), uint32_t(entry.model), entry.workgroup_size.x,
+		                                         entry.workgroup_size.y, entry.workgroup_size.z });
+	}
+
+	auto res = compiler.get_shader_resources();
+	for (uint32_t list = 0; list < resource_list_count; list++)
+	{
+		for (auto &resource : res.*resource_lists[list])
+		{
+			uint64_t mask = compiler.get_decoration_mask(resource.id);
+			uint32_t declared_struct_size = 0;
+			uint32_t first_member = uint32_t(members.size() / MemberRecordSize);
+			uint32_t first_range = uint32_t(ranges.size() / RangeRecordSize);
+
+			bool is_block = resource_lists[list] == &ShaderResources::uniform_buffers ||
+			                resource_lists[list] == &ShaderResources::storage_buffers ||
+			                resource_lists[list] == &ShaderResources::push_constant_buffers;
+			auto &type = compiler.get_type(resource.base_type_id);
+			if (is_block && type.basetype == SPIRType::Struct)
+			{
+				declared_struct_size = uint32_t(compiler.get_declared_struct_size(type));
+				for (uint32_t i = 0; i < uint32_t(type.member_types.size()); i++)
+				{
+					members.push_back(compiler.get_member_decoration(type.self, i, DecorationOffset));
+					members.push_back(uint32_t(compiler.get_declared_struct_member_size(type, i)));
+				}
+
+				for (auto &range : compiler.get_active_buffer_ranges(resource.id))
+					ranges.insert(end(ranges), { range.index, uint32_t(range.offset), uint32_t(range.range) });
+			}
+
+			resources.insert(end(resources),
+			                 { list, resource.id, resource.type_id, resource.base_type_id, strings.add(resource.name),
+			                   compiler.get_decoration(resource.id, DecorationDescriptorSet),
+			                   compiler.get_decoration(resource.id, DecorationBinding),
+			                   compiler.get_decoration(resource.id, DecorationLocation),
+			                   compiler.get_decoration(resource.id, DecorationInputAttachmentIndex), uint32_t(mask),
+			                   uint32_t(mask >> 32), declared_struct_size, first_member,
+			                   uint32_t(members.size() / MemberRecordSize) - first_member, first_range,
+			                   uint32_t(ranges.size() / RangeRecordSize) - first_range });
+		}
+	}
+
+	vector<uint32_t> blob(HeaderSize);
+	auto append = [&blob](const vector<uint32_t> &section, uint32_t offset_word) {
+		blob[offset_word] = uint32_t(blob.size());
+		blob.insert(end(blob), begin(section), end(section));
+	};
+
+	blob[HeaderMagic] = ReflectionMagic;
+	blob[HeaderVersion] = ReflectionVersion;
+	blob[HeaderHashLow] = uint32_t(spirv_hash);
+	blob[HeaderHashHigh] = uint32_t(spirv_hash >> 32);
+	blob[HeaderEntryPointName] = strings.add(compiler.get_current_entry_point_name());
+
+	append(entry_points, HeaderEntryPointOffset);
+	blob[HeaderEntryPointCount] = uint32_t(entry_points.size() / EntryPointRecordSize);
+	append(resources, HeaderResourceOffset);
+	blob[HeaderResourceCount] = uint32_t(resources.size() / ResourceRecordSize);
+	append(members, HeaderMemberOffset);
+	blob[HeaderMemberCount] = uint32_t(members.size() / MemberRecordSize);
+	append(ranges, HeaderRangeOffset);
+	blob[HeaderRangeCount] = uint32_t(ranges.size() / RangeRecordSize);
+
+	// Strings go last, padded to a whole number of words.
+	blob[HeaderStringOffset] = uint32_t(blob.size());
+	blob[HeaderStringBytes] = uint32_t(strings.data.size());
+	size_t string_words = (strings.data.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+	blob.resize(blob.size() + string_words);
+	memcpy(&blob[blob[HeaderStringOffset]], strings.data.data(), strings.data.size());
+
+	blob[HeaderWordCount] = uint32_t(blob.size());
+	return blob;
+}
+
+bool spirv_cross::reflection_blob_matches(const void *data, size_t size, uint64_t spirv_hash)
+{
+	if (size < HeaderSize * sizeof(uint32_t))
+		return false;
+
+	auto *header = static_cast<const uint32_t *>(data);
+	return header[HeaderMagic] == ReflectionMagic && header[HeaderVersion] == ReflectionVersion &&
+	       header[HeaderHashLow] == uint32_t(spirv_hash) && header[HeaderHashHigh] == uint32_t(spirv_hash >> 32);
+}
+
+ShaderReflection spirv_cross::load_reflection_blob(const void *data, size_t size)
+{
+	if (size < HeaderSize * sizeof(uint32_t))
+		throw CompilerError("Reflection blob is too small.");
+
+	auto *blob = static_cast<const uint32_t *>(data);
+	if (blob[HeaderMagic] != ReflectionMagic)
+		throw CompilerError("Invalid reflection blob.");
+	if (blob[HeaderVersion] != ReflectionVersion)
+		throw CompilerError("Unsupported reflection blob version.");
+
+	size_t word_count = blob[HeaderWordCount];
+	if (word_count * sizeof(uint32_t) > size)
+		throw CompilerError("Reflection blob is truncated.");
+
+	auto section = [&](uint32_t offset_word, uint32_t count_word, uint32_t record_size) {
+		uint64_t offset = blob[offset_word];
+		uint64_t end_offset = offset + uint64_t(blob[count_word]) * record_size;
+		if (offset < HeaderSize || end_offset > word_count)
+			throw CompilerError("Reflection blob section out of range.");
+		return blob + offset;
+	};
+
+	auto *entry_points = section(HeaderEntryPointOffset, HeaderEntryPointCount, EntryPointRecordSize);
+	auto *resources = section(HeaderResourceOffset, HeaderResourceCount, ResourceRecordSize);
+	auto *members = section(HeaderMemberOffset, HeaderMemberCount, MemberRecordSize);
+	auto *ranges = section(HeaderRangeOffset, HeaderRangeCount, RangeRecordSize);
+
+	uint64_t string_bytes = blob[HeaderStringBytes];
+	uint64_t string_offset = blob[HeaderStringOffset];
+	if (string_offset < HeaderSize || string_offset * sizeof(uint32_t) + string_bytes > word_count * sizeof(uint32_t))
+		throw CompilerError("Reflection blob section out of range.");
+	auto *strings = reinterpret_cast<const char *>(blob + string_offset);
+
+	auto get_string = [&](uint32_t offset) -> string {
+		if (offset >= string_bytes)
+			throw CompilerError("Reflection blob string out of range.");
+		auto *terminator = memchr(strings + offset, 0, size_t(string_bytes - offset));
+		if (!terminator)
+			throw CompilerError("Reflection blob string is not terminated.");
+		return string(strings + offset, static_cast<const char *>(terminator));
+	};
+
+	ShaderReflection reflection;
+	reflection.spirv_hash = (uint64_t(blob[HeaderHashHigh]) << 32) | blob[HeaderHashLow];
+	reflection.entry_point = get_string(blob[HeaderEntryPointName]);
+
+	for (uint32_t i = 0; i < blob[HeaderEntryPointCount]; i++)
+	{
+		auto *record = entry_points + i * EntryPointRecordSize;
+		if (record[1] > ExecutionModelKernel)
+			throw CompilerError("Invalid entry point in reflection blob.");
+
+		ReflectedEntryPoint entry;
+		entry.name = get_string(record[0]);
+		entry.model = static_cast<ExecutionModel>(record[1]);
+		entry.workgroup_size.x = record[2];
+		entry.workgroup_size.y = record[3];
+		entry.workgroup_size.z = record[4];
+		reflection.entry_points.push_back(move(entry));
+	}
+
+	uint32_t member_count = blob[HeaderMemberCount];
+	uint32_t range_count = blob[HeaderRangeCount];
+	for (uint32_t i = 0; i < blob[HeaderResourceCount]; i++)
+	{
+		auto *record = resources + i * ResourceRecordSize;
+		if (record[0] >= resource_list_count || uint64_t(record[12]) + record[13] > member_count ||
+		    uint64_t(record[14]) + record[15] > range_count)
+			throw CompilerError("Invalid resource in reflection blob.");
+
+		(reflection.resources.*resource_lists[record[0]]).push_back({ record[1], record[2], record[3], get_string(record[4]) });
+
+		auto &info = reflection.resource_info[record[1]];
+		info.set = record[5];
+		info.binding = record[6];
+		info.location = record[7];
+		info.input_attachment_index = record[8];
+		info.decoration_mask = (uint64_t(record[10]) << 32) | record[9];
+		info.declared_struct_size = record[11];
+
+		for (uint32_t m = 0; m < record[13]; m++)
+		{
+			auto *member = members + (record[12] + m) * MemberRecordSize;
+			info.members.push_back({ member[0], member[1] });
+		}
+
+		for (uint32_t r = 0; r < record[15]; r++)
+		{
+			auto *range = ranges + (record[14] + r) * RangeRecordSize;
+			info.active_ranges.push_back({ range[0], range[1], range[2] });
+		}
+	}
+
+	return reflection;
+}
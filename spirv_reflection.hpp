@@ -0,0 +1,99 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_REFLECTION_HPP
+#define SPIRV_REFLECTION_HPP
+
+#include "spirv_cross.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spirv_cross
+{
+// Binary reflection blobs let a runtime build descriptor layouts without shipping or parsing SPIR-V.
+//
+// A blob is an array of 32-bit words in host byte order, so it can be used straight from a memory mapped file.
+// It starts with a fixed header holding the magic, the format version, the hash of the SPIR-V module
+// it was built from, and the word offset and count of every section.
+// All records have a fixed size and strings live in a separate table, so nothing needs to be parsed
+// to seek to a record.
+enum
+{
+	ReflectionMagic = 0x58525053, // "SPRX"
+	ReflectionVersion = 1
+};
+
+struct ReflectedEntryPoint
+{
+	std::string name;
+	spv::ExecutionModel model = {};
+	struct
+	{
+		uint32_t x = 0, y = 0, z = 0;
+	} workgroup_size;
+};
+
+struct ReflectedMember
+{
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct ReflectedResource
+{
+	uint64_t decoration_mask = 0;
+	uint32_t set = 0;
+	uint32_t binding = 0;
+	uint32_t location = 0;
+	uint32_t input_attachment_index = 0;
+
+	// Layout and active ranges are only recorded for uniform, storage and push constant blocks.
+	size_t declared_struct_size = 0;
+	std::vector<ReflectedMember> members;
+	std::vector<BufferRange> active_ranges;
+};
+
+struct ShaderReflection
+{
+	uint64_t spirv_hash = 0;
+
+	// The entry point the resources were reflected for.
+	std::string entry_point;
+	std::vector<ReflectedEntryPoint> entry_points;
+
+	// The same lists get_shader_resources() returns.
+	ShaderResources resources;
+
+	// Decorations and layout for every resource, keyed on Resource::id.
+	std::unordered_map<uint32_t, ReflectedResource> resource_info;
+};
+
+// 64-bit FNV-1a hash of a SPIR-V module, used to match blobs to modules.
+uint64_t hash_spirv(const uint32_t *spirv, size_t word_count);
+
+// Reflects the current entry point of compiler into a blob.
+std::vector<uint32_t> build_reflection_blob(const Compiler &compiler, uint64_t spirv_hash);
+
+// Only looks at the header, so this is cheap enough to validate a cached blob before loading it.
+bool reflection_blob_matches(const void *data, size_t size, uint64_t spirv_hash);
+
+// Fills in a ShaderReflection from a blob, without needing a Compiler.
+// Throws CompilerError if the blob is malformed or was written by a different format version.
+ShaderReflection load_reflection_blob(const void *data, size_t size);
+}
+
+#endif
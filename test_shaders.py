@@ -66,7 +66,7 @@ def validate_shader(shader, vulkan):
     else:
         subprocess.check_call(['glslangValidator', shader])
 
-def cross_compile(shader, vulkan, spirv):
+def cross_compile(shader, vulkan, spirv, extra_args):
     spirv_f, spirv_path = tempfile.mkstemp()
     glsl_f, glsl_path = tempfile.mkstemp(suffix = os.path.basename(shader))
     os.close(spirv_f)
@@ -86,7 +86,7 @@ def cross_compile(shader, vulkan, spirv):
     #    subprocess.check_call(['spirv-val', spirv_path])
 
     spirv_cross_path = './spirv-cross'
-    subprocess.check_call([spirv_cross_path, '--entry', 'main', '--output', glsl_path, spirv_path])
+    subprocess.check_call([spirv_cross_path, '--entry', 'main'] + extra_args + ['--output', glsl_path, spirv_path])
 
     # A shader might not be possible to make valid GLSL from, skip validation for this case.
     if (not ('nocompat' in glsl_path)) and (not spirv):
@@ -98,6 +98,13 @@ def cross_compile(shader, vulkan, spirv):
 
     return (spirv_path, glsl_path, vulkan_glsl_path if vulkan else None)
 
+def lowered_compile(shader, spirv_path, precision_lowering):
+    glsl_f, glsl_path = tempfile.mkstemp(suffix = os.path.basename(shader))
+    os.close(glsl_f)
+    subprocess.check_call(['./spirv-cross', '--entry', 'main', '--precision-lowering', precision_lowering, '--output', glsl_path, spirv_path])
+    validate_shader(glsl_path, False)
+    return glsl_path
+
 def md5_for_file(path):
     md5 = hashlib.md5()
     with open(path, 'rb') as f:
@@ -152,49 +159,90 @@ def shader_is_desktop(shader):
 def shader_is_spirv(shader):
     return '.asm.' in shader
 
-def test_shader(stats, shader, update, keep):
+# Shaders tagged with a precision lowering mode are compiled to ES 310 with it.
+def shader_precision_lowering(shader):
+    for mode in ['conservative', 'aggressive']:
+        if '.{}.'.format(mode) in shader:
+            return mode
+    return None
+
+def shader_is_stripped(shader):
+    return '.strip.' in shader
+
+def shader_is_minified(shader):
+    return '.minify.' in shader
+
+def test_shader(stats, shader, update, keep, precision_lowering):
     joined_path = os.path.join(shader[0], shader[1])
     vulkan = shader_is_vulkan(shader[1])
     desktop = shader_is_desktop(shader[1])
     spirv = shader_is_spirv(shader[1])
+    lowering = shader_precision_lowering(shader[1])
+    extra_args = ['--es', '--version', '310', '--precision-lowering', lowering] if lowering else []
+    if shader_is_stripped(shader[1]):
+        extra_args.append('--strip-unused-resources')
+    if shader_is_minified(shader[1]):
+        extra_args.append('--minify')
 
     print('Testing shader:', joined_path)
-    spirv, glsl, vulkan_glsl = cross_compile(joined_path, vulkan, spirv)
+    spirv_path, glsl, vulkan_glsl = cross_compile(joined_path, vulkan, spirv, extra_args)
 
     # Only test GLSL stats if we have a shader following GL semantics.
-    if stats and (not vulkan) and (not spirv) and (not desktop):
+    collect_stats = stats and (not vulkan) and (not spirv) and (not desktop)
+    if collect_stats:
+        pristine_stats = get_shader_stats(joined_path)
         cross_stats = get_shader_stats(glsl)
+        lowered = lowered_compile(joined_path, spirv_path, precision_lowering)
+        lowered_stats = get_shader_stats(lowered)
+        os.remove(lowered)
 
     regression_check(shader, glsl, update, keep)
     if vulkan_glsl:
         regression_check((shader[0], shader[1] + '.vk'), vulkan_glsl, update, keep)
-    os.remove(spirv)
-
-    if stats and (not vulkan):
-        pristine_stats = get_shader_stats(joined_path)
+    os.remove(spirv_path)
 
+    if collect_stats:
         a = []
         a.append(shader[1])
         for i in pristine_stats:
             a.append(str(i))
         for i in cross_stats:
             a.append(str(i))
+        for i in lowered_stats:
+            a.append(str(i))
         print(','.join(a), file = stats)
 
-def test_shaders_helper(stats, shader_dir, update, malisc, keep):
+def test_shaders_helper(stats, shader_dir, update, malisc, keep, precision_lowering):
     for root, dirs, files in os.walk(os.path.join(shader_dir)):
         for i in files:
             path = os.path.join(root, i)
             relpath = os.path.relpath(path, shader_dir)
-            test_shader(stats, (shader_dir, relpath), update, keep)
-
-def test_shaders(shader_dir, update, malisc, keep):
+            test_shader(stats, (shader_dir, relpath), update, keep, precision_lowering)
+
+def print_lowering_summary(path):
+    # ALU cycles are the third and sixth number of each set of stats, after the register counts.
+    cross_short = cross_long = lowered_short = lowered_long = 0.0
+    with open(path) as f:
+        next(f)
+        for line in f:
+            row = line.strip().split(',')
+            if len(row) < 25:
+                continue
+            cross_short += float(row[11])
+            cross_long += float(row[14])
+            lowered_short += float(row[19])
+            lowered_long += float(row[22])
+    print('ALU cycles with precision lowering: short path {:.1f} -> {:.1f}, long path {:.1f} -> {:.1f}'.format(
+        cross_short, lowered_short, cross_long, lowered_long))
+
+def test_shaders(shader_dir, update, malisc, keep, precision_lowering):
     if malisc:
         with open('stats.csv', 'w') as stats:
-            print('Shader,OrigRegs,OrigUniRegs,OrigALUShort,OrigLSShort,OrigTEXShort,OrigALULong,OrigLSLong,OrigTEXLong,CrossRegs,CrossUniRegs,CrossALUShort,CrossLSShort,CrossTEXShort,CrossALULong,CrossLSLong,CrossTEXLong', file = stats)
-            test_shaders_helper(stats, shader_dir, update, malisc, keep)
+            print('Shader,OrigRegs,OrigUniRegs,OrigALUShort,OrigLSShort,OrigTEXShort,OrigALULong,OrigLSLong,OrigTEXLong,CrossRegs,CrossUniRegs,CrossALUShort,CrossLSShort,CrossTEXShort,CrossALULong,CrossLSLong,CrossTEXLong,LoweredRegs,LoweredUniRegs,LoweredALUShort,LoweredLSShort,LoweredTEXShort,LoweredALULong,LoweredLSLong,LoweredTEXLong', file = stats)
+            test_shaders_helper(stats, shader_dir, update, malisc, keep, precision_lowering)
+        print_lowering_summary('stats.csv')
     else:
-        test_shaders_helper(None, shader_dir, update, malisc, keep)
+        test_shaders_helper(None, shader_dir, update, malisc, keep, precision_lowering)
 
 def main():
     parser = argparse.ArgumentParser(description = 'Script for regression testing.')
@@ -209,13 +257,17 @@ def main():
     parser.add_argument('--malisc',
             action = 'store_true',
             help = 'Use malisc offline compiler to determine static cycle counts before and after spirv-cross.')
+    parser.add_argument('--precision-lowering',
+            choices = ['conservative', 'aggressive'],
+            default = 'conservative',
+            help = 'Precision lowering mode to compare cycle counts against with --malisc.')
     args = parser.parse_args()
 
     if not args.folder:
         sys.stderr.write('Need shader folder.\n')
         sys.exit(1)
 
-    test_shaders(args.folder, args.update, args.malisc, args.keep)
+    test_shaders(args.folder, args.update, args.malisc, args.keep, args.precision_lowering)
     if args.malisc:
         print('Stats in stats.csv!')
     print('Tests completed!')